@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+#include "anomalydetector.h"
+
+AnomalyDetector::AnomalyDetector(std::string name, unsigned int clearCount) :
+    m_name(name), m_clearCount(clearCount)
+{
+    m_rateWarning = 0.0;
+    m_rateCritical = 0.0;
+    m_diurnalWarning = 0.0;
+    m_diurnalCritical = 0.0;
+    m_quietSamples = 0;
+    m_level = NORMAL;
+    m_changed = false;
+}
+
+AnomalyDetector::~AnomalyDetector()
+{
+}
+
+/**
+ * \fn void AnomalyDetector::enableRateOfChange(double warning, double critical)
+ * 
+ * Limits are in channel units per hour, in either direction.
+ */
+void AnomalyDetector::enableRateOfChange(double warning, double critical)
+{
+    m_rate.reset(new RateOfChange());
+    m_rateWarning = warning;
+    m_rateCritical = critical;
+}
+
+void AnomalyDetector::enableCusum(double k, double h)
+{
+    m_cusum.reset(new Cusum(k, h));
+}
+
+/**
+ * \fn void AnomalyDetector::enableDiurnal(double warning, double critical)
+ * 
+ * Limits are in standard deviations from the normal for the hour.
+ */
+void AnomalyDetector::enableDiurnal(double warning, double critical)
+{
+    m_diurnal.reset(new DiurnalBaseline());
+    m_diurnalWarning = warning;
+    m_diurnalCritical = critical;
+}
+
+AnomalyDetector::Level AnomalyDetector::update(double value, time_t when)
+{
+    Level current = NORMAL;
+    Cause cause = NONE;
+    double score = 0.0;
+    
+    if (m_rate) {
+        double rate = std::fabs(m_rate->update(value, when));
+        if (m_rateCritical > 0 && rate >= m_rateCritical)
+            current = CRITICAL;
+        else if (m_rateWarning > 0 && rate >= m_rateWarning)
+            current = WARNING;
+        
+        if (current != NORMAL)
+            cause = RATE;
+    }
+    
+    if (m_cusum && m_cusum->update(value)) {
+        if (current == NORMAL) {
+            current = WARNING;
+            cause = DRIFT;
+        }
+    }
+    
+    if (m_diurnal) {
+        double z = m_diurnal->update(value, when);
+        Level diurnal = NORMAL;
+        
+        if (m_diurnalCritical > 0 && std::fabs(z) >= m_diurnalCritical)
+            diurnal = CRITICAL;
+        else if (m_diurnalWarning > 0 && std::fabs(z) >= m_diurnalWarning)
+            diurnal = WARNING;
+        
+        if (diurnal > current) {
+            current = diurnal;
+            cause = DIURNAL;
+            score = z;
+        }
+    }
+    
+    m_changed = false;
+    if (current >= m_level) {
+        m_quietSamples = 0;
+        if (current != m_level) {
+            m_level = current;
+            m_reason = describe(cause, score);
+            m_changed = true;
+        }
+    }
+    else if (++m_quietSamples >= m_clearCount) {
+        m_level = current;
+        m_reason = describe(cause, score);
+        m_quietSamples = 0;
+        m_changed = true;
+    }
+    
+    return m_level;
+}
+
+/*
+ * Called from update() on a change of level, while the checks still
+ * hold the state that caused it.
+ */
+std::string AnomalyDetector::describe(Cause cause, double score) const
+{
+    std::stringstream reason;
+    
+    reason << std::fixed << std::setprecision(2);
+    switch (cause) {
+        case RATE:
+            reason << m_name << " is changing " << m_rate->rate() << " per hour";
+            break;
+        case DRIFT:
+            reason << m_name << " has drifted " << (m_cusum->high() > m_cusum->low() ? "up" : "down") << " from " << m_cusum->reference();
+            break;
+        case DIURNAL:
+            reason << m_name << " is " << std::fabs(score) << " sigma " << (score < 0 ? "below" : "above") << " normal for this hour";
+            break;
+        case NONE:
+            break;
+    }
+    return reason.str();
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ANOMALYDETECTOR_H
+#define ANOMALYDETECTOR_H
+
+#include <string>
+#include <memory>
+#include <ctime>
+
+#include "rateofchange.h"
+#include "cusum.h"
+#include "diurnalbaseline.h"
+
+/**
+ * \class AnomalyDetector
+ * 
+ * Streaming anomaly and trend detection for one probe channel. Each
+ * sample runs through whichever of the rate of change, CUSUM and
+ * day/night baseline checks are enabled, all of which are O(1) in time
+ * and memory. The worst result wins.
+ * 
+ * Raising is immediate, but the level only drops after clearCount
+ * consecutive samples agree, so a channel sitting right on a limit
+ * doesn't flap the error handler. Time is passed in rather than read
+ * from the clock so recorded history can be replayed through it. The
+ * reason is only formatted when the level changes, a sample that
+ * changes nothing doesn't allocate.
+ */
+class AnomalyDetector
+{
+public:
+    typedef enum LEVELTYPE: int {
+        NORMAL = 0,
+        WARNING = 1,
+        CRITICAL = 2
+    } Level;
+    
+    AnomalyDetector(std::string name, unsigned int clearCount = 3);
+    ~AnomalyDetector();
+    
+    void enableRateOfChange(double warning, double critical);
+    void enableCusum(double k, double h);
+    void enableDiurnal(double warning, double critical);
+    
+    Level update(double value, time_t when);
+    Level level() const { return m_level; }
+    bool changed() const { return m_changed; }
+    std::string reason() const { return m_reason; }
+    std::string name() const { return m_name; }
+    
+private:
+    typedef enum CAUSETYPE: int {
+        NONE = 0,
+        RATE = 1,
+        DRIFT = 2,
+        DIURNAL = 3
+    } Cause;
+    
+    std::string describe(Cause cause, double score) const;
+    
+    std::unique_ptr<RateOfChange> m_rate;
+    std::unique_ptr<Cusum> m_cusum;
+    std::unique_ptr<DiurnalBaseline> m_diurnal;
+    std::string m_name;
+    std::string m_reason;
+    double m_rateWarning;
+    double m_rateCritical;
+    double m_diurnalWarning;
+    double m_diurnalCritical;
+    unsigned int m_clearCount;
+    unsigned int m_quietSamples;
+    Level m_level;
+    bool m_changed;
+};
+
+#endif // ANOMALYDETECTOR_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "cusum.h"
+
+Cusum::Cusum(double k, double h, double alpha, unsigned int warmup) :
+    m_k(k), m_h(h), m_alpha(alpha), m_warmup(warmup)
+{
+    reset();
+}
+
+Cusum::~Cusum()
+{
+}
+
+void Cusum::reset()
+{
+    m_reference = 0.0;
+    m_high = 0.0;
+    m_low = 0.0;
+    m_samples = 0;
+    m_tripped = false;
+}
+
+/**
+ * \fn bool Cusum::update(double value)
+ * 
+ * Returns true while either sum is over the threshold. Once the
+ * channel comes back inside k of the reference the sums bleed off on
+ * their own and the detector clears. The reference is frozen while
+ * tripped so the fault can't be learned as the new normal.
+ */
+bool Cusum::update(double value)
+{
+    if (m_samples == 0)
+        m_reference = value;
+    
+    m_samples++;
+    if (m_samples <= m_warmup) {
+        m_reference += (value - m_reference) / m_samples;
+        return false;
+    }
+    
+    m_high = std::max(0.0, m_high + (value - m_reference) - m_k);
+    m_low = std::max(0.0, m_low + (m_reference - value) - m_k);
+    m_tripped = (m_high > m_h) || (m_low > m_h);
+    
+    if (!m_tripped)
+        m_reference += m_alpha * (value - m_reference);
+    
+    return m_tripped;
+}
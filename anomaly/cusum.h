@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CUSUM_H
+#define CUSUM_H
+
+/**
+ * \class Cusum
+ * 
+ * Two sided cumulative sum detector. The reference level follows the
+ * channel very slowly, and any drift of more than k away from it is
+ * accumulated until one of the sums crosses h. This picks up a slow
+ * steady sag that never trips a rate of change limit.
+ * 
+ * The first warmup samples only train the reference level.
+ */
+class Cusum
+{
+public:
+    Cusum(double k, double h, double alpha = 0.001, unsigned int warmup = 30);
+    ~Cusum();
+    
+    bool update(double value);
+    bool tripped() const { return m_tripped; }
+    double high() const { return m_high; }
+    double low() const { return m_low; }
+    double reference() const { return m_reference; }
+    void reset();
+    
+private:
+    double m_k;
+    double m_h;
+    double m_alpha;
+    double m_reference;
+    double m_high;
+    double m_low;
+    unsigned int m_warmup;
+    unsigned int m_samples;
+    bool m_tripped;
+};
+
+#endif // CUSUM_H
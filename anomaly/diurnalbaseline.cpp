@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "diurnalbaseline.h"
+
+DiurnalBaseline::DiurnalBaseline(double alpha, unsigned int minSamples) :
+    m_alpha(alpha), m_minSamples(minSamples)
+{
+    reset();
+}
+
+DiurnalBaseline::~DiurnalBaseline()
+{
+}
+
+void DiurnalBaseline::reset()
+{
+    m_mean.fill(0.0);
+    m_variance.fill(0.0);
+    m_count.fill(0);
+    m_score = 0.0;
+}
+
+/**
+ * \fn double DiurnalBaseline::update(double value, time_t when)
+ * 
+ * Score the sample against its bucket first, then fold it in. Samples
+ * that score badly are only partly learned so a long outage doesn't
+ * rewrite the baseline for that hour.
+ */
+double DiurnalBaseline::update(double value, time_t when)
+{
+    struct tm local;
+    localtime_r(&when, &local);
+    int hour = local.tm_hour;
+    double deviation = value - m_mean[hour];
+    
+    m_score = 0.0;
+    if (m_count[hour] >= m_minSamples) {
+        double sigma = std::sqrt(m_variance[hour]);
+        if (sigma > 1e-9)
+            m_score = deviation / sigma;
+    }
+    
+    if (m_count[hour] == 0) {
+        m_mean[hour] = value;
+        m_variance[hour] = 0.0;
+    }
+    else {
+        double alpha = m_alpha;
+        if (m_count[hour] < m_minSamples)
+            alpha = 1.0 / (m_count[hour] + 1);
+        else if (std::fabs(m_score) > 3.0)
+            alpha /= 10.0;
+        
+        m_mean[hour] += alpha * deviation;
+        m_variance[hour] = (1.0 - alpha) * (m_variance[hour] + alpha * deviation * deviation);
+    }
+    m_count[hour]++;
+    
+    return m_score;
+}
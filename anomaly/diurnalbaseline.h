@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DIURNALBASELINE_H
+#define DIURNALBASELINE_H
+
+#include <array>
+#include <ctime>
+
+/**
+ * \class DiurnalBaseline
+ * 
+ * Dissolved oxygen follows the lights, so a single fixed threshold is
+ * either too loose during the day or too tight at night. This keeps a
+ * running mean and variance for each hour of the local day and scores
+ * a sample by how many standard deviations it sits from the normal
+ * for that hour. A bucket only scores once it has seen enough samples.
+ */
+class DiurnalBaseline
+{
+public:
+    DiurnalBaseline(double alpha = 0.05, unsigned int minSamples = 20);
+    ~DiurnalBaseline();
+    
+    double update(double value, time_t when);
+    double score() const { return m_score; }
+    double mean(int hour) const { return m_mean[hour % 24]; }
+    void reset();
+    
+private:
+    std::array<double, 24> m_mean;
+    std::array<double, 24> m_variance;
+    std::array<unsigned int, 24> m_count;
+    double m_alpha;
+    double m_score;
+    unsigned int m_minSamples;
+};
+
+#endif // DIURNALBASELINE_H
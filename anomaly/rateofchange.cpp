@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "rateofchange.h"
+
+RateOfChange::RateOfChange(double alpha) : m_alpha(alpha)
+{
+    if (m_alpha <= 0.0 || m_alpha > 1.0)
+        m_alpha = 1.0;
+    
+    reset();
+}
+
+RateOfChange::~RateOfChange()
+{
+}
+
+void RateOfChange::reset()
+{
+    m_lastValue = 0.0;
+    m_lastTime = 0;
+    m_rate = 0.0;
+    m_primed = false;
+    m_haveRate = false;
+}
+
+double RateOfChange::update(double value, time_t when)
+{
+    if (!m_primed) {
+        m_lastValue = value;
+        m_lastTime = when;
+        m_primed = true;
+        return m_rate;
+    }
+    
+    double seconds = std::difftime(when, m_lastTime);
+    if (seconds < 60)
+        return m_rate;
+    
+    double slope = (value - m_lastValue) * 3600.0 / seconds;
+    if (!m_haveRate) {
+        m_rate = slope;
+        m_haveRate = true;
+    }
+    else {
+        m_rate += m_alpha * (slope - m_rate);
+    }
+    
+    m_lastValue = value;
+    m_lastTime = when;
+    return m_rate;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RATEOFCHANGE_H
+#define RATEOFCHANGE_H
+
+#include <ctime>
+#include <cmath>
+
+/**
+ * \class RateOfChange
+ * 
+ * Tracks how fast a channel is moving in units per hour. The slope
+ * between successive samples is smoothed so one noisy pair doesn't
+ * look like a crash, and samples closer together than a minute are
+ * folded into the next one to keep the slope meaningful.
+ */
+class RateOfChange
+{
+public:
+    RateOfChange(double alpha = 0.3);
+    ~RateOfChange();
+    
+    double update(double value, time_t when);
+    double rate() const { return m_rate; }
+    bool primed() const { return m_primed; }
+    void reset();
+    
+private:
+    double m_alpha;
+    double m_lastValue;
+    time_t m_lastTime;
+    double m_rate;
+    bool m_primed;
+    bool m_haveRate;
+};
+
+#endif // RATEOFCHANGE_H
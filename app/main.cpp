@@ -28,11 +28,14 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <cmath>
 #include <iomanip>
 #include <ctime>
 #include <sstream>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
+#include <set>
 
 #include <wiringPi.h>
 #include <syslog.h>
@@ -41,17 +44,29 @@
 #include <errno.h>
 #include <nlohmann/json.hpp>
 
-#include "potentialhydrogen.h"
-#include "dissolvedoxygen.h"
+#include "atlasscientifici2c.h"
 #include "itimer.h"
-#include "temperature.h"
-#include "mcp3008.h"
 #include "configuration.h"
+#include "sensorregistry.h"
+#include "ds18b20sensor.h"
+#include "adcsensor.h"
+#include "acquisitioncycle.h"
 #include "errorhandler.h"
 #include "fatal.h"
 #include "critical.h"
 #include "warning.h"
 #include "localmqttcallback.h"
+#include "sessionrecorder.h"
+#include "gpio.h"
+#include "gpiodebouncer.h"
+#include "ledengine.h"
+#include "fakegpiobackend.h"
+#include "metricsserver.h"
+#include "trace.h"
+#include "localresult.h"
+#include "sensorcalibration.h"
+#include "ezotraits.h"
+#include "logger.h"
 
 #define ONE_SECOND          1000
 #define TEN_SECONDS         (ONE_SECOND * 10)
@@ -60,29 +75,40 @@
 #define FIFTEEN_MINUTES     (ONE_MINUTE * 15)
 #define ONE_HOUR            (ONE_MINUTE * 60)
 
-#define AIO_FLOWRATE_FEED   "pbuelow/feeds/aquarium.flowrate"
-#define AIO_OXYGEN_FEED     "pbuelow/feeds/aquarium.oxygen"
-#define AIO_PH_FEED         "pbuelow/feeds/aquarium.ph"
-#define AIO_TEMP_FEED       "pbuelow/feeds/aquarium.Temperature"
-#define AIO_LEVEL_FEED      "pbuelow/feeds/aquarium.waterlevel"
+
+/* Appended to a tank's feed, pbuelow/feeds/aquarium.ph by default */
+#define AIO_FLOWRATE_FEED   ".flowrate"
+#define AIO_OXYGEN_FEED     ".oxygen"
+#define AIO_PH_FEED         ".ph"
+#define AIO_TEMP_FEED       ".temperature"
+#define AIO_LEVEL_FEED      ".waterlevel"
 
 ErrorHandler g_errors;
+GpioDebouncer g_debouncer;
+MetricsServer g_metrics;
+AcquisitionCycle g_cycle;
 std::mutex g_mqttMutex;
 std::condition_variable g_mqttCV;
 std::mutex g_decodeMutex;
 std::mutex g_statusMutex;
 bool g_finished;
-bool g_stopRapidFireWaterLevel;
 bool g_exitImmediately;
+std::atomic<uint64_t> g_replayPublished(0);
 int g_gpioPortOneState;
 int g_gpioPortTwoState;
+std::mutex g_firstTemperatureMutex;
+std::set<std::string> g_firstTemperature;
+
+std::string errorTopic(Sensor *sensor = nullptr);
 
-void gpioPortOneISR()
+void gpioPortOneChanged(int state)
 {
     static int lastErrorHandle = 0;
-    g_gpioPortOneState = digitalRead(Configuration::instance()->m_gpioPortOne);
+    g_gpioPortOneState = state;
+    if (Configuration::instance()->m_pump && state == 0)
+        Configuration::instance()->m_pump->overflowCleared(Configuration::instance()->m_gpioPortOne);
     if (g_gpioPortOneState == 1) {
-        lastErrorHandle = g_errors.warning(std::string("Left overflow is reporting high water"), Configuration::instance()->m_mqtt, 0);
+        lastErrorHandle = g_errors.warning(std::string("Left overflow is reporting high water"), Configuration::instance()->m_mqtt, 0, 0, errorTopic());
     }
     else {
         if (lastErrorHandle > 0) {
@@ -92,12 +118,14 @@ void gpioPortOneISR()
     }
 }
 
-void gpioPortTwoISR()
+void gpioPortTwoChanged(int state)
 {
     static int lastErrorHandle = 0;
-    g_gpioPortTwoState = digitalRead(Configuration::instance()->m_gpioPortTwo);
+    g_gpioPortTwoState = state;
+    if (Configuration::instance()->m_pump && state == 0)
+        Configuration::instance()->m_pump->overflowCleared(Configuration::instance()->m_gpioPortTwo);
     if (g_gpioPortTwoState == 1) {
-        lastErrorHandle = g_errors.warning(std::string("Right overflow is reporting high water"), Configuration::instance()->m_mqtt, 0);
+        lastErrorHandle = g_errors.warning(std::string("Right overflow is reporting high water"), Configuration::instance()->m_mqtt, 0, 0, errorTopic());
     }
     else {
         if (lastErrorHandle > 0) {
@@ -107,36 +135,91 @@ void gpioPortTwoISR()
     }
 }
 
-void eternalBlinkAndDie(int pin, int millihz)
+/*
+ * A high water glitch shorter than the debounce window latched the pump
+ * interlock on its raw edge but never changes the debounced state, so
+ * nothing else would release it.
+ */
+void gpioBounced(GpioEvent event)
 {
-    int state = 0;
-    digitalWrite(pin, state);
-    while (1) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(millihz));
-        state ^= 1UL << 0;
-        digitalWrite(pin, state); 
-    }
+    if (Configuration::instance()->m_pump && event.value == 0)
+        Configuration::instance()->m_pump->overflowCleared(event.pin);
+}
+
+/*
+ * Raw edges from the GPIO event thread. These only get recorded and
+ * queued, the debouncer calls the handlers above once a line settles.
+ */
+void gpioEdge(GpioEvent event)
+{
+    if (Configuration::instance()->m_pump && event.value == 1)
+        Configuration::instance()->m_pump->overflow(event.pin, event.timestamp);
+    
+    SessionRecorder::instance()->recordGpioEdge(event.pin, event.value);
+    g_debouncer.push(event);
+}
+
+/*
+ * The debouncer has to know the pin before the watch starts, or edges
+ * in between are pushed for a pin it drops and the release of a raw
+ * rising edge the pump already latched can be lost. The level is read
+ * again once watched and a change since the first read goes through
+ * gpioEdge() like any other edge. Returns the level the debouncer
+ * started from.
+ */
+int watchOverflow(int pin, unsigned int debounce, std::function<void(GpioEvent)> changed)
+{
+    int initial = Gpio::instance()->read(pin);
+    
+    g_debouncer.addPin(pin, debounce, initial, changed, gpioBounced);
+    Gpio::instance()->watch(pin, GpioBackend::BOTH, gpioEdge);
+    
+    int level = Gpio::instance()->read(pin);
+    if (level != initial)
+        gpioEdge({ pin, level, GpioDebouncer::now() });
+    return initial;
+}
+
+/*
+ * Flow sensor pulses come in at up to a few kHz, so these only get
+ * timestamped into the counter. They are not recorded for replay.
+ */
+void flowRatePulse(GpioEvent event)
+{
+    Configuration::instance()->m_flowRate->pulse(event.timestamp);
+}
+
+/*
+ * Recorded GPIO edges are injected into the fake backend so they take
+ * the same path through the watchers as a live edge would.
+ */
+void replayGpioEdge(int pin, int state)
+{
+    FakeGpioBackend *fake = dynamic_cast<FakeGpioBackend*>(Gpio::instance()->backend());
+    
+    if (fake)
+        fake->inject(pin, state);
 }
 
 void initializeLeds()
 {
-    pinMode(Configuration::instance()->m_greenLed, OUTPUT);
-    pinMode(Configuration::instance()->m_yellowLed, OUTPUT);
-    pinMode(Configuration::instance()->m_redLed, OUTPUT);
+    Gpio::instance()->setOutput(Configuration::instance()->m_greenLed);
+    Gpio::instance()->setOutput(Configuration::instance()->m_yellowLed);
+    Gpio::instance()->setOutput(Configuration::instance()->m_redLed);
     
-    digitalWrite(Configuration::instance()->m_greenLed, HIGH);
-    digitalWrite(Configuration::instance()->m_yellowLed, LOW);
-    digitalWrite(Configuration::instance()->m_redLed, LOW);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);
 
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_greenLed, LOW);
-    digitalWrite(Configuration::instance()->m_yellowLed, HIGH);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_yellowLed, LOW);
-    digitalWrite(Configuration::instance()->m_redLed, HIGH);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_redLed, LOW);
-    digitalWrite(Configuration::instance()->m_greenLed, HIGH);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
 }
 
 bool cisCompare(const std::string & str1, const std::string &str2)
@@ -147,253 +230,488 @@ bool cisCompare(const std::string & str1, const std::string &str2)
             ));
 }
 
-void decodeStatusResponse(std::string which, std::string &response)
+/**
+ * \fn void publishLocal(std::string topic, std::string payload)
+ * 
+ * Publish to the local broker, timing the round trip to its ack for
+ * the aquarium_mqtt_publish_seconds histogram. A replay has no broker,
+ * history must never reach the live topics, so it only counts what
+ * would have gone out.
+ */
+void publishLocal(std::string topic, std::string payload)
+{
+    TRACE_SCOPE("publishLocal");
+    if (SessionRecorder::instance()->replaying()) {
+        g_replayPublished.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Configuration::instance()->m_mqtt->publish(mqtt::make_message(topic, payload), publish_listener::context(), Configuration::instance()->m_localPublish);
+}
+
+void publishAIO(mqtt::message_ptr message)
+{
+    TRACE_SCOPE("publishAIO");
+    if (SessionRecorder::instance()->replaying()) {
+        g_replayPublished.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Configuration::instance()->m_aio->publish(message, publish_listener::context(), Configuration::instance()->m_aioPublish);
+}
+
+/*
+ * Every topic lives under a tank's namespace, aquarium2/data for the
+ * default tank, aquarium2/reef/data for a tank named reef. State that
+ * belongs to the whole daemon goes out under the first tank.
+ */
+std::string tankTopic(const TankConfig &tank, const char *suffix)
+{
+    return tank.topic + "/" + suffix;
+}
+
+std::string sensorTopic(Sensor *sensor, const char *suffix)
+{
+    return tankTopic(SensorRegistry::instance()->tank(sensor->tank()), suffix);
+}
+
+TankConfig mainTank()
+{
+    std::vector<TankConfig> tanks = SensorRegistry::instance()->tanks();
+    
+    return tanks.empty() ? TankConfig() : tanks.front();
+}
+
+/*
+ * Errors go out on the tank they belong to, so the same fault on two
+ * tanks is two errors. The overflows, pump and MQTT belong to the
+ * whole daemon and report through the first tank.
+ */
+std::string errorTopic(Sensor *sensor)
+{
+    return sensor ? sensorTopic(sensor, "error") : tankTopic(mainTank(), "error");
+}
+
+/*
+ * Error handles are kept per sensor so one probe clearing can't clear
+ * another probe's fault. Callbacks for different probes come in on
+ * different threads, so the maps are only touched under g_statusMutex.
+ */
+std::map<std::string, unsigned int> g_statusWarnings;
+std::map<std::string, unsigned int> g_garbageErrors;
+
+void clearGarbageError(Sensor *sensor)
+{
+    std::lock_guard<std::mutex> lock(g_statusMutex);
+    unsigned int &handle = g_garbageErrors[sensor->name()];
+    
+    if (handle > 0) {
+        g_errors.clearCritical(handle);
+        handle = 0;
+    }
+}
+
+void raiseGarbageError(Sensor *sensor)
+{
+    std::lock_guard<std::mutex> lock(g_statusMutex);
+    g_garbageErrors[sensor->name()] = g_errors.critical(std::string(sensor->label() + " probe is returning garbage"), Configuration::instance()->m_mqtt, 0, 0, errorTopic(sensor));
+}
+
+void decodeStatusResponse(Sensor *sensor, std::string &response)
 {
-    static int lastWarningHandle = 0;
-    static int lastErrorHandle = 0;
     nlohmann::json j;
     std::string::size_type pos = response.find_last_of(",");
     double voltage;
     
-    g_statusMutex.lock();
     if (pos != std::string::npos) {
-        if (lastErrorHandle > 0) {
-            g_errors.clearCritical(lastErrorHandle);
-            lastErrorHandle = 0;
-        }
+        clearGarbageError(sensor);
         voltage = std::stod(response.substr(pos + 1));
-        if (voltage > 3) {
-            if (lastWarningHandle > 0) {
-                g_errors.clearWarning(lastWarningHandle);
-                lastWarningHandle = 0;
+        {
+            std::lock_guard<std::mutex> lock(g_statusMutex);
+            unsigned int &handle = g_statusWarnings[sensor->name()];
+            if (voltage > 3) {
+                if (handle > 0) {
+                    g_errors.clearWarning(handle);
+                    handle = 0;
+                }
+            }
+            else {
+                LOGW("Probe is reporting an unusual voltage, it may not be operating correctly", "probe", sensor->label(), "voltage", voltage);
+                handle = g_errors.warning(std::string(sensor->label() + " probe is reporting undervoltage"), Configuration::instance()->m_mqtt, 0, 0, errorTopic(sensor));
             }
         }
-        else {
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": probe is reporting an unusual voltage (" << voltage << "), it may not be operating correctly." << std::endl;
-            lastWarningHandle = g_errors.warning(std::string(which + " probe is reporting undervoltage"), Configuration::instance()->m_mqtt, 0);
-        }
-        if (which == "pH") {
-            j["aquarium"]["device"]["ph"]["voltage"] = response.substr(pos + 1);
-            Configuration::instance()->m_phVoltage = response.substr(pos + 1);
-        }
-        else if (which == "DO") {
-            j["aquarium"]["device"]["dissolvedoxygen"]["version"] = response.substr(pos + 1);
-            Configuration::instance()->m_o2Voltage = response.substr(pos + 1);
-        }
+        j["aquarium"]["device"][sensor->name()]["voltage"] = response.substr(pos + 1);
         if (Configuration::instance()->m_mqttConnected)
-            Configuration::instance()->m_mqtt->publish("aquarium2/device", j.dump());
+            publishLocal(sensorTopic(sensor, "device"), j.dump());
         
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": " << which << ": probe is operating normally, reporting voltage " << voltage << std::endl;
+        LOGI("Probe is operating normally", "probe", sensor->label(), "voltage", voltage);
     }
     else {
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": probe status cannot be decoded" << std::endl;
-        lastErrorHandle = g_errors.critical(std::string(which + " probe is returning garbage"), Configuration::instance()->m_mqtt, 0);
+        LOGE("Probe status cannot be decoded", "probe", sensor->label(), "response", response);
+        raiseGarbageError(sensor);
     }
-    g_statusMutex.unlock();
 }
 
-void decodeInfoResponse(std::string which, std::string &response)
+void decodeInfoResponse(Sensor *sensor, std::string &response)
 {
-    static int lastErrorHandle = 0;
     nlohmann::json j;
     std::string::size_type pos = response.find_last_of(",");
     
     if (pos != std::string::npos) {
-        if (lastErrorHandle > 0) {
-            g_errors.clearCritical(lastErrorHandle);
-            lastErrorHandle = 0;
-        }
-        if (which == "pH") {
-            j["aquarium"]["device"]["ph"]["version"] = response.substr(pos + 1);
-            Configuration::instance()->m_phVersion = response.substr(pos + 1);
-        }
-        else if (which == "DO") {
-            j["aquarium"]["device"]["dissolvedoxygen"]["version"] = response.substr(pos + 1);
-            Configuration::instance()->m_o2Version = response.substr(pos + 1);
-        }
-
+        clearGarbageError(sensor);
+        j["aquarium"]["device"][sensor->name()]["version"] = response.substr(pos + 1);
         if (Configuration::instance()->m_mqttConnected)
-            Configuration::instance()->m_mqtt->publish("aquarium2/device", j.dump());
+            publishLocal(sensorTopic(sensor, "device"), j.dump());
         
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": " << which << ": version " << response.substr(pos + 1) << std::endl;        
+        LOGI("Probe version", "probe", sensor->label(), "version", response.substr(pos + 1));
     }
     else {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": probe info response cannot be decoded" << std::endl;
-        lastErrorHandle = g_errors.critical(std::string(which + " probe is returning garbage"), Configuration::instance()->m_mqtt, 0);
+        LOGE("Probe info response cannot be decoded", "probe", sensor->label(), "response", response);
+        raiseGarbageError(sensor);
     }
 }
 
-void decodeTempCompensation(std::string which, std::string &response)
+void decodeTempCompensation(Sensor *sensor, std::string &response)
 {
-    static int lastErrorHandle = 0;
     nlohmann::json j;
 
     std::string::size_type pos = response.find_last_of(",");
     if (pos != std::string::npos) {
-        if (which == "pH") {
-            j["aquarium"]["device"]["ph"]["tempcompensation"] = response.substr(pos + 1);
-            Configuration::instance()->m_o2TempComp = response.substr(pos + 1);
-        }
-        else if (which == "DO") {
-            j["aquarium"]["device"]["dissolvedoxygen"]["tempcompensation"] = response.substr(pos + 1);
-            Configuration::instance()->m_o2TempComp = response.substr(pos + 1);
-        }
-        Configuration::instance()->m_mqtt->publish("aquarium2/device", j.dump());
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": " << which << ": probe has a temp compensation value of " << response.substr(pos + 1) << "C" << std::endl;
+        j["aquarium"]["device"][sensor->name()]["tempcompensation"] = response.substr(pos + 1);
+        if (Configuration::instance()->m_mqttConnected)
+            publishLocal(sensorTopic(sensor, "device"), j.dump());
+        LOGI("Probe temp compensation", "probe", sensor->label(), "celsius", response.substr(pos + 1));
     }
     else {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": probe temp compensation response cannot be decoded" << std::endl;
-        lastErrorHandle = g_errors.critical(std::string(which + " probe is returning garbage"), Configuration::instance()->m_mqtt, 0);
+        LOGE("Probe temp compensation response cannot be decoded", "probe", sensor->label(), "response", response);
+        raiseGarbageError(sensor);
     }
 }
 
-void phCallback(int cmd, std::string response)
+/*
+ * Run the latest reading through the channel's detector and keep the
+ * error handler in step with it. Only level transitions touch the
+ * error handler, so a steady fault raises once and clears once.
+ */
+void checkForAnomaly(Sensor *sensor, double value, unsigned int &handle)
 {
-    switch (cmd) {
-        case AtlasScientificI2C::INFO:
-            syslog(LOG_NOTICE, "got pH probe info event: %s\n", response.c_str());
-            decodeInfoResponse("pH", response);
-            break;
-        case AtlasScientificI2C::STATUS:
-            syslog(LOG_NOTICE, "got pH probe status event: %s\n", response.c_str());
-            decodeStatusResponse("pH", response);
-            break;
-        case AtlasScientificI2C::CALIBRATE:
-            if (response.find(",0") != std::string::npos)
-                std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": pH: probe reports no calibration data..." << std::endl;
+    AnomalyDetector *detector = sensor->detector();
+    
+    if (detector == nullptr)
+        return;
+    
+    AnomalyDetector::Level previous = detector->level();
+    detector->update(value, std::time(nullptr));
+    
+    if (!detector->changed())
+        return;
+    
+    if (handle > 0) {
+        if (previous == AnomalyDetector::CRITICAL)
+            g_errors.clearCritical(handle);
+        else
+            g_errors.clearWarning(handle);
+        handle = 0;
+    }
+    
+    switch (detector->level()) {
+        case AnomalyDetector::CRITICAL:
+            handle = g_errors.critical(detector->reason(), Configuration::instance()->m_mqtt, 0, 0, errorTopic(sensor));
             break;
-        case AtlasScientificI2C::SETTEMPCOMPREAD:
-        case AtlasScientificI2C::GETTEMPCOMP:
-            decodeTempCompensation("pH", response);
+        case AnomalyDetector::WARNING:
+            handle = g_errors.warning(detector->reason(), Configuration::instance()->m_mqtt, 0, 0, errorTopic(sensor));
             break;
         default:
+            LOGN("Readings are back to normal", "probe", detector->name());
             break;
     }
 }
 
-void doCallback(int cmd, std::string response)
+/*
+ * Called from the main loop every second. A scheduled sensor without a
+ * good reading inside its stale threshold shows as stale on the LEDs
+ * until it gets one, answering with garbage doesn't count.
+ */
+void checkForStaleProbes()
+{
+    bool stale = false;
+    
+    for (auto sensor : SensorRegistry::instance()->sensors()) {
+        if (sensor->interval() <= 0 || !sensor->enabled())
+            continue;
+        if (sensor->sample(g_cycle.staleAfter(sensor)).has(Sample::STALE))
+            stale = true;
+    }
+    
+    LedEngine::instance()->setCondition(LedEngine::STALE, stale);
+}
+
+void setTankTempCompensation(const TankConfig &tank);
+void sendCalibrationPoints(Sensor *sensor, const std::string &response);
+
+/*
+ * True the first time a tank's temperature comes in, its probes get
+ * compensated straight away instead of waiting for the hourly timer.
+ */
+bool firstTemperature(Sensor *sensor)
+{
+    std::lock_guard<std::mutex> lock(g_firstTemperatureMutex);
+    return g_firstTemperature.insert(sensor->tank()).second;
+}
+
+/*
+ * Every sensor in the registry reports through here, the sensor tells
+ * us which probe it was.
+ */
+void probeCallback(Sensor *sensor, int cmd, std::string response)
 {
+    static std::map<std::string, unsigned int> anomalyHandles;
+    static std::mutex anomalyMutex;
+
     switch (cmd) {
         case AtlasScientificI2C::INFO:
-            syslog(LOG_NOTICE, "got DO probe info event: %s\n", response.c_str());
-            decodeInfoResponse("DO", response);
+            LOGN("Probe info event", "probe", sensor->label(), "response", response);
+            decodeInfoResponse(sensor, response);
             break;
         case AtlasScientificI2C::STATUS:
-            syslog(LOG_NOTICE, "got DO probe status event: %s\n", response.c_str());
-            decodeStatusResponse("DO", response);
+            LOGN("Probe status event", "probe", sensor->label(), "response", response);
+            decodeStatusResponse(sensor, response);
+            break;
+        case AtlasScientificI2C::READING:
+            if (sensor->type() == "ds18b20" && firstTemperature(sensor))
+                setTankTempCompensation(SensorRegistry::instance()->tank(sensor->tank()));
+            if (sensor->detector() && sensor->sample(0).good()) {
+                std::lock_guard<std::mutex> lock(anomalyMutex);
+                checkForAnomaly(sensor, sensor->value(), anomalyHandles[sensor->name()]);
+            }
             break;
         case AtlasScientificI2C::CALIBRATE:
             if (response.find(",0") != std::string::npos)
-                std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": DO: probe reports no calibration data..." << std::endl;
+                LOGW("Probe reports no calibration data", "probe", sensor->label());
+            sendCalibrationPoints(sensor, response);
             break;
-        case AtlasScientificI2C::SETTEMPCOMPREAD:
         case AtlasScientificI2C::GETTEMPCOMP:
-            decodeTempCompensation("DO", response);
+            decodeTempCompensation(sensor, response);
             break;
         default:
             break;
     }
 }
 
-void sendLocalResultData()
+/*
+ * The interlock never talks to MQTT itself, so trips are turned into
+ * errors from here instead.
+ */
+void checkPumpInterlocks()
 {
-    nlohmann::json j;
-    std::time_t t = std::time(nullptr);
-    char timebuff[100];
-
-    memset(timebuff, '\0', 100);
-    std::strftime(timebuff, 100, "%c", std::localtime(&t));
-
-    j["aquarium"]["time"]["epoch"] = t;
-    j["aquarium"]["time"]["local"] = timebuff;
-    j["aquarium"]["waterlevel"] = Configuration::instance()->m_adc->reading(Configuration::instance()->m_adcWaterLevelIndex);
-    
-    if (Configuration::instance()->m_temp->enabled()) {
-        std::map<std::string, std::string> devices = Configuration::instance()->m_temp->devices();
-        auto it = devices.begin();
-        while (it != devices.end()) {
-            double c = Configuration::instance()->m_temp->getTemperatureByDevice(it->first);
-            j["aquarium"]["temperature"][it->second]["celsius"] = c;
-            j["aquarium"]["temperature"][it->second]["farenheit"] = Configuration::instance()->m_temp->convertToFarenheit(c);
-            it++;
-        }
+    static unsigned int lastInterlocks = 0;
+    static unsigned int handle = 0;
+    unsigned int interlocks = Configuration::instance()->m_pump->interlocks();
+    
+    if (interlocks == lastInterlocks)
+        return;
+    
+    lastInterlocks = interlocks;
+    if (handle > 0) {
+        g_errors.clearCritical(handle);
+        handle = 0;
+    }
+    if (interlocks != PumpController::NONE) {
+        std::string msg = "Pump stopped by " + PumpController::reason(interlocks) + " interlock";
+        handle = g_errors.critical(msg, Configuration::instance()->m_mqtt, 0, 0, errorTopic());
     }
+}
 
-    j["aquarium"]["ph"] = Configuration::instance()->m_ph->getPH();
-    j["aquarium"]["oxygen"] = Configuration::instance()->m_oxygen->getDO();
-    if (Configuration::instance()->m_gpioPortOne != 0) {
-        j["aquarium"]["gpio"]["1"] = g_gpioPortOneState;
+/*
+ * The first sample of a type in a tank, in config order like the
+ * registry's primary().
+ */
+const FrameSample* primarySample(const Frame &frame, const std::string &type, const TankConfig &tank)
+{
+    Sensor *sensor = SensorRegistry::instance()->primary(type, tank.name);
+    
+    return sensor ? frame.sample(sensor->name()) : nullptr;
+}
+
+/*
+ * One data message per tank, built from that tank's part of the frame.
+ * The GPIO, flow and pump sections are daemon wide and ride on the
+ * first tank.
+ */
+void sendTankResultData(const Frame &frame, const TankConfig &tank, bool first)
+{
+    LocalResult result;
+
+    result.m_tank = tank.name;
+    result.m_time = frame.time;
+    
+    for (auto &it : frame.samples) {
+        const FrameSample &sample = it.second;
+        if (sample.tank != tank.name)
+            continue;
+        result.m_quality[it.first] = { sample.age, sample.sample.quality };
+        if (sample.type == "ds18b20")
+            result.m_temperatures.insert(sample.readings.begin(), sample.readings.end());
+        else
+            result.m_readings.insert(sample.readings.begin(), sample.readings.end());
+    }
+
+    if (const FrameSample *level = frame.sample(tank.level))
+        result.m_waterLevel = level->value();
+    if (const FrameSample *ph = primarySample(frame, "ph", tank)) {
+        result.m_ph = ph->value();
+        result.m_rawPh = ph->raw();
+    }
+    if (const FrameSample *oxygen = primarySample(frame, "do", tank)) {
+        result.m_oxygen = oxygen->value();
+        result.m_rawOxygen = oxygen->raw();
     }
     
-    if (Configuration::instance()->m_gpioPortTwo != 0) {
-        j["aquarium"]["gpio"]["2"] = g_gpioPortTwoState;
+    if (first) {
+        result.m_haveGpioOne = Configuration::instance()->m_gpioPortOne != 0;
+        result.m_haveGpioTwo = Configuration::instance()->m_gpioPortTwo != 0;
+        result.m_gpioOne = g_gpioPortOneState;
+        result.m_gpioTwo = g_gpioPortTwoState;
+        
+        if (Configuration::instance()->m_flowRate) {
+            result.m_haveFlowRate = true;
+            result.m_flowRate = Configuration::instance()->m_flowRate->litersPerMinute();
+        }
+        
+        if (Configuration::instance()->m_pump) {
+            result.m_havePump = true;
+            result.m_pumpRunning = Configuration::instance()->m_pump->running();
+            result.m_pumpInterlock = PumpController::reason(Configuration::instance()->m_pump->interlocks());
+            result.m_pumpStats = Configuration::instance()->m_pump->stats();
+        }
+        
+        if (result.m_haveGpioOne || result.m_haveGpioTwo) {
+            result.m_gpioStats = g_debouncer.stats();
+        }
     }
     
-    if (Configuration::instance()->m_mqttConnected)
-        Configuration::instance()->m_mqtt->publish("aquarium2/data", j.dump());
+    std::string payload;
+    {
+        TRACE_SCOPE("sendLocalResultData::payload");
+        payload = result.payload().dump();
+    }
+    publishLocal(tankTopic(tank, "data"), payload);
+}
+
+void sendLocalResultData(const Frame &frame)
+{
+    TRACE_SCOPE("sendLocalResultData");
+    bool first = true;
+    
+    if (!Configuration::instance()->m_mqttConnected)
+        return;
+    
+    for (auto &tank : SensorRegistry::instance()->tanks()) {
+        sendTankResultData(frame, tank, first);
+        first = false;
+    }
 }
 
-void sendAIOResultData()
+/*
+ * The AIO feeds are bare numbers with nowhere to put the quality, so
+ * anything that isn't a good sample is left out and the feed keeps its
+ * last value.
+ */
+const FrameSample* goodSample(const FrameSample *sample, const TankConfig &tank)
 {
-    if (Configuration::instance()->m_aioConnected) {
+    if (sample == nullptr)
+        return nullptr;
+    
+    if (!sample->good()) {
+        LOGD("Not publishing sample to AIO", "tank", tank.name, "type", sample->type, "quality", static_cast<int>(sample->sample.quality), "age_ms", sample->age);
+        return nullptr;
+    }
+    return sample;
+}
+
+void sendTankAIOData(const Frame &frame, const TankConfig &tank, bool first)
+{
+    if (const FrameSample *level = goodSample(frame.sample(tank.level), tank)) {
         nlohmann::json wlj;
-        nlohmann::json o2j;
+        wlj["value"] = static_cast<int>(level->value());
+        LOGD("AIO water level", "tank", tank.name, "payload", wlj.dump());
+        publishAIO(mqtt::make_message(tank.feed + AIO_LEVEL_FEED, wlj.dump()));
+    }
+    
+    if (const FrameSample *probe = goodSample(primarySample(frame, "ph", tank), tank)) {
         nlohmann::json phj;
+        phj["value"] = probe->value();
+        publishAIO(mqtt::make_message(tank.feed + AIO_PH_FEED, phj.dump()));
+    }
+    
+    if (const FrameSample *probe = goodSample(primarySample(frame, "do", tank), tank)) {
+        nlohmann::json o2j;
+        o2j["value"] = probe->value();
+        publishAIO(mqtt::make_message(tank.feed + AIO_OXYGEN_FEED, o2j.dump()));
+    }
+
+    if (first && Configuration::instance()->m_flowRate) {
+        nlohmann::json flowj;
+        flowj["value"] = Configuration::instance()->m_flowRate->litersPerMinute();
+        publishAIO(mqtt::make_message(tank.feed + AIO_FLOWRATE_FEED, flowj.dump()));
+    }
+
+    if (const FrameSample *bus = goodSample(primarySample(frame, "ds18b20", tank), tank)) {
         nlohmann::json tempj;
+        tempj["value"] = Temperature::convertToFarenheit(bus->value());
+        publishAIO(mqtt::make_message(tank.feed + AIO_TEMP_FEED, tempj.dump()));
+    }
+}
+
+void sendAIOResultData(const Frame &frame)
+{
+    bool first = true;
+    
+    if (!Configuration::instance()->m_aioConnected)
+        return;
+    
+    for (auto &tank : SensorRegistry::instance()->tanks()) {
+        sendTankAIOData(frame, tank, first);
+        first = false;
+    }
+}
+
+/*
+ * Pushes each sensor's compensation source to it, by default the last
+ * value read from the tank's first DS18B20, the bus isn't read again
+ * just for this. A sensor with nothing to use is left alone, another
+ * tank's water is no better a guess than the probe default. Sensors
+ * compensated on every read don't need the push.
+ */
+void setTankTempCompensation(const TankConfig &tank)
+{
+    for (auto sensor : SensorRegistry::instance()->inTank(tank.name)) {
+        if (!sensor->enabled() || sensor->config().perReadCompensation)
+            continue;
         
-        wlj["value"] = Configuration::instance()->m_adc->reading(Configuration::instance()->m_adcWaterLevelIndex);
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ <<  ": pbuelow/feeds/aquarium.waterlevel: " << wlj.dump() << std::endl;
-        mqtt::message_ptr wl = mqtt::make_message("pbuelow/feeds/aquarium.waterlevel", wlj.dump());
-        Configuration::instance()->m_aio->publish(wl);
-        
-        phj["value"] = Configuration::instance()->m_ph->getPH();
-        mqtt::message_ptr ph = mqtt::make_message("pbuelow/feeds/aquarium.ph", phj.dump());
-        Configuration::instance()->m_aio->publish(ph);
+        double c = SensorRegistry::instance()->compensation(sensor);
+        if (std::isnan(c))
+            continue;
         
-        o2j["value"] = Configuration::instance()->m_oxygen->getDO();
-        mqtt::message_ptr oxy = mqtt::make_message("pbuelow/feeds/aquarium.oxygen", o2j.dump());
-        Configuration::instance()->m_aio->publish(oxy);
-
-        if (Configuration::instance()->m_temp->enabled()) {
-            std::map<std::string, std::string> devices = Configuration::instance()->m_temp->devices();
-            auto it = devices.begin();
-            if (it != devices.end()) {
-                double c = Configuration::instance()->m_temp->getTemperatureByDevice(it->first);
-                tempj["value"] = Configuration::instance()->m_temp->convertToFarenheit(c);
-                mqtt::message_ptr temp = mqtt::make_message("pbuelow/feeds/aquarium.temperature", tempj.dump());
-                Configuration::instance()->m_aio->publish(temp);
-            }
-        }
+        LOGI("Setting temp compensation value for probe", "tank", tank.name, "probe", sensor->label(), "celsius", c);
+        sensor->setTempCompensation(c);
     }
 }
 
 void setTempCompensation()
 {
-    std::map<std::string, std::string> devices = Configuration::instance()->m_temp->devices();
-    double c;
-
-    auto it = devices.begin();
-
-    if (it != devices.end()) {
-        c = Configuration::instance()->m_temp->getTemperatureByDevice(it->first);
-
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Setting temp compensation value for probes to " << c << std::endl;
-        if (c != 0) {
-            Configuration::instance()->m_ph->setTempCompensation(c);
-            Configuration::instance()->m_oxygen->setTempCompensation(c);
-            Configuration::instance()->m_ph->getTempCompensation();
-            Configuration::instance()->m_oxygen->getTempCompensation();
-        }
-        it++;
-    }
+    for (auto &tank : SensorRegistry::instance()->tanks())
+        setTankTempCompensation(tank);
 }
 
 void sendTempProbeIdentification()
 {
-    std::map<std::string, std::string> devices = Configuration::instance()->m_temp->devices();
+    Ds18b20Sensor *bus = SensorRegistry::instance()->first<Ds18b20Sensor>();
+    std::map<std::string, std::string> devices;
     nlohmann::json j;
     int index = 1;
 
+    if (bus)
+        devices = bus->temperature()->devices();
+    
     auto it = devices.begin();
     
     while (it != devices.end()) {
@@ -402,8 +720,8 @@ void sendTempProbeIdentification()
         it++;
         index++;
     }
-    if (Configuration::instance()->m_mqtt->is_connected())
-        Configuration::instance()->m_mqtt->publish("aquarium2/devices", j.dump());
+    if (Configuration::instance()->m_mqttConnected)
+        publishLocal(tankTopic(mainTank(), "devices"), j.dump());
 }
 
 /*
@@ -416,65 +734,326 @@ void nameTempProbe(std::string json)
 
     if (!j.is_null()) {
         for (auto& el : j.items()) {
-            std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ <<  ": " << el.key() << ":" << el.value() << std::endl;
             entry[el.key()] = el.value();
+            LOGI("Naming DS18B20 probe", "device", el.key(), "name", entry[el.key()]);
         }
     }
     else {
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ <<  ": j is null: " << json << std::endl;
+        LOGW("Probe naming request is null", "payload", json);
     }
     
     if (entry.size())
         Configuration::instance()->updateArray(std::string("ds18b20"), entry);
 }
 
-void rapidFireWaterLevelMessaging(void *t)
+/*
+ * Rapid fire runs per tank. Each start gets a new generation and its
+ * timer only runs while that generation is the current one for the
+ * tank, so a stop followed quickly by a start can't leave two going.
+ */
+std::mutex g_rapidFireMutex;
+std::map<std::string, unsigned int> g_rapidFire;
+unsigned int g_rapidFireGeneration;
+
+void rapidFireWaterLevelMessaging(void *t, TankConfig tank, unsigned int generation)
 {
     nlohmann::json j;
     ITimer *timer = static_cast<ITimer*>(t);
+    bool running;
     
-    if (g_stopRapidFireWaterLevel) {
+    {
+        std::lock_guard<std::mutex> lock(g_rapidFireMutex);
+        auto it = g_rapidFire.find(tank.name);
+        running = it != g_rapidFire.end() && it->second == generation;
+    }
+    if (!running) {
         timer->stop();
         std::this_thread::sleep_for(std::chrono::seconds(1));
         delete timer;
         return;
     }
-    j["aquarium"]["waterlevel"] = Configuration::instance()->m_adc->reading(Configuration::instance()->m_adcWaterLevelIndex);
+    Sensor *level = SensorRegistry::instance()->find(tank.level);
+    if (level == nullptr)
+        return;
+    
+    // Between frames, so straight from the ADC
+    AdcSensor *adc = dynamic_cast<AdcSensor*>(level);
+    j["aquarium"]["waterlevel"] = adc ? adc->reading() : static_cast<int>(level->value());
 
-    if (Configuration::instance()->m_mqtt->is_connected())
-        Configuration::instance()->m_mqtt->publish("aquarium2/waterlevel/value", j.dump());
+    if (Configuration::instance()->m_mqttConnected)
+        publishLocal(tankTopic(tank, "waterlevel/value"), j.dump());
 }
 
-void mqttIncomingMessage(std::string topic, std::string message)
+void startRapidFireWaterLevel(const TankConfig &tank)
+{
+    unsigned int generation;
+    
+    {
+        std::lock_guard<std::mutex> lock(g_rapidFireMutex);
+        generation = ++g_rapidFireGeneration;
+        g_rapidFire[tank.name] = generation;
+    }
+    ITimer *t = new ITimer();
+    t->setInterval([tank, generation](void *timer) { rapidFireWaterLevelMessaging(timer, tank, generation); }, 500);
+}
+
+void stopRapidFireWaterLevel(const TankConfig &tank)
+{
+    std::lock_guard<std::mutex> lock(g_rapidFireMutex);
+    g_rapidFire.erase(tank.name);
+}
+
+/*
+ * Calibrations running in the daemon by sensor name. A finished one is
+ * kept until the next one for that sensor replaces it.
+ */
+std::mutex g_calibrationMutex;
+std::map<std::string, std::unique_ptr<SensorCalibration>> g_calibrations;
+
+std::string calibrationTopic(Sensor *sensor, const char *suffix)
+{
+    std::string topic = "calibrate/" + sensor->name() + "/" + suffix;
+    return sensorTopic(sensor, topic.c_str());
+}
+
+void sendCalibrationStatus(Sensor *sensor, CalibrationEngine::State state, const CalibrationPoint &point, const Sample &sample, const StabilityDetector &detector)
+{
+    nlohmann::json j;
+    
+    j["sensor"] = sensor->name();
+    j["state"] = CalibrationEngine::name(state);
+    j["point"] = point.name;
+    if (sample.time > 0)
+        j["value"] = sample.raw;
+    j["readings"] = detector.count();
+    j["window"] = detector.window();
+    j["deviation"] = detector.deviation();
+    j["slope"] = detector.slope();
+    publishLocal(calibrationTopic(sensor, "status"), j.dump());
+}
+
+void sendCalibrationResult(Sensor *sensor, bool complete, const std::vector<CalibrationResult> &results)
+{
+    nlohmann::json j;
+    
+    j["sensor"] = sensor->name();
+    j["complete"] = complete;
+    j["points"] = nlohmann::json::array();
+    for (auto &result : results) {
+        nlohmann::json point;
+        point["name"] = result.name;
+        point["accepted"] = result.accepted;
+        if (!std::isnan(result.expected))
+            point["expected"] = result.expected;
+        if (result.accepted) {
+            point["measured"] = result.reading;
+            point["settle_s"] = result.settle / 1000.0;
+        }
+        j["points"].push_back(point);
+    }
+    publishLocal(calibrationTopic(sensor, "result"), j.dump());
+}
+
+/*
+ * The reply to a calibration query, ?CAL,n, goes out as the number of
+ * points the probe holds.
+ */
+void sendCalibrationPoints(Sensor *sensor, const std::string &response)
+{
+    std::string::size_type pos = response.find("?CAL,");
+    nlohmann::json j;
+    
+    if (pos == std::string::npos)
+        return;
+    
+    j["sensor"] = sensor->name();
+    j["points"] = std::atoi(response.c_str() + pos + 5);
+    publishLocal(calibrationTopic(sensor, "points"), j.dump());
+}
+
+/*
+ * <tank>/calibrate/<sensor>/start, abort, clear or query. start may
+ * carry {"window": n, "slope": x, "deviation": y} to override the
+ * probe type's tolerances. The probe is calibrated in place while the
+ * rest of the tank keeps being read and published.
+ */
+void handleCalibration(const TankConfig &tank, const std::string &request, const std::string &message)
+{
+    std::string::size_type slash = request.find('/');
+    
+    if (slash == std::string::npos)
+        return;
+    
+    std::string name = request.substr(0, slash);
+    std::string command = request.substr(slash + 1);
+    if (command != "start" && command != "abort" && command != "clear" && command != "query")
+        return;
+    
+    Sensor *sensor = SensorRegistry::instance()->find(name);
+    if (sensor == nullptr || sensor->tank() != tank.name) {
+        LOGW("Calibration request for a sensor not in the tank", "tank", tank.name, "sensor", name);
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(g_calibrationMutex);
+    std::unique_ptr<SensorCalibration> &calibration = g_calibrations[name];
+    
+    if (command == "abort") {
+        if (calibration)
+            calibration->abort();
+        return;
+    }
+    if (calibration && calibration->running()) {
+        LOGW("Calibration already running", "sensor", name, "command", command);
+        return;
+    }
+    if (command == "clear") {
+        sensor->calibrate(EZO_CAL_CLEAR, 0);
+        sensor->calibrate(EZO_CAL_QUERY, 0);
+        return;
+    }
+    if (command == "query") {
+        sensor->calibrate(EZO_CAL_QUERY, 0);
+        return;
+    }
+    
+    CalibrationPlan plan;
+    if (!SensorCalibration::plan(sensor->type(), plan)) {
+        LOGW("No calibration plan for this type of sensor", "sensor", name, "type", sensor->type());
+        return;
+    }
+    
+    try {
+        nlohmann::json j = nlohmann::json::parse(message);
+        plan.window = j.value("window", plan.window);
+        plan.slope = j.value("slope", plan.slope);
+        plan.deviation = j.value("deviation", plan.deviation);
+    }
+    catch (std::exception &e) {
+        LOGD("Calibration started with the default tolerances", "sensor", name);
+    }
+    
+    calibration.reset(new SensorCalibration(sensor, plan));
+    calibration->setProgress(sendCalibrationStatus);
+    calibration->setDone(sendCalibrationResult);
+    calibration->start();
+}
+
+void stopCalibrations()
+{
+    std::lock_guard<std::mutex> lock(g_calibrationMutex);
+    
+    for (auto &it : g_calibrations) {
+        if (it.second)
+            it.second->abort();
+    }
+    g_calibrations.clear();
+}
+
+/*
+ * Reply to <tank>/errors/history/get with the newest journal entries.
+ * The payload may give a count, either bare or as {"count": n}.
+ */
+void sendErrorHistory(const TankConfig &tank, std::string message)
 {
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ <<  ": Handling topic " << topic << std::endl;
-    if (topic == "aquarium2/set/ds18b20") {
-        nameTempProbe(message);
+    static const char *priorities[] = { "warning", "critical", "fatal" };
+    ErrorJournal *journal = g_errors.journal();
+    nlohmann::json j;
+    size_t count = 50;
+    
+    if (journal == nullptr || !Configuration::instance()->m_mqttConnected)
+        return;
+    
+    try {
+        nlohmann::json request = nlohmann::json::parse(message);
+        if (request.is_number_unsigned())
+            count = request.get<size_t>();
+        else if (request.contains("count"))
+            count = request["count"].get<size_t>();
     }
-    if (topic == "aquarium2/waterlevel/rapidfire/start") {
-        ITimer *t = new ITimer();
-        t->setInterval(rapidFireWaterLevelMessaging, 500);
-        g_stopRapidFireWaterLevel = false;
+    catch (std::exception &e) {
+        LOGI("Error history request without a count", "count", count);
     }
-    if (topic == "aquarium2/waterlevel/rapidfire/stop") {
-        g_stopRapidFireWaterLevel = true;        
+    if (count > 500)
+        count = 500;
+    
+    j["aquarium"]["errors"] = nlohmann::json::array();
+    for (auto &entry : journal->recent(count)) {
+        nlohmann::json e;
+        e["event"] = ErrorJournal::eventName(entry.event);
+        e["type"] = priorities[entry.priority <= BaseError::FATAL ? entry.priority : BaseError::FATAL];
+        e["handle"] = entry.handle;
+        e["epoch"] = entry.timestamp / 1000000000ULL;
+        e["duration"] = entry.duration;
+        e["repeats"] = entry.repeats;
+        e["message"] = entry.message;
+        j["aquarium"]["errors"].push_back(e);
+    }
+    j["aquarium"]["dropped"] = journal->dropped();
+    
+    publishLocal(tankTopic(tank, "errors/history"), j.dump());
+}
+
+/*
+ * Topics are matched against each tank's namespace. Rapid fire is per
+ * tank, the probe names and error history are daemon wide and answer
+ * on whichever tank asked, and the pump only listens on the first tank.
+ */
+void mqttIncomingMessage(std::string topic, std::string message)
+{
+    bool first = true;
+    
+    LOGD("Handling topic", "topic", topic);
+    SessionRecorder::instance()->recordMqttMessage(topic, message);
+    
+    for (auto &tank : SensorRegistry::instance()->tanks()) {
+        std::string prefix = tank.topic + "/";
+        bool isFirst = first;
+        
+        first = false;
+        if (topic.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        
+        std::string sub = topic.substr(prefix.size());
+        if (sub == "errors/history/get") {
+            sendErrorHistory(tank, message);
+        }
+        if (sub == "set/ds18b20") {
+            nameTempProbe(message);
+        }
+        if (sub == "waterlevel/rapidfire/start") {
+            startRapidFireWaterLevel(tank);
+        }
+        if (sub == "waterlevel/rapidfire/stop") {
+            stopRapidFireWaterLevel(tank);
+        }
+        if (sub.compare(0, 10, "calibrate/") == 0) {
+            handleCalibration(tank, sub.substr(10), message);
+        }
+        if (sub == "set/pump" && isFirst && Configuration::instance()->m_pump) {
+            Configuration::instance()->m_pump->setRunning(cisCompare(message, "on"));
+        }
     }
 }
 
 void mqttConnectionLost(const std::string &cause)
 {
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << "MQTT disconnected: " << cause << std::endl;
+    LOGW("MQTT disconnected", "cause", cause);
     Configuration::instance()->m_mqttConnected = false;
-    g_errors.warning("MQTT connection lost", Configuration::instance()->m_mqtt, 0, ErrorHandler::StaticErrorHandles::MqttConnectionLost);
+    g_errors.warning("MQTT connection lost", Configuration::instance()->m_mqtt, 0, ErrorHandler::StaticErrorHandles::MqttConnectionLost, errorTopic());
 }
 
 void mqttConnected()
 {
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": MQTT connected!" << std::endl;
+    LOGN("MQTT connected");
     Configuration::instance()->m_mqttConnected = true;
 
-    Configuration::instance()->m_mqtt->subscribe("aquarium2/set/#", 1);
-    Configuration::instance()->m_mqtt->subscribe("aquarium2/waterlevel/rapidfire/#", 1);
+    for (auto &tank : SensorRegistry::instance()->tanks()) {
+        Configuration::instance()->m_mqtt->subscribe(tankTopic(tank, "set/#"), 1);
+        Configuration::instance()->m_mqtt->subscribe(tankTopic(tank, "waterlevel/rapidfire/#"), 1);
+        Configuration::instance()->m_mqtt->subscribe(tankTopic(tank, "errors/history/get"), 1);
+        Configuration::instance()->m_mqtt->subscribe(tankTopic(tank, "calibrate/#"), 1);
+    }
 
     g_finished = true;
     g_mqttCV.notify_all();
@@ -483,18 +1062,18 @@ void mqttConnected()
 
 void aioIncomingMessage(std::string topic, std::string message)
 {
-    std::cout << __FUNCTION__ << ": Odd, we shouldn't get messages from AIO" << std::endl;
+    LOGW("Odd, we shouldn't get messages from AIO", "topic", topic);
 }
 
 void aioConnected()
 {
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << "AIO connected!" << std::endl;
+    LOGN("AIO connected");
     Configuration::instance()->m_aioConnected = true;
 }
 
 void aioConnectionLost(const std::string &cause)
 {
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__  << ": AIO disconnected: " << cause << std::endl;
+    LOGW("AIO disconnected", "cause", cause);
     Configuration::instance()->m_aioEnabled = false;
 }
 
@@ -506,45 +1085,91 @@ void aioConnectionLost(const std::string &cause)
  */
 void mainloop()
 {
-    ITimer doUpdate;
-    ITimer phUpdate;
-    ITimer sendLocalUpdate;
     ITimer tempCompensation;
-    ITimer sendAIOUpdate;
+    ITimer pumpCheck;
     
-    auto phfunc = [](void*) { Configuration::instance()->m_ph->sendReadCommand(900); };
-    auto dofunc = [](void*) { Configuration::instance()->m_oxygen->sendReadCommand(600); };
-    auto updateLocalFunc = [](void*) { sendLocalResultData(); };
     auto compFunc = [](void*) { setTempCompensation(); };
-    auto updateAIO = [](void*) { sendAIOResultData(); };
+    auto pumpFunc = [](void*) { checkPumpInterlocks(); };
     
-    doUpdate.setInterval(dofunc, TEN_SECONDS);
-    phUpdate.setInterval(phfunc, TEN_SECONDS);
-    sendLocalUpdate.setInterval(updateLocalFunc, ONE_MINUTE);
-    sendAIOUpdate.setInterval(updateAIO, ONE_MINUTE);
-    tempCompensation.setInterval(compFunc, ONE_HOUR);
+    tempCompensation.setInterval(compFunc, SessionRecorder::instance()->scale(ONE_HOUR));
+    if (Configuration::instance()->m_pump)
+        pumpCheck.setInterval(pumpFunc, SessionRecorder::instance()->scale(ONE_SECOND));
     
-    setTempCompensation();
+    SensorRegistry::instance()->start();
+    
+    g_cycle.addSink(sendLocalResultData);
+    g_cycle.addSink(sendAIOResultData);
+    g_cycle.start(Configuration::instance()->m_cycleInterval, Configuration::instance()->m_cycleTrigger, Configuration::instance()->m_cycleSettle);
     
     while (!g_exitImmediately) {
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        checkForStaleProbes();
+        if (Tracer::dumpRequested())
+            Tracer::instance()->dump(Configuration::instance()->m_traceFile);
     }
     
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": exiting main loop..." << std::endl;
+    LOGN("Exiting main loop");
     
-    auto toks = Configuration::instance()->m_mqtt->get_pending_delivery_tokens();
-    if (!toks.empty())
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Error: There are pending delivery tokens!" << std::endl;
+    if (Configuration::instance()->m_mqtt) {
+        auto toks = Configuration::instance()->m_mqtt->get_pending_delivery_tokens();
+        if (!toks.empty())
+            LOGE("There are pending delivery tokens", "count", toks.size());
+    }
+    if (SessionRecorder::instance()->replaying())
+        LOGN("Replay finished", "messages", g_replayPublished.load());
 
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Disconnecting MQTT" << std::endl;
-    auto conntok = Configuration::instance()->m_mqtt->disconnect();
-    conntok->wait();
+    g_errors.stop();
+    if (g_errors.journal())
+        g_errors.journal()->stop();
+    LedEngine::instance()->setCondition(LedEngine::SHUTDOWN, true);
+    LedEngine::instance()->stop();
     
-    doUpdate.stop();
-    phUpdate.stop();
-    sendLocalUpdate.stop();
-    sendAIOUpdate.stop();
+    if (Configuration::instance()->m_mqtt) {
+        LOGN("Disconnecting MQTT");
+        auto conntok = Configuration::instance()->m_mqtt->disconnect();
+        conntok->wait();
+    }
+    
+    g_cycle.stop();
+    stopCalibrations();
+    SensorRegistry::instance()->stop();
     tempCompensation.stop();
+    pumpCheck.stop();
+    g_debouncer.stop();
+    g_metrics.stop();
+    if (Configuration::instance()->m_pump)
+        Configuration::instance()->m_pump->stop();
+    SessionRecorder::instance()->stop();
+    Logger::instance()->stop();
+}
+
+/**
+ * \fn void startMetrics()
+ * 
+ * Register the queue depths and process values that are read when the
+ * endpoint is scraped, then start serving on the socket or port from
+ * the config. Nothing is served if neither is set.
+ */
+void startMetrics()
+{
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    
+    registry->registerProcessMetrics();
+    registry->callback("aquarium_queue_depth", "Items waiting in an internal queue", []() { return g_errors.queued(); }, "queue=\"errors\"");
+    registry->callback("aquarium_queue_depth", "Items waiting in an internal queue", []() { return g_debouncer.queued(); }, "queue=\"gpio\"");
+    registry->callback("aquarium_queue_depth", "Items waiting in an internal queue", []() {
+        return g_errors.journal() ? g_errors.journal()->queued() : 0;
+    }, "queue=\"journal\"");
+    registry->callback("aquarium_queue_depth", "Items waiting in an internal queue", []() {
+        if (Configuration::instance()->m_mqtt == nullptr)
+            return 0.0;
+        return static_cast<double>(Configuration::instance()->m_mqtt->get_pending_delivery_tokens().size());
+    }, "queue=\"mqtt\"");
+    
+    if (!Configuration::instance()->m_metricsSocket.empty())
+        g_metrics.start(Configuration::instance()->m_metricsSocket);
+    else if (Configuration::instance()->m_metricsPort > 0)
+        g_metrics.start(Configuration::instance()->m_metricsPort, Configuration::instance()->m_metricsAddress);
 }
 
 void usage(const char *name)
@@ -553,6 +1178,9 @@ void usage(const char *name)
     std::cerr << "\t-c alternate configuration file (defaults to $HOME/.config/aquarium.conf" << std::endl;
     std::cerr << "\t-h Print usage and exit" << std::endl;
     std::cerr << "\t-d Daemonize the application to run in the background (currently not functional)" << std::endl;
+    std::cerr << "\t-r <file> Record every hardware exchange and inbound MQTT message to a session log" << std::endl;
+    std::cerr << "\t-p <file> Play back a session log in place of the hardware" << std::endl;
+    std::cerr << "\t-s <speed> Playback speed multiplier (defaults to 1)" << std::endl;
     exit(-1);
 }
 
@@ -572,11 +1200,14 @@ bool parse_args(int argc, char **argv)
     int opt;
     bool rval = true;
     std::string cf = "~/.config/aquarium.conf";
+    std::string capture;
+    std::string replay;
+    double speed = 1.0;
     
     Configuration::instance()->m_daemonize = false;
     
     if (argv) {
-        while ((opt = getopt(argc, argv, "c:hd")) != -1) {
+        while ((opt = getopt(argc, argv, "c:hdr:p:s:")) != -1) {
             switch (opt) {
             case 'h':
                 usage(argv[0]);
@@ -588,8 +1219,17 @@ bool parse_args(int argc, char **argv)
             case 'd':
                 Configuration::instance()->m_daemonize = true;
                 break;
+            case 'r':
+                capture = optarg;
+                break;
+            case 'p':
+                replay = optarg;
+                break;
+            case 's':
+                speed = std::atof(optarg);
+                break;
             default:
-                syslog(LOG_ERR, "Unexpected command line argument given");
+                LOGE("Unexpected command line argument given");
                 usage(argv[0]);
                 return false;
             }
@@ -607,22 +1247,44 @@ bool parse_args(int argc, char **argv)
                 cf.erase(0, 5);
                 cf.insert(0, homeDir);
             }
-            std::cerr  << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Changing config file path to " << cf << std::endl;
+            LOGI("Changing config file path", "path", cf);
             Configuration::instance()->setConfigFile(cf);
         }
     }
 
+    if (replay.size() > 0) {
+        if (!SessionRecorder::instance()->startReplay(replay, speed))
+            return false;
+    }
+    else if (capture.size() > 0) {
+        if (!SessionRecorder::instance()->startCapture(capture))
+            return false;
+    }
+
     return rval;
 }
 
+/*
+ * SIGUSR1 asks the main loop to write the trace buffers out, SIGUSR2
+ * turns tracing on and off. Neither does any work in the handler.
+ */
+void handle_sigusr(int sig)
+{
+    if (sig == SIGUSR1)
+        Tracer::requestDump();
+    else if (sig == SIGUSR2)
+        Tracer::setEnabled(!Tracer::enabled());
+}
+
+/*
+ * Not through the logger, the signal can land while this thread is
+ * halfway through writing a record into its own buffer.
+ */
 void handle_sigint(int sig)
 {
     g_exitImmediately = true;
     std::cerr << "Exiting due to signal";
     syslog(LOG_ERR, "Exiting due to signal %d", sig);
-    digitalWrite(Configuration::instance()->m_greenLed, LOW);
-    digitalWrite(Configuration::instance()->m_yellowLed, LOW);
-    digitalWrite(Configuration::instance()->m_redLed, HIGH);
 }
 
 /**
@@ -638,62 +1300,108 @@ int main(int argc, char *argv[])
     
     openlog(progname.c_str(), LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
     
-    syslog(LOG_NOTICE, "Application startup");
+    LOGN("Application startup");
     
     /** Do our best to clean up and exit if we can **/
     signal(SIGINT, handle_sigint);
     signal(SIGILL, handle_sigint);
     signal(SIGABRT, handle_sigint);
     signal(SIGFPE, handle_sigint);
+    signal(SIGUSR1, handle_sigusr);
+    signal(SIGUSR2, handle_sigusr);
     
+    // wiringPi is only used for the MCP3008 now, GPIO goes through the backend
     wiringPiSetupGpio();
     piHiPri(99);
     
     if (!parse_args(argc, argv)) {
-        std::cerr << "Error parsing command line, exiting..." << std::endl;
-        syslog(LOG_ERR, "Error parsing command line, exiting...");
+        LOGE("Error parsing command line, exiting...");
+        Logger::instance()->stop();
         exit(-1);
     }
+    Logger::setConsole(!Configuration::instance()->m_daemonize);
     
     // if this goes badly, just die but leave the error LED blinking at 1 hz
     if (!Configuration::instance()->readConfigFile()) {
-        std::cerr << "Unable to read configuration file, exiting..." << std::endl;
-        syslog(LOG_ERR, "Unable to read configuration file, exiting...");
+        LOGE("Unable to read configuration file, exiting...");
+        Logger::instance()->stop();
         exit(-2);
     }
 
-    initializeLeds();
+    if (SessionRecorder::instance()->replaying()) {
+        Gpio::instance()->setBackend(new FakeGpioBackend());
+    }
+    else {
+        GpioBackend *backend = Gpio::createBackend(Configuration::instance()->m_gpioBackend, Configuration::instance()->m_gpioChip);
+        // Without GPIO the overflow interlock and the pump relay don't work, don't pretend they do
+        if (backend == nullptr) {
+            LOGC("No GPIO backend, exiting...", "backend", Configuration::instance()->m_gpioBackend, "chip", Configuration::instance()->m_gpioChip);
+            Logger::instance()->stop();
+            exit(-3);
+        }
+        Gpio::instance()->setBackend(backend);
+    }
 
-    std::unique_lock<std::mutex> lk(g_mqttMutex);
-    Configuration::instance()->createLocalConnection();
-    Configuration::instance()->createAIOConnection();
+    if (!Configuration::instance()->m_errorJournal.empty()) {
+        ErrorJournal *journal = new ErrorJournal(Configuration::instance()->m_errorJournal, Configuration::instance()->m_errorJournalSize * 1024, Configuration::instance()->m_errorJournalFiles);
+        if (journal->start())
+            g_errors.setJournal(journal);
+        else
+            delete journal;
+    }
 
-    g_mqttCV.wait(lk, []{return g_finished;});
+    startMetrics();
+    Tracer::setEnabled(Configuration::instance()->m_traceEnabled);
 
-    Configuration::instance()->m_mqtt->start_consuming();
+    initializeLeds();
+    LedEngine::instance()->setPins(Configuration::instance()->m_redLed, Configuration::instance()->m_yellowLed, Configuration::instance()->m_greenLed);
+    LedEngine::instance()->start();
 
-    Configuration::instance()->m_oxygen->setCallback(doCallback);
-    Configuration::instance()->m_ph->setCallback(phCallback);
+    if (SessionRecorder::instance()->replaying()) {
+        // Self contained, the publishers only count and incoming messages come from the recording
+        Configuration::instance()->m_mqttConnected = true;
+        Configuration::instance()->m_aioConnected = true;
+    }
+    else {
+        std::unique_lock<std::mutex> lk(g_mqttMutex);
+        Configuration::instance()->createLocalConnection();
+        Configuration::instance()->createAIOConnection();
 
-    Configuration::instance()->m_oxygen->sendInfoCommand();
-    Configuration::instance()->m_oxygen->calibrate(DissolvedOxygen::DO_QUERY, nullptr, 0);
-    Configuration::instance()->m_oxygen->getTempCompensation();
-    Configuration::instance()->m_oxygen->sendStatusCommand();
-    Configuration::instance()->m_oxygen->disableLeds();
+        g_mqttCV.wait(lk, []{return g_finished;});
 
+        Configuration::instance()->m_mqtt->start_consuming();
+    }
 
-    Configuration::instance()->m_ph->sendInfoCommand();
-    Configuration::instance()->m_ph->calibrate(PotentialHydrogen::PH_QUERY, nullptr, 0);
-    Configuration::instance()->m_ph->getTempCompensation();
-    Configuration::instance()->m_ph->sendStatusCommand();
-    Configuration::instance()->m_ph->disableLeds();
+    for (auto sensor : SensorRegistry::instance()->sensors())
+        sensor->setCallback(probeCallback);
     
     if (Configuration::instance()->m_gpioPortOne != 0) {
-        wiringPiISR(Configuration::instance()->m_gpioPortOne, INT_EDGE_BOTH, gpioPortOneISR);
+        g_gpioPortOneState = watchOverflow(Configuration::instance()->m_gpioPortOne, Configuration::instance()->m_gpioPortOneDebounce,
+                                           [](GpioEvent event) { gpioPortOneChanged(event.value); });
     }
     
     if (Configuration::instance()->m_gpioPortTwo != 0) {
-        wiringPiISR(Configuration::instance()->m_gpioPortTwo, INT_EDGE_BOTH, gpioPortTwoISR);
+        g_gpioPortTwoState = watchOverflow(Configuration::instance()->m_gpioPortTwo, Configuration::instance()->m_gpioPortTwoDebounce,
+                                           [](GpioEvent event) { gpioPortTwoChanged(event.value); });
+    }
+
+    if (Configuration::instance()->m_pump) {
+        if (g_gpioPortOneState)
+            Configuration::instance()->m_pump->overflow(Configuration::instance()->m_gpioPortOne, PumpController::now());
+        if (g_gpioPortTwoState)
+            Configuration::instance()->m_pump->overflow(Configuration::instance()->m_gpioPortTwo, PumpController::now());
+        Configuration::instance()->m_pump->start();
+    }
+
+    if (Configuration::instance()->m_flowRate) {
+        Gpio::instance()->watch(Configuration::instance()->m_flowRatePin, GpioBackend::RISING, flowRatePulse);
+    }
+
+    if (SessionRecorder::instance()->replaying()) {
+        SessionRecorder::instance()->setGpioHandler(replayGpioEdge);
+        SessionRecorder::instance()->setMqttHandler(mqttIncomingMessage);
+        SessionRecorder::instance()->setFinishedHandler([]() { g_exitImmediately = true; });
+        SessionRecorder::instance()->play();
     }
 
     sendTempProbeIdentification();
@@ -24,6 +24,8 @@
  */
 
 #include "atlasscientifici2c.h"
+#include "trace.h"
+#include "logger.h"
 
 AtlasScientificI2C::AtlasScientificI2C(uint8_t device, uint8_t address) : 
     m_address(address), m_device(device)
@@ -31,51 +33,112 @@ AtlasScientificI2C::AtlasScientificI2C(uint8_t device, uint8_t address) :
     char filename[40];
     sprintf(filename, "/dev/i2c-%d", m_device);
     m_enabled = false;
+    m_lastResponseSize = 0;
     
-    if (address > 0) {
+    m_fd = -1;
+    m_mux = nullptr;
+    m_channel = -1;
+    
+    std::string labels = "address=\"" + std::to_string(m_address) + "\"";
+    m_commandLatency = MetricsRegistry::instance()->histogram("aquarium_i2c_command_seconds", "Time from an EZO command write to its response", MetricsRegistry::latencyBuckets(), labels);
+    m_errors = MetricsRegistry::instance()->counter("aquarium_i2c_errors_total", "Failed i2c writes and reads", labels);
+    
+    if (address > 0 && SessionRecorder::instance()->replaying()) {
+        m_enabled = true;
+    }
+    else if (address > 0) {
         m_enabled = true;
 
         if ((m_fd = open(filename, O_RDWR)) < 0) {
-            syslog(LOG_ERR, "Failed to open i2c device %d", m_device);
+            LOGE("Failed to open i2c device", "device", m_device);
             m_enabled = false;
         }
 
         if (ioctl(m_fd, I2C_SLAVE, m_address) < 0) {
-            syslog(LOG_ERR, "Failed to acquire bus access and/or talk to slave at address %x", m_address);
+            LOGE("Failed to acquire bus access and/or talk to slave", "address", m_address);
             m_enabled = false;
         }
+        m_lease.reset(new I2cLease(m_device, m_address));
     }
 }
 
 AtlasScientificI2C::~AtlasScientificI2C()
 {
-    close(m_fd);
+    if (m_fd >= 0)
+        close(m_fd);
     m_enabled = false;
 }
 
-bool AtlasScientificI2C::sendCommand(int cmd, uint8_t *buf, int size, int delay)
+/**
+ * \fn void AtlasScientificI2C::setMux(I2cMux *mux, int channel)
+ * 
+ * For a circuit behind a TCA9548A. Every write and read after this
+ * selects the channel first and holds the bus while it talks. The
+ * metrics are relabelled, two circuits can share an address on
+ * different channels, and so is the lease.
+ */
+void AtlasScientificI2C::setMux(I2cMux *mux, int channel)
 {
+    m_mux = mux;
+    m_channel = channel;
+    if (m_lease)
+        m_lease.reset(new I2cLease(m_device, (((mux->address() << 3) | channel) << 7) | m_address));
+    
+    std::string labels = "address=\"" + std::to_string(m_address) + "\",mux=\"" + std::to_string(mux->address()) + "\",channel=\"" + std::to_string(channel) + "\"";
+    m_commandLatency = MetricsRegistry::instance()->histogram("aquarium_i2c_command_seconds", "Time from an EZO command write to its response", MetricsRegistry::latencyBuckets(), labels);
+    m_errors = MetricsRegistry::instance()->counter("aquarium_i2c_errors_total", "Failed i2c writes and reads", labels);
+}
+
+bool AtlasScientificI2C::sendCommand(int cmd, const uint8_t *buf, int size, int delay)
+{
+    TRACE_SCOPE("AtlasScientificI2C::sendCommand");
+    
     if (!m_enabled)
         return false;
     
     m_commandRunning.lock();
     
     m_lastCommand = cmd;
+    m_commandStart = std::chrono::steady_clock::now();
     
-    if (write(m_fd, buf, size) > 0) {
+    if (SessionRecorder::instance()->replaying()) {
+        t.setTimeout(std::bind(&AtlasScientificI2C::readValue, this), SessionRecorder::instance()->scale(delay));
+        return true;
+    }
+    
+    // Held until the response is read, nothing else may talk to the circuit in between
+    if (m_lease && !m_lease->acquire()) {
+        m_errors->inc();
+        LOGW("Timed out waiting for the i2c lease", "address", m_address, "command", cmd);
+        m_commandRunning.unlock();
+        return false;
+    }
+    
+    I2cMux::Hold bus;
+    if (m_mux && !(bus = m_mux->select(m_channel))) {
+        m_errors->inc();
+    }
+    else if (write(m_fd, buf, size) > 0) {
+        SessionRecorder::instance()->recordI2CWrite(m_device, m_address, buf, size);
         t.setTimeout(std::bind(&AtlasScientificI2C::readValue, this), delay);
         return true;
     }
     else {
-        syslog(LOG_ERR, "Error writing i2c event\n");
+        m_errors->inc();
+        LOGE("Error writing i2c event", "address", m_address, "command", cmd);
     }
+    // No read is coming to release it
+    if (m_lease)
+        m_lease->release();
+    m_commandRunning.unlock();
     return false;
 }
 
 void AtlasScientificI2C::readValue()
 {
+    TRACE_SCOPE("AtlasScientificI2C::readValue");
     uint8_t buffer[MAX_READ_SIZE];
-    int index = 0;
+    int index = MAX_READ_SIZE;
     int bytes = 0;
     
     if (!m_enabled)
@@ -83,59 +146,66 @@ void AtlasScientificI2C::readValue()
     
     memset(buffer, 0, MAX_READ_SIZE);
     
-    if ((bytes = read(m_fd, buffer, MAX_READ_SIZE)) > 0) {
+    if (SessionRecorder::instance()->replaying()) {
+        bytes = MAX_READ_SIZE;
+        if (!SessionRecorder::instance()->nextI2CRead(m_device, m_address, buffer, bytes))
+            bytes = 0;
+    }
+    else {
+        I2cMux::Hold bus;
+        if (m_mux && !(bus = m_mux->select(m_channel)))
+            bytes = 0;
+        else if ((bytes = read(m_fd, buffer, MAX_READ_SIZE)) > 0)
+            SessionRecorder::instance()->recordI2CRead(m_device, m_address, buffer, bytes);
+        if (m_lease)
+            m_lease->release();
+    }
+    
+    if (bytes > 0) {
         for (int i = 0; i < MAX_READ_SIZE; i++) {
             if (buffer[i] == 0) {
                 index = i;
                 break;
             }
-            m_lastResponse.push_back(buffer[i]);
         }
+        memcpy(m_lastResponse, buffer, index);
+        m_lastResponseSize = index;
+        m_commandLatency->observeSince(m_commandStart);
         response(m_lastCommand, buffer, index);
     }
     else {
-        std::cerr << "Unable to read value from i2c device" << std::endl;
-        syslog(LOG_ERR, "Unable to read from i2c device at address %x", m_address);
+        m_errors->inc();
+        LOGE("Unable to read from i2c device", "address", m_address, "command", m_lastCommand);
     }
     m_commandRunning.unlock();
 }
 
 bool AtlasScientificI2C::sendInfoCommand()
 {
+    static constexpr EzoCommand info("i");
+    
     if (!m_enabled)
         return false;
     
-    uint8_t i[1] = {'i'};
-    return sendCommand(INFO, i, 1, 300);
+    return sendCommand(INFO, info, 300);
 }
 
 bool AtlasScientificI2C::sendStatusCommand()
 {
+    static constexpr EzoCommand status("status");
+    
     if (!m_enabled)
         return false;
     
-    uint8_t i[] = {'s','t','a','t','u','s'};
-    return sendCommand(STATUS, i, 6, 300);
+    return sendCommand(STATUS, status, 300);
 }
 
 bool AtlasScientificI2C::sendReadCommand(int delay)
 {
+    static constexpr EzoCommand read("r");
+    
     if (!m_enabled)
         return false;
     
-    uint8_t i[1] = {'r'};
-    return sendCommand(READING, i, 1, delay);
-}
-
-std::vector<std::string> AtlasScientificI2C::split(const std::string& s, char delimiter)
-{
-   std::vector<std::string> tokens;
-   std::string token;
-   std::istringstream tokenStream(s);
-   while (std::getline(tokenStream, token, delimiter))
-   {
-        token.erase(std::remove_if(token.begin(), token.end(), []( auto const& c ) -> bool { return !std::isprint(c); } ), token.end());
-        tokens.push_back(token);
-   }
-   return tokens;
+    return sendCommand(READING, read, delay);
 }
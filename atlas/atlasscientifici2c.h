@@ -32,6 +32,8 @@
 #include <iostream>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <memory>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -44,6 +46,11 @@
 #include <syslog.h>
 
 #include "itimer.h"
+#include "ezocommand.h"
+#include "i2cmux.h"
+#include "i2clease.h"
+#include "sessionrecorder.h"
+#include "metrics.h"
 
 #define MAX_READ_SIZE   64
 
@@ -63,23 +70,25 @@ public:
     AtlasScientificI2C(uint8_t, uint8_t);
     virtual ~AtlasScientificI2C();
     
-    bool sendCommand(int, uint8_t*, int, int);
+    bool sendCommand(int, const uint8_t*, int, int);
+    bool sendCommand(int cmd, const EzoCommand &command, int delay) { return sendCommand(cmd, command.data(), command.size(), delay); }
     bool sendInfoCommand();
     bool sendReadCommand(int);
     bool sendStatusCommand();
     bool enabled() { return m_enabled; }
+    void setMux(I2cMux *mux, int channel);
     
     virtual void response(int, uint8_t*, int) = 0;
 
-    std::vector<uint8_t> m_lastResponse;
     uint8_t m_address;
     uint8_t m_device;
     int m_lastCommand;
     std::string m_version;
-    std::vector<std::string> split(const std::string& s, char delimiter);
     
 protected:
     bool m_enabled;
+    uint8_t m_lastResponse[MAX_READ_SIZE];
+    int m_lastResponseSize;
     
 private:
     void readValue();
@@ -87,6 +96,12 @@ private:
     std::mutex m_commandRunning;
     ITimer t;
     int m_fd;
+    I2cMux *m_mux;
+    int m_channel;
+    std::unique_ptr<I2cLease> m_lease;
+    std::chrono::steady_clock::time_point m_commandStart;
+    Histogram *m_commandLatency;
+    Counter *m_errors;
 };
 
 #endif // ATLASSCIENTIFICI2C_H
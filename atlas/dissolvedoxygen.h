@@ -26,50 +26,26 @@
 #ifndef DISSOLVEDOXYGEN_H
 #define DISSOLVEDOXYGEN_H
 
-#include <iostream>
-#include <functional>
-#include <string>
-#include <iomanip>
+#include "ezoprobe.h"
 
-#include <syslog.h>
-
-#include "atlasscientifici2c.h"
-
-class DissolvedOxygen : public AtlasScientificI2C
+/**
+ * \class DissolvedOxygen
+ * 
+ * The EZO DO circuit, nothing beyond the common commands.
+ */
+class DissolvedOxygen : public EzoProbe<DissolvedOxygen, DoTraits>
 {
 public:
-    static const int DO_CLEAR = 100;
+    static const int DO_CLEAR = EZO_CAL_CLEAR;
     static const int DO_DEFAULT = 101;
     static const int DO_LOW = 102;
     static const int DO_ZERO = 102;
-    static const int DO_QUERY = 104;
- 
-    DissolvedOxygen(uint8_t, uint8_t);
-    virtual ~DissolvedOxygen();
-
-    void getLastResponse(std::string&);
-    void setCallback(std::function<void(int, std::string)> cbk) { m_callback = cbk; }
-    void calibrate(int, uint8_t*, int);
-    void response(int cmd, uint8_t*, int) override;
-    double getDO() { return m_lastDOValue; }
-    void setTempCompensation(uint8_t*, int);
-    void setTempCompensation(double);
-    void setTempCompensationAndRead(uint8_t*, int);
-    void setTempCompensationAndRead(double);
-    void getTempCompensation();
-    void disableLeds();
-
-private:
-    void handleCalibration(std::string);
-    void handleStatusResponse(std::string);
-    void handleReadResponse(std::string&);
-    void printBuffer(std::vector<uint8_t>&);
+    static const int DO_QUERY = EZO_CAL_QUERY;
+    
+    using EzoProbe::EzoProbe;
     
-    std::function<void(int, std::string)> m_callback;
-    int m_calibration;
-    std::string m_lastResetReason;
-    double m_lastVoltage;
-    double m_lastDOValue;
+    double getDO() { return value(); }
+    double getRawDO() { return raw(); }
 };
 
 #endif // DISSOLVEDOXYGEN_H
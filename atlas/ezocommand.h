@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EZOCOMMAND_H
+#define EZOCOMMAND_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string_view>
+
+#define EZO_COMMAND_SIZE    32
+#define EZO_MAX_FIELDS      8
+
+/**
+ * \class EzoCommand
+ * 
+ * An EZO command in a fixed buffer. The text part is built at compile
+ * time from the command tables, a calibration or compensation value is
+ * appended at runtime without touching the heap.
+ */
+class EzoCommand
+{
+public:
+    constexpr EzoCommand() : m_data{}, m_size(0) {}
+    constexpr EzoCommand(const char *text) : m_data{}, m_size(0)
+    {
+        append(text);
+    }
+    
+    constexpr bool append(const char *text)
+    {
+        while (*text) {
+            if (!push(*text++))
+                return false;
+        }
+        return true;
+    }
+    
+    /*
+     * Same text std::fixed with setprecision() gave, which is what the
+     * probes have always been sent.
+     */
+    bool append(double value, int decimals = 3)
+    {
+        char digits[24];
+        int count = 0;
+        unsigned long long scale = 1;
+        
+        if (!std::isfinite(value) || std::fabs(value) > 1e9)
+            return false;
+        
+        for (int i = 0; i < decimals; i++)
+            scale *= 10;
+        
+        if (std::signbit(value) && value != 0) {
+            if (!push('-'))
+                return false;
+            value = -value;
+        }
+        
+        unsigned long long scaled = std::llround(value * scale);
+        for (int i = 0; i < decimals; i++) {
+            digits[count++] = '0' + (scaled % 10);
+            scaled /= 10;
+        }
+        if (decimals)
+            digits[count++] = '.';
+        do {
+            digits[count++] = '0' + (scaled % 10);
+            scaled /= 10;
+        } while (scaled);
+        
+        while (count)
+            if (!push(digits[--count]))
+                return false;
+        return true;
+    }
+    
+    constexpr const uint8_t* data() const { return m_data; }
+    constexpr int size() const { return m_size; }
+    std::string_view text() const { return std::string_view(reinterpret_cast<const char*>(m_data), m_size); }
+    
+private:
+    constexpr bool push(char c)
+    {
+        if (m_size >= EZO_COMMAND_SIZE)
+            return false;
+        m_data[m_size++] = static_cast<uint8_t>(c);
+        return true;
+    }
+    
+    uint8_t m_data[EZO_COMMAND_SIZE];
+    int m_size;
+};
+
+/**
+ * \class EzoResponse
+ * 
+ * A reply as it comes off the bus, split on commas in place. The first
+ * byte is the EZO response code, the fields are views into the buffer
+ * with anything unprintable stripped from the ends.
+ */
+class EzoResponse
+{
+public:
+    static const uint8_t SUCCESS = 1;
+    static const uint8_t SYNTAX_ERROR = 2;
+    static const uint8_t PENDING = 254;
+    static const uint8_t NO_DATA = 255;
+    
+    EzoResponse(const uint8_t *buffer, int size) : m_code(0), m_count(0)
+    {
+        const char *text = reinterpret_cast<const char*>(buffer);
+        
+        if (size > 0 && !isText(buffer[0])) {
+            m_code = buffer[0];
+            text++;
+            size--;
+        }
+        m_text = trim(std::string_view(text, size > 0 ? size : 0));
+        
+        std::string_view rest = m_text;
+        while (rest.size() && m_count < EZO_MAX_FIELDS) {
+            std::string_view::size_type comma = rest.find(',');
+            m_fields[m_count++] = trim(rest.substr(0, comma));
+            if (comma == std::string_view::npos)
+                break;
+            rest.remove_prefix(comma + 1);
+        }
+    }
+    
+    uint8_t code() const { return m_code; }
+    int count() const { return m_count; }
+    std::string_view text() const { return m_text; }
+    std::string_view field(int index) const { return index < m_count ? m_fields[index] : std::string_view(); }
+    
+    /*
+     * Copied out so strtod sees a terminated string, the fields are
+     * only ever a handful of characters.
+     */
+    bool number(int index, double &value) const
+    {
+        char buffer[24];
+        char *end = nullptr;
+        std::string_view f = field(index);
+        
+        if (f.empty() || f.size() >= sizeof(buffer))
+            return false;
+        
+        f.copy(buffer, f.size());
+        buffer[f.size()] = '\0';
+        value = std::strtod(buffer, &end);
+        return end == buffer + f.size();
+    }
+    
+private:
+    static bool isText(uint8_t c) { return c >= 0x20 && c < 0x7f; }
+    
+    static std::string_view trim(std::string_view s)
+    {
+        while (s.size() && !isText(s.front()))
+            s.remove_prefix(1);
+        while (s.size() && !isText(s.back()))
+            s.remove_suffix(1);
+        return s;
+    }
+    
+    std::string_view m_text;
+    std::string_view m_fields[EZO_MAX_FIELDS];
+    uint8_t m_code;
+    int m_count;
+};
+
+#endif // EZOCOMMAND_H
@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EZOPROBE_H
+#define EZOPROBE_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <mutex>
+#include <cmath>
+#include <cctype>
+
+#include "atlasscientifici2c.h"
+#include "ezocommand.h"
+#include "ezotraits.h"
+#include "filterchain.h"
+#include "sample.h"
+#include "logger.h"
+
+/**
+ * \class EzoProbe
+ * 
+ * Everything the EZO circuits have in common, specialised at compile
+ * time by a traits struct. Commands come from constexpr tables into a
+ * fixed buffer and replies are split in place, so neither side of an
+ * exchange allocates. A probe with replies of its own, like the pH
+ * slope, handles them in a decode(int, const EzoResponse&) of its own
+ * which is found through Derived, not a virtual.
+ * 
+ * Every reading attempt updates the probe's Sample. A good reading
+ * goes through the filter chain and is stamped with the time it came
+ * in. A reply that won't parse or is outside the traits range only
+ * sets its quality bit, the filters never see it and the value and
+ * time stay those of the last good reading, so its age keeps growing.
+ */
+template<typename Derived, typename Traits>
+class EzoProbe : public AtlasScientificI2C
+{
+public:
+    static const int CAL_CLEAR = EZO_CAL_CLEAR;
+    static const int CAL_QUERY = EZO_CAL_QUERY;
+    
+    EzoProbe(uint8_t device, uint8_t address) : AtlasScientificI2C(device, address)
+    {
+        m_filter = nullptr;
+        m_calibration = 0;
+        m_lastVoltage = 0.0;
+        m_lastValue = 0.0;
+        m_tempCompensation = NAN;
+    }
+    
+    static constexpr const char* type() { return Traits::device; }
+    
+    void setCallback(std::function<void(int, std::string)> cbk) { m_callback = cbk; }
+    void setFilter(FilterChain *filter) { m_filter = filter; }
+    double value() { return sample().value; }
+    double raw() { return m_lastValue; }
+    
+    Sample sample()
+    {
+        std::lock_guard<std::mutex> lock(m_sampleMutex);
+        Sample current = m_sample;
+        
+        if (!m_enabled)
+            current.quality |= Sample::DISABLED;
+        return current;
+    }
+    double getVoltage() { return m_lastVoltage; }
+    std::string getLastReason() { return m_lastResetReason; }
+    int calibrationPoints() { return m_calibration; }
+    
+    using AtlasScientificI2C::sendReadCommand;
+    bool sendReadCommand() { return sendReadCommand(Traits::readDelay); }
+    
+    void getLastResponse(std::string &r)
+    {
+        if (!m_enabled)
+            return;
+        
+        r.assign(reinterpret_cast<const char*>(m_lastResponse), m_lastResponseSize);
+    }
+    
+    /**
+     * \fn bool calibrate(int cmd, double value)
+     * 
+     * Runs one row of the traits calibration table. Rows that take a
+     * value get it appended, the others ignore it.
+     */
+    bool calibrate(int cmd, double value)
+    {
+        const EzoCalibration *row = ezoCalibration(Traits::calibrations, cmd);
+        
+        if (!m_enabled || row == nullptr)
+            return false;
+        
+        EzoCommand command(row->command);
+        if (row->value && !command.append(value))
+            return false;
+        
+        LOGI("Calibration", "probe", Traits::device, "command", command.text());
+        return sendCommand(AtlasScientificI2C::CALIBRATE, command, row->delay);
+    }
+    
+    /*
+     * Points that need a value take the last raw reading, the probe is
+     * sitting in the solution being calibrated against.
+     */
+    bool calibrate(int cmd)
+    {
+        return calibrate(cmd, m_lastValue);
+    }
+    
+    void setTempCompensation(double temp)
+    {
+        static constexpr EzoCommand prefix("T,");
+        
+        if (!m_enabled || !Traits::tempCompensation)
+            return;
+        
+        EzoCommand command(prefix);
+        if (!command.append(temp))
+            return;
+        m_tempCompensation = temp;
+        sendCommand(AtlasScientificI2C::SETTEMPCOMP, command, 300);
+    }
+    
+    /*
+     * One transaction in place of T, and r. The reply is a reading and
+     * goes to the callback as one. Circuits without compensation just
+     * take the reading.
+     */
+    bool setTempCompensationAndRead(double temp)
+    {
+        static constexpr EzoCommand prefix("RT,");
+        
+        if (!m_enabled)
+            return false;
+        if (!Traits::tempCompensation)
+            return sendReadCommand();
+        
+        EzoCommand command(prefix);
+        if (!command.append(temp))
+            return sendReadCommand();
+        m_tempCompensation = temp;
+        return sendCommand(AtlasScientificI2C::SETTEMPCOMPREAD, command, Traits::readDelay);
+    }
+    
+    void getTempCompensation()
+    {
+        static constexpr EzoCommand query("T,?");
+        
+        if (!m_enabled || !Traits::tempCompensation)
+            return;
+        
+        sendCommand(AtlasScientificI2C::GETTEMPCOMP, query, 300);
+    }
+    
+    void disableLeds()
+    {
+        static constexpr EzoCommand leds("L,0");
+        
+        if (!m_enabled)
+            return;
+        
+        sendCommand(AtlasScientificI2C::DISABLELEDS, leds, 300);
+    }
+    
+    void response(int cmd, uint8_t *buffer, int size) override final
+    {
+        if (!m_enabled)
+            return;
+        
+        EzoResponse reply(buffer, size);
+        
+        switch (cmd) {
+            case AtlasScientificI2C::INFO:
+                decodeInfo(reply);
+                break;
+            case AtlasScientificI2C::CALIBRATE:
+                decodeCalibration(reply);
+                break;
+            case AtlasScientificI2C::STATUS:
+                decodeStatus(reply);
+                break;
+            case AtlasScientificI2C::READING:
+                decodeReading(reply);
+                break;
+            case AtlasScientificI2C::SETTEMPCOMPREAD:
+                decodeReading(reply);
+                cmd = AtlasScientificI2C::READING;
+                break;
+            default:
+                static_cast<Derived*>(this)->decode(cmd, reply);
+                break;
+        }
+        
+        if (m_callback)
+            m_callback(cmd, std::string(reinterpret_cast<const char*>(buffer), size));
+    }
+    
+protected:
+    void decode(int cmd, const EzoResponse &reply) {}
+    
+    static bool matches(std::string_view field, std::string_view expected)
+    {
+        if (field.size() != expected.size())
+            return false;
+        for (std::string_view::size_type i = 0; i < field.size(); i++) {
+            if (std::toupper(field[i]) != std::toupper(expected[i]))
+                return false;
+        }
+        return true;
+    }
+    
+    FilterChain *m_filter;
+    int m_calibration;
+    std::string m_lastResetReason;
+    double m_lastVoltage;
+    double m_lastValue;
+    double m_tempCompensation;
+    
+private:
+    void decodeInfo(const EzoResponse &reply)
+    {
+        if (reply.count() == 3) {
+            m_version = std::string(reply.field(2));
+            if (reply.field(1) != Traits::device) {
+                m_enabled = false;
+                LOGE("Reply was from another type of sensor", "expected", Traits::device, "type", reply.field(1));
+            }
+            else {
+                LOGI("EZO sensor is enabled", "probe", Traits::device, "version", m_version);
+                m_enabled = true;
+            }
+        }
+        else {
+            LOGE("Reply from sensor confused me", "probe", Traits::device, "response", reply.text());
+            m_enabled = false;
+        }
+    }
+    
+    void decodeCalibration(const EzoResponse &reply)
+    {
+        if (reply.count() == 0) {
+            LOGI("Calibration event accepted", "probe", Traits::device);
+        }
+        else if (reply.count() == 2 && matches(reply.field(0), "?CAL")) {
+            double points = 0;
+            if (reply.number(1, points)) {
+                m_calibration = static_cast<int>(points);
+                LOGI("Device calibration", "probe", Traits::device, "points", m_calibration);
+            }
+            else {
+                LOGE("Calibration query returned a non number", "probe", Traits::device, "response", reply.text());
+            }
+        }
+        else if (reply.count() == 2) {
+            m_calibration = 0;
+            LOGE("Reply from sensor confused me", "probe", Traits::device, "response", reply.text());
+        }
+        else {
+            LOGE("Reply from sensor confused me", "probe", Traits::device, "response", reply.text());
+            m_enabled = false;
+        }
+    }
+    
+    void decodeStatus(const EzoResponse &reply)
+    {
+        double voltage = 0;
+        
+        if (reply.count() == 3 && matches(reply.field(0), "?STATUS")) {
+            if (reply.number(2, voltage)) {
+                m_lastVoltage = voltage;
+                m_lastResetReason = std::string(reply.field(1));
+            }
+            else {
+                LOGE("Status query returned a non number", "probe", Traits::device, "response", reply.text());
+            }
+        }
+        else {
+            m_lastVoltage = 0.0;
+            m_lastResetReason = "U";
+            LOGE("Reply from sensor confused me", "probe", Traits::device, "response", reply.text());
+        }
+    }
+    
+    /*
+     * Circuits set to output more than one value (EC with TDS, salinity
+     * and SG turned on) put the primary reading first.
+     */
+    void decodeReading(const EzoResponse &reply)
+    {
+        double value = 0;
+        
+        if (!reply.number(0, value)) {
+            LOGW("Unable to decode response", "probe", Traits::device, "response", reply.text());
+            setQuality(Sample::PARSE_ERROR, m_lastValue);
+            return;
+        }
+        if (value < Traits::minimum || value > Traits::maximum) {
+            LOGW("Reading out of range", "probe", Traits::device, "value", value);
+            setQuality(Sample::OUT_OF_RANGE, value);
+            return;
+        }
+        
+        Sample reading(value, value, Sample::now(), Sample::FRESH);
+        if (m_filter)
+            reading = m_filter->process(reading, m_tempCompensation);
+        
+        m_lastValue = value;
+        std::lock_guard<std::mutex> lock(m_sampleMutex);
+        m_sample = reading;
+    }
+    
+    void setQuality(Sample::Quality quality, double raw)
+    {
+        std::lock_guard<std::mutex> lock(m_sampleMutex);
+        m_sample.raw = raw;
+        m_sample.quality = quality;
+    }
+    
+    std::function<void(int, std::string)> m_callback;
+    std::mutex m_sampleMutex;
+    Sample m_sample;
+};
+
+/*
+ * Circuits with nothing beyond the common commands are just their
+ * traits.
+ */
+class Conductivity : public EzoProbe<Conductivity, EcTraits>
+{
+public:
+    static const int EC_DRY = 101;
+    static const int EC_SINGLE = 102;
+    static const int EC_LOW = 103;
+    static const int EC_HIGH = 105;
+    
+    using EzoProbe::EzoProbe;
+};
+
+class OxidationReduction : public EzoProbe<OxidationReduction, OrpTraits>
+{
+public:
+    static const int ORP_POINT = 101;
+    
+    using EzoProbe::EzoProbe;
+};
+
+class RtdTemperature : public EzoProbe<RtdTemperature, RtdTraits>
+{
+public:
+    static const int RTD_POINT = 101;
+    
+    using EzoProbe::EzoProbe;
+};
+
+#endif // EZOPROBE_H
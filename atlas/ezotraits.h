@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EZOTRAITS_H
+#define EZOTRAITS_H
+
+#include "ezocommand.h"
+
+/**
+ * \struct EzoCalibration
+ * 
+ * One row of a probe's calibration table. Rows with value set get the
+ * calibration value appended after the command text.
+ */
+struct EzoCalibration {
+    int code;
+    const char *command;
+    bool value;
+    int delay;
+};
+
+/*
+ * Calibration codes every probe shares, the probe specific points
+ * start after these.
+ */
+#define EZO_CAL_CLEAR       100
+#define EZO_CAL_QUERY       104
+
+/**
+ * Everything that differs between EZO circuits. device is the type
+ * name the circuit reports in its info reply, readDelay is the time
+ * a reading takes in ms. Probes that don't take a temperature have
+ * tempCompensation false and never get sent a T command. minimum and
+ * maximum are the circuit's measuring range, a reading outside it is
+ * flagged out of range instead of being used. Adding a new
+ * circuit is a new traits struct and an EzoProbe using it.
+ */
+struct PhTraits {
+    static constexpr const char *device = "pH";
+    static constexpr int readDelay = 900;
+    static constexpr bool tempCompensation = true;
+    static constexpr double minimum = 0.0;
+    static constexpr double maximum = 14.0;
+    static constexpr EzoCalibration calibrations[] = {
+        { EZO_CAL_CLEAR, "Cal,clear", false, 300 },
+        { 101, "Cal,low,", true, 900 },
+        { 102, "Cal,mid,", true, 900 },
+        { 103, "Cal,high,", true, 900 },
+        { EZO_CAL_QUERY, "Cal,?", false, 300 },
+    };
+};
+
+struct DoTraits {
+    static constexpr const char *device = "DO";
+    static constexpr int readDelay = 600;
+    static constexpr bool tempCompensation = true;
+    static constexpr double minimum = 0.0;
+    static constexpr double maximum = 100.0;
+    static constexpr EzoCalibration calibrations[] = {
+        { EZO_CAL_CLEAR, "Cal,clear", false, 300 },
+        { 101, "Cal", false, 1300 },
+        { 102, "Cal,0", false, 1300 },
+        { EZO_CAL_QUERY, "Cal,?", false, 300 },
+    };
+};
+
+struct EcTraits {
+    static constexpr const char *device = "EC";
+    static constexpr int readDelay = 600;
+    static constexpr bool tempCompensation = true;
+    static constexpr double minimum = 0.0;
+    static constexpr double maximum = 500000.0;
+    static constexpr EzoCalibration calibrations[] = {
+        { EZO_CAL_CLEAR, "Cal,clear", false, 300 },
+        { 101, "Cal,dry", false, 600 },
+        { 102, "Cal,", true, 600 },
+        { 103, "Cal,low,", true, 600 },
+        { 105, "Cal,high,", true, 600 },
+        { EZO_CAL_QUERY, "Cal,?", false, 300 },
+    };
+};
+
+struct OrpTraits {
+    static constexpr const char *device = "ORP";
+    static constexpr int readDelay = 900;
+    static constexpr bool tempCompensation = false;
+    static constexpr double minimum = -1019.9;
+    static constexpr double maximum = 1019.9;
+    static constexpr EzoCalibration calibrations[] = {
+        { EZO_CAL_CLEAR, "Cal,clear", false, 300 },
+        { 101, "Cal,", true, 900 },
+        { EZO_CAL_QUERY, "Cal,?", false, 300 },
+    };
+};
+
+struct RtdTraits {
+    static constexpr const char *device = "RTD";
+    static constexpr int readDelay = 600;
+    static constexpr bool tempCompensation = false;
+    static constexpr double minimum = -126.0;
+    static constexpr double maximum = 1254.0;
+    static constexpr EzoCalibration calibrations[] = {
+        { EZO_CAL_CLEAR, "Cal,clear", false, 300 },
+        { 101, "Cal,", true, 600 },
+        { EZO_CAL_QUERY, "Cal,?", false, 300 },
+    };
+};
+
+/**
+ * \fn constexpr const EzoCalibration* ezoCalibration(const EzoCalibration (&table)[N], int code)
+ * 
+ * Table lookup, resolved at compile time when the code is a constant.
+ */
+template<size_t N>
+constexpr const EzoCalibration* ezoCalibration(const EzoCalibration (&table)[N], int code)
+{
+    for (size_t i = 0; i < N; i++) {
+        if (table[i].code == code)
+            return &table[i];
+    }
+    return nullptr;
+}
+
+#endif // EZOTRAITS_H
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "i2clease.h"
+#include "logger.h"
+
+std::string I2cLease::s_directory = I2C_LEASE_DIR;
+int I2cLease::s_wait = I2C_LEASE_WAIT_MS;
+
+void I2cLease::setDirectory(const std::string &dir)
+{
+    s_directory = dir;
+}
+
+void I2cLease::setWait(int ms)
+{
+    s_wait = std::max(ms, 0);
+}
+
+std::string I2cLease::path(int bus)
+{
+    return s_directory + "/aquarium-i2c-" + std::to_string(bus) + ".lock";
+}
+
+/*
+ * Anyone may take a lease, the calibrate tools don't always run as the
+ * same user as the daemon.
+ */
+I2cLease::I2cLease(int bus, int key) : m_bus(bus), m_key(key)
+{
+    m_fd = -1;
+    m_held = false;
+    
+    std::string labels = "bus=\"" + std::to_string(bus) + "\"";
+    m_waited = MetricsRegistry::instance()->histogram("aquarium_i2c_lease_wait_seconds", "Time spent waiting for an i2c lease", MetricsRegistry::latencyBuckets(), labels);
+    m_timeouts = MetricsRegistry::instance()->counter("aquarium_i2c_lease_timeouts_total", "i2c leases given up on after the wait", labels);
+    
+    if (s_directory.empty())
+        return;
+    
+    std::string file = path(bus);
+    if ((m_fd = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666)) < 0) {
+        LOGW("Unable to open i2c lease file, bus is not shared", "file", file, "error", strerror(errno));
+        return;
+    }
+    fchmod(m_fd, 0666);
+}
+
+I2cLease::~I2cLease()
+{
+    release();
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+/*
+ * Each slot is four bytes, enough for the pid moved() keeps in it.
+ */
+bool I2cLease::lock(short type)
+{
+    struct flock fl;
+    
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = static_cast<off_t>(m_key) * sizeof(int32_t);
+    fl.l_len = sizeof(int32_t);
+    return fcntl(m_fd, F_OFD_SETLK, &fl) == 0;
+}
+
+/**
+ * \fn bool I2cLease::acquire()
+ * 
+ * Polls with a backoff from 1ms up to 20ms, there's no timed wait for
+ * a file lock. An EZO command holds its lease for the circuit's
+ * processing delay so a short wait here is the normal case under
+ * contention. Returns false once the wait runs out.
+ */
+bool I2cLease::acquire()
+{
+    if (m_fd < 0 || m_held) {
+        m_held = true;
+        return true;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(s_wait);
+    int backoff = 1;
+    
+    while (!lock(F_WRLCK)) {
+        if (errno != EAGAIN && errno != EACCES && errno != EINTR) {
+            LOGE("i2c lease failed", "bus", m_bus, "key", m_key, "error", strerror(errno));
+            return false;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            m_timeouts->inc();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+        backoff = std::min(backoff * 2, 20);
+    }
+    m_waited->observeSince(start);
+    m_held = true;
+    return true;
+}
+
+void I2cLease::release()
+{
+    if (!m_held)
+        return;
+    
+    if (m_fd >= 0)
+        lock(F_UNLCK);
+    m_held = false;
+}
+
+/**
+ * \fn bool I2cLease::moved()
+ * 
+ * With the lease held, whether another process held it since this one
+ * last did. The slot keeps the pid of the last process to ask, so the
+ * answer is only meaningful to a single caller per process. An unshared
+ * bus never moves.
+ */
+bool I2cLease::moved()
+{
+    int32_t owner = 0;
+    int32_t self = getpid();
+    off_t offset = static_cast<off_t>(m_key) * sizeof(int32_t);
+    
+    if (m_fd < 0 || !m_held)
+        return false;
+    
+    if (pread(m_fd, &owner, sizeof(owner), offset) == sizeof(owner) && owner == self)
+        return false;
+    
+    if (pwrite(m_fd, &self, sizeof(self), offset) != sizeof(self))
+        LOGW("Unable to mark i2c lease owner", "bus", m_bus, "error", strerror(errno));
+    return true;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I2CLEASE_H
+#define I2CLEASE_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+#include "metrics.h"
+
+#define I2C_LEASE_DIR       "/run/lock"
+#define I2C_LEASE_WAIT_MS   2000
+#define I2C_LEASE_MUXES     0
+
+/**
+ * \class I2cLease
+ * 
+ * Lets the daemon and the calibrate tools share a bus, each opens it
+ * on its own and nothing in the kernel stops one writing a command to
+ * a circuit while the other waits for its reply. A lease is an
+ * advisory lock on one slot of a lock file per bus, held from a
+ * command's write until its read. The slot is the device's key, its
+ * address or route, so leases on different circuits never wait on
+ * each other. Slot I2C_LEASE_MUXES covers every mux on the bus.
+ * 
+ * The locks belong to the open lock file, not the process or thread.
+ * Two leases conflict inside one process just as between two, a
+ * lease taken on the scheduler thread can be let go from the timer
+ * thread, and the kernel drops them if the holder dies.
+ * 
+ * acquire() waits at most the configured time. Leases are off when the
+ * directory is empty or the lock file can't be opened, then acquire()
+ * always succeeds without a system call. The directory and wait have
+ * to be set before the devices are created.
+ */
+class I2cLease
+{
+public:
+    static void setDirectory(const std::string &dir);
+    static void setWait(int ms);
+    static std::string path(int bus);
+    
+    I2cLease(int bus, int key);
+    ~I2cLease();
+    
+    bool acquire();
+    void release();
+    bool moved();
+    bool held() const { return m_held; }
+    bool shared() const { return m_fd >= 0; }
+    int key() const { return m_key; }
+    
+private:
+    bool lock(short type);
+    
+    static std::string s_directory;
+    static int s_wait;
+    
+    int m_bus;
+    int m_key;
+    int m_fd;
+    bool m_held;
+    Histogram *m_waited;
+    Counter *m_timeouts;
+};
+
+#endif // I2CLEASE_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include "i2cmux.h"
+#include "sessionrecorder.h"
+#include "logger.h"
+
+/*
+ * Muxes and their buses live as long as the process, every probe
+ * behind a mux shares the one object for it.
+ */
+I2cMux::Bus* I2cMux::shared(int bus)
+{
+    static std::map<int, Bus*> buses;
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = buses.find(bus);
+    if (it != buses.end())
+        return it->second;
+    
+    Bus *shared = new Bus(bus);
+    buses[bus] = shared;
+    return shared;
+}
+
+I2cMux* I2cMux::get(int bus, int address)
+{
+    Bus *shared = I2cMux::shared(bus);
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    
+    auto it = shared->muxes.find(address);
+    if (it != shared->muxes.end())
+        return it->second;
+    
+    I2cMux *mux = new I2cMux(bus, address);
+    mux->m_shared = shared;
+    shared->muxes[address] = mux;
+    return mux;
+}
+
+uint64_t I2cMux::switches(int bus)
+{
+    return I2cMux::shared(bus)->switches.load(std::memory_order_relaxed);
+}
+
+I2cMux::I2cMux(int bus, int address) : m_bus(bus), m_address(address)
+{
+    char filename[40];
+    
+    m_channel = -1;
+    m_fd = -1;
+    m_enabled = false;
+    m_shared = nullptr;
+    
+    std::string labels = "bus=\"" + std::to_string(bus) + "\",mux=\"" + std::to_string(address) + "\"";
+    m_switches = MetricsRegistry::instance()->counter("aquarium_i2c_mux_switches_total", "Channel changes written to an i2c mux", labels);
+    
+    if (SessionRecorder::instance()->replaying()) {
+        m_enabled = true;
+        return;
+    }
+    
+    sprintf(filename, "/dev/i2c-%d", bus);
+    if ((m_fd = open(filename, O_RDWR)) < 0) {
+        LOGE("Failed to open i2c device for mux", "device", bus);
+        return;
+    }
+    if (ioctl(m_fd, I2C_SLAVE, address) < 0) {
+        LOGE("Failed to acquire bus access to mux", "bus", bus, "address", address);
+        return;
+    }
+    m_enabled = true;
+    LOGI("I2C mux", "bus", bus, "address", address);
+}
+
+I2cMux::~I2cMux()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+/*
+ * Nothing is written during a replay, the devices behind the mux are
+ * played back by address and never see it.
+ */
+bool I2cMux::write(uint8_t mask)
+{
+    if (SessionRecorder::instance()->replaying())
+        return true;
+    
+    if (::write(m_fd, &mask, 1) != 1) {
+        LOGE("Error writing i2c mux channel", "bus", m_bus, "address", m_address, "mask", mask);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \fn I2cMux::Hold I2cMux::select(int channel)
+ * 
+ * Enables channel, turning off any other mux on the bus that still has
+ * one enabled. The bus stays locked until the returned hold goes away.
+ * The hold is false, and nothing may be sent, when the channel can't be
+ * selected: the mux never opened, the channel is out of range, the
+ * write failed or another process kept the bus past the lease wait.
+ * A failed write leaves the channel unknown so the next select writes
+ * it again.
+ */
+I2cMux::Hold I2cMux::select(int channel)
+{
+    std::unique_lock<std::mutex> lock(m_shared->mutex);
+    I2cLease *lease = nullptr;
+    
+    if (!m_enabled || channel < 0 || channel >= I2CMUX_CHANNELS)
+        return Hold();
+    
+    if (!SessionRecorder::instance()->replaying()) {
+        if (!m_shared->lease.acquire()) {
+            LOGW("Timed out waiting for the i2c mux lease", "bus", m_bus, "mux", m_address);
+            return Hold();
+        }
+        lease = &m_shared->lease;
+        if (lease->moved()) {
+            for (auto &it : m_shared->muxes) {
+                if (it.second->m_enabled)
+                    it.second->m_channel = I2CMUX_UNKNOWN;
+            }
+        }
+    }
+    
+    Hold hold(std::move(lock), lease);
+    if (channel == m_channel)
+        return hold;
+    
+    for (auto &it : m_shared->muxes) {
+        I2cMux *other = it.second;
+        if (other != this && other->m_channel != -1) {
+            other->write(0);
+            other->m_channel = -1;
+        }
+    }
+    
+    if (write(static_cast<uint8_t>(1 << channel))) {
+        m_channel = channel;
+        m_shared->switches.fetch_add(1, std::memory_order_relaxed);
+        m_switches->inc();
+    }
+    else {
+        m_channel = -1;
+        return Hold();
+    }
+    return hold;
+}
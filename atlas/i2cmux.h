@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I2CMUX_H
+#define I2CMUX_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "metrics.h"
+#include "i2clease.h"
+
+#define I2CMUX_CHANNELS     8
+#define I2CMUX_UNKNOWN      -2
+
+/**
+ * \class I2cMux
+ * 
+ * A TCA9548A on one i2c bus. Devices behind it are reached by enabling
+ * their channel first, so every write and read to such a device holds
+ * the lock select() returns for the length of the transfer. The lock is
+ * per bus, not per mux, since a second mux on the same bus has to be
+ * switched off before this one's channel is safe to use.
+ * 
+ * The channel last written is remembered and a select for the channel
+ * already enabled doesn't touch the bus. Switches are counted per bus
+ * for the scheduler and per mux for the metrics endpoint.
+ * 
+ * Other processes on the bus are kept out by the bus's mux lease, held
+ * along with the lock. When another process had the muxes since this
+ * one last did, every remembered channel is forgotten and written again.
+ */
+class I2cMux
+{
+public:
+    /**
+     * The bus lock and mux lease for one transfer, false if the lease
+     * couldn't be had in time and nothing may be sent.
+     */
+    class Hold
+    {
+    public:
+        Hold() : m_lease(nullptr) {}
+        Hold(std::unique_lock<std::mutex> lock, I2cLease *lease) : m_lock(std::move(lock)), m_lease(lease) {}
+        Hold(Hold &&other) : m_lock(std::move(other.m_lock)), m_lease(other.m_lease) { other.m_lease = nullptr; }
+        ~Hold() { unlock(); }
+        
+        Hold& operator=(Hold &&other)
+        {
+            unlock();
+            m_lock = std::move(other.m_lock);
+            m_lease = other.m_lease;
+            other.m_lease = nullptr;
+            return *this;
+        }
+        explicit operator bool() const { return m_lock.owns_lock(); }
+        
+    private:
+        void unlock()
+        {
+            if (m_lease)
+                m_lease->release();
+            m_lease = nullptr;
+            if (m_lock.owns_lock())
+                m_lock.unlock();
+        }
+        
+        std::unique_lock<std::mutex> m_lock;
+        I2cLease *m_lease;
+    };
+    
+    static I2cMux* get(int bus, int address);
+    static uint64_t switches(int bus);
+    
+    Hold select(int channel);
+    
+    int bus() const { return m_bus; }
+    int address() const { return m_address; }
+    int channel() const { return m_channel; }
+    bool enabled() const { return m_enabled; }
+    
+private:
+    I2cMux(int bus, int address);
+    ~I2cMux();
+    
+    struct Bus {
+        std::mutex mutex;
+        std::map<int, I2cMux*> muxes;
+        std::atomic<uint64_t> switches;
+        I2cLease lease;
+        
+        Bus(int bus) : switches(0), lease(bus, I2C_LEASE_MUXES) {}
+    };
+    
+    static Bus* shared(int bus);
+    bool write(uint8_t mask);
+    
+    int m_bus;
+    int m_address;
+    int m_channel;
+    int m_fd;
+    bool m_enabled;
+    Bus *m_shared;
+    Counter *m_switches;
+};
+
+#endif // I2CMUX_H
@@ -27,26 +27,23 @@
 #define POTENTIALHYDROGEN_H__
 
 #include <string>
-#include <functional>
-#include <iostream>
-#include <iterator>
-#include <iomanip>
-#include <ios>
-#include <sstream>
 
-#include "atlasscientifici2c.h"
+#include "ezoprobe.h"
 
 /**
- * @todo write docs
+ * \class PotentialHydrogen
+ * 
+ * The EZO pH circuit. Everything but the slope query comes from the
+ * common EzoProbe core and PhTraits.
  */
-class PotentialHydrogen : public AtlasScientificI2C
+class PotentialHydrogen : public EzoProbe<PotentialHydrogen, PhTraits>
 {
 public:
-    static const int PH_CLEAR = 100;
+    static const int PH_CLEAR = EZO_CAL_CLEAR;
     static const int PH_LOW = 101;
     static const int PH_MID = 102;
     static const int PH_HIGH = 103;
-    static const int PH_QUERY = 104;
+    static const int PH_QUERY = EZO_CAL_QUERY;
     
     static const int NOCALIBRATION = 0;
     static const int ONEPOINTCAL = 1;
@@ -54,37 +51,20 @@ public:
     static const int THREEPOINTCAL = 3;
     
     PotentialHydrogen(uint8_t, uint8_t);
-    virtual ~PotentialHydrogen();
     
-    void getLastResponse(std::string&);
-    void setCallback(std::function<void(int, std::string)> cbk) { m_callback = cbk; }
-
-    void response(int cmd, uint8_t[], int) override;
-
-    bool calibrate(int, uint8_t*, int);
-    bool calibrate(int);
     void slope();
-    void setTempCompensation(uint8_t*, int);
-    void setTempCompensation(double);
-    void setTempCompensationAndRead(uint8_t*, int);
-    void setTempCompensationAndRead(double);
-    void getTempCompensation();
-    void disableLeds();
-    std::string getLastReason() { return m_lastResetReason; }
-    double getVoltage() { return m_lastVoltage; }
-    double getPH() { return m_lastPHValue; }
+    double getPH() { return value(); }
+    double getRawPH() { return raw(); }
+    double acidSlope() { return m_acidSlope; }
+    double baseSlope() { return m_baseSlope; }
     
 private:
-    void handleCalibration(std::string);
-    void handleStatusResponse(std::string);
-    void handleReadResponse(std::string&);
-    void printBuffer(std::vector<uint8_t>&);
+    friend class EzoProbe<PotentialHydrogen, PhTraits>;
+    
+    void decode(int cmd, const EzoResponse &reply);
     
-    std::function<void(int, std::string)> m_callback;
-    int m_calibration;
-    std::string m_lastResetReason;
-    double m_lastVoltage;
-    double m_lastPHValue;
+    double m_acidSlope;
+    double m_baseSlope;
 };
 
-#endif // DISSOLVEDOXYGEN_H
+#endif // POTENTIALHYDROGEN_H__
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+#include "configuration.h"
+#include "logger.h"
+
+#ifndef AQUARIUM_SAMPLE_CONFIG
+#define AQUARIUM_SAMPLE_CONFIG  "aquarium.conf"
+#endif
+
+/*
+ * Configuration calls back into the daemon for MQTT events, the bench
+ * never connects so these do nothing.
+ */
+void mqttIncomingMessage(std::string topic, std::string message) {}
+void mqttConnectionLost(const std::string &cause) {}
+void mqttConnected() {}
+void aioIncomingMessage(std::string topic, std::string message) {}
+void aioConnected() {}
+void aioConnectionLost(const std::string &cause) {}
+
+/*
+ * A full read of the sample config shipped with the tree, including
+ * building the sensors, filters and detectors it describes. The
+ * log is flushed outside the timed part so it never fills and drops,
+ * what's measured is queueing the lines, which is what the daemon pays.
+ */
+static void BM_ReadConfigFile(benchmark::State &state)
+{
+    Configuration *config = Configuration::instance();
+    std::ostringstream sink;
+    std::streambuf *out = std::cout.rdbuf(sink.rdbuf());
+    std::streambuf *err = std::cerr.rdbuf(sink.rdbuf());
+    
+    Logger::setConsole(false);
+    config->setConfigFile(AQUARIUM_SAMPLE_CONFIG);
+    
+    for (auto _ : state) {
+        if (!config->readConfigFile()) {
+            state.SkipWithError("Unable to read " AQUARIUM_SAMPLE_CONFIG);
+            break;
+        }
+        
+        state.PauseTiming();
+        sink.str(std::string());
+        Logger::instance()->flush();
+        SensorRegistry::instance()->clear();
+        delete config->m_flowRate;
+        delete config->m_pump;
+        config->m_flowRate = nullptr;
+        config->m_pump = nullptr;
+        state.ResumeTiming();
+    }
+    
+    std::cout.rdbuf(out);
+    std::cerr.rdbuf(err);
+    Logger::setConsole(true);
+}
+BENCHMARK(BM_ReadConfigFile);
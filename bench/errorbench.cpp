@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <string>
+#include <fstream>
+
+#include <benchmark/benchmark.h>
+
+#include "errorhandler.h"
+
+static int threadCount()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0)
+            return std::stoi(line.substr(8));
+    }
+    return 0;
+}
+
+/*
+ * Cost of raising a new error on the caller's thread.
+ */
+static void BM_ErrorRaise(benchmark::State &state)
+{
+    ErrorHandler errors;
+    unsigned int n = 0;
+    
+    for (auto _ : state) {
+        unsigned int handle = errors.warning("probe " + std::to_string(n++), nullptr, 0);
+        errors.clearWarning(handle);
+    }
+    errors.flush();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ErrorRaise);
+
+/*
+ * The same error raised over and over, the flapping probe case. All
+ * but the first few should be suppressed by the backoff.
+ */
+static void BM_ErrorRepeat(benchmark::State &state)
+{
+    ErrorHandler errors;
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(errors.warning("pH probe is returning garbage", nullptr, 0));
+    }
+    errors.flush();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["published"] = errors.published();
+    state.counters["suppressed"] = errors.suppressed();
+}
+BENCHMARK(BM_ErrorRepeat);
+
+/*
+ * range(0) threads together raise 10k errors a second for one second,
+ * a mix of repeats and distinct errors that get cleared again. Reports
+ * the worst time a caller was held up and checks nothing is left
+ * active once the queue drains.
+ */
+static void BM_ErrorStress(benchmark::State &state)
+{
+    const int threads = state.range(0);
+    const int perSecond = 10000;
+    const auto period = std::chrono::microseconds(1000000 * threads / perSecond);
+    std::atomic<long> maxCall(0);
+    unsigned long published = 0;
+    unsigned long suppressed = 0;
+    unsigned int leftover = 0;
+    
+    for (auto _ : state) {
+        ErrorHandler errors;
+        std::vector<std::thread> workers;
+        
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                auto next = std::chrono::steady_clock::now();
+                for (int i = 0; i < perSecond / threads; i++) {
+                    auto start = std::chrono::steady_clock::now();
+                    if (i % 4) {
+                        errors.warning("sensor " + std::to_string(i % 8) + " flapping", nullptr, 0);
+                    }
+                    else {
+                        unsigned int h = errors.critical("thread " + std::to_string(t) + " error " + std::to_string(i), nullptr, 0);
+                        errors.clearCritical(h);
+                    }
+                    long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                    long prev = maxCall;
+                    while (ns > prev && !maxCall.compare_exchange_weak(prev, ns));
+                    
+                    next += period;
+                    std::this_thread::sleep_until(next);
+                }
+            });
+        }
+        for (auto &w : workers)
+            w.join();
+        
+        errors.flush();
+        published += errors.published();
+        suppressed += errors.suppressed();
+        leftover += errors.active(BaseError::CRITICAL);
+        errors.stop();
+    }
+    
+    state.counters["published"] = published;
+    state.counters["suppressed"] = suppressed;
+    state.counters["max_call_us"] = maxCall / 1000.0;
+    if (leftover)
+        state.SkipWithError("cleared criticals are still active");
+}
+BENCHMARK(BM_ErrorStress)->Arg(4)->Arg(16)->Arg(64)->Iterations(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/*
+ * Timed errors raised and cleared, the way a probe callback does when
+ * a reading recovers. Reports the process thread count at the end.
+ */
+static void BM_ErrorTimedActivateClear(benchmark::State &state)
+{
+    ErrorHandler errors;
+    unsigned int n = 0;
+    
+    for (auto _ : state) {
+        unsigned int handle = errors.warning("timed " + std::to_string(n++), nullptr, 60000);
+        errors.clearWarning(handle);
+    }
+    errors.flush();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["threads"] = threadCount();
+}
+BENCHMARK(BM_ErrorTimedActivateClear);
+
+/*
+ * range(0) timed warnings all active at once, left to expire on their
+ * own. The thread count is sampled while they are all pending, it
+ * should not grow with the number of errors.
+ */
+static void BM_ErrorTimedExpiry(benchmark::State &state)
+{
+    int threads = 0;
+    
+    for (auto _ : state) {
+        ErrorHandler errors;
+        
+        for (int i = 0; i < state.range(0); i++)
+            errors.warning("expiring " + std::to_string(i), nullptr, 100);
+        errors.flush();
+        threads = threadCount();
+        
+        while (errors.active(BaseError::WARNING))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        errors.stop();
+    }
+    state.counters["threads"] = threads;
+}
+BENCHMARK(BM_ErrorTimedExpiry)->Arg(1000)->Arg(10000)->UseRealTime()->Unit(benchmark::kMillisecond);
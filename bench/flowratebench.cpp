@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include <benchmark/benchmark.h>
+
+#include "fakegpiobackend.h"
+#include "flowrate.h"
+
+#define FLOW_PIN            5
+#define PULSES_PER_LITER    450.0
+
+/*
+ * Cost of taking one pulse on the GPIO event thread.
+ */
+static void BM_FlowRatePulse(benchmark::State &state)
+{
+    FlowRate flow(PULSES_PER_LITER);
+    uint64_t timestamp = 0;
+    
+    for (auto _ : state) {
+        flow.pulse(timestamp);
+        timestamp += 500000;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FlowRatePulse);
+
+/*
+ * Cost of working out the rate with a full window behind it.
+ */
+static void BM_FlowRateWindow(benchmark::State &state)
+{
+    FlowRate flow(PULSES_PER_LITER, 5000);
+    uint64_t timestamp = 1000000000ULL;
+    
+    for (int i = 0; i < state.range(0); i++) {
+        flow.pulse(timestamp);
+        timestamp += 5000000000ULL / state.range(0);
+    }
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(flow.litersPerMinute(timestamp));
+    }
+}
+BENCHMARK(BM_FlowRateWindow)->Arg(500)->Arg(10000);
+
+/*
+ * A 2 kHz pulse train driven through the fake backend in real time
+ * from its own thread, with the rate being read concurrently the way
+ * the publish timer does. Every pulse injected has to be counted.
+ */
+static void BM_FlowRatePulseTrain2kHz(benchmark::State &state)
+{
+    const int pulses = state.range(0);
+    const auto period = std::chrono::microseconds(500);
+    uint64_t lost = 0;
+    double lpm = 0;
+    
+    for (auto _ : state) {
+        FakeGpioBackend gpio;
+        FlowRate flow(PULSES_PER_LITER, 200);
+        std::atomic<bool> done(false);
+        
+        gpio.setInput(FLOW_PIN);
+        gpio.watch(FLOW_PIN, GpioBackend::RISING, [&flow](GpioEvent e) { flow.pulse(e.timestamp); });
+        
+        std::thread generator([&]() {
+            auto next = std::chrono::steady_clock::now();
+            for (int i = 0; i < pulses; i++) {
+                gpio.inject(FLOW_PIN, 1);
+                gpio.inject(FLOW_PIN, 0);
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+            done = true;
+        });
+        
+        while (!done) {
+            lpm = flow.litersPerMinute();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        generator.join();
+        
+        lpm = flow.litersPerMinute();
+        lost += pulses - flow.pulses();
+    }
+    
+    state.counters["lost"] = lost;
+    state.counters["lpm"] = lpm;
+    state.counters["expected_lpm"] = 2000.0 / PULSES_PER_LITER * 60.0;
+    if (lost)
+        state.SkipWithError("pulses were lost");
+}
+BENCHMARK(BM_FlowRatePulseTrain2kHz)->Arg(2000)->Iterations(3)->UseRealTime()->Unit(benchmark::kMillisecond);
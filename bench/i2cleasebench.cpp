@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <benchmark/benchmark.h>
+
+#include "i2clease.h"
+
+/*
+ * Leases go in a scratch directory so a daemon running on the same
+ * machine isn't disturbed.
+ */
+static void leaseDirectory()
+{
+    static std::string dir;
+    
+    if (dir.empty()) {
+        char tmpl[] = "/tmp/aquarium-lease-XXXXXX";
+        if (mkdtemp(tmpl))
+            dir = tmpl;
+    }
+    I2cLease::setDirectory(dir);
+    I2cLease::setWait(I2C_LEASE_WAIT_MS);
+}
+
+/*
+ * What every EZO command now pays when nobody else wants the circuit,
+ * two fcntl calls.
+ */
+static void BM_I2cLeaseUncontended(benchmark::State &state)
+{
+    leaseDirectory();
+    I2cLease lease(1, 0x63);
+    
+    for (auto _ : state) {
+        lease.acquire();
+        lease.release();
+    }
+}
+BENCHMARK(BM_I2cLeaseUncontended);
+
+/*
+ * Each thread is one process's view of the bus, its own lock file
+ * description, holding the lease for range(0) microseconds like a
+ * transfer would. range(1) is 1 when they all want the same circuit and
+ * 0 when each has its own. wait_us is the time to get the lease.
+ */
+static void BM_I2cLeaseContended(benchmark::State &state)
+{
+    leaseDirectory();
+    int key = state.range(1) ? 0x63 : 0x63 + state.thread_index();
+    I2cLease lease(1, key);
+    double waited = 0;
+    
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        if (!lease.acquire()) {
+            state.SkipWithError("lease timed out");
+            break;
+        }
+        waited += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::this_thread::sleep_for(std::chrono::microseconds(state.range(0)));
+        lease.release();
+    }
+    state.counters["wait_us"] = benchmark::Counter(waited, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_I2cLeaseContended)->Args({500, 1})->Args({500, 0})->Threads(1)->Threads(2)->Threads(4)->UseRealTime();
+
+/*
+ * A second process, standing in for a calibrate tool, takes the same
+ * circuit's lease for range(0) microseconds and lets it go for as long,
+ * over and over. This side does the same, so neither can starve the
+ * other by taking the lease straight back. wait_us is the time to get
+ * it.
+ */
+static void BM_I2cLeaseAcrossProcesses(benchmark::State &state)
+{
+    leaseDirectory();
+    int hold = state.range(0);
+    pid_t child = fork();
+    
+    if (child == 0) {
+        I2cLease lease(1, 0x63);
+        while (true) {
+            if (lease.acquire()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(hold));
+                lease.release();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(hold));
+        }
+    }
+    
+    I2cLease lease(1, 0x63);
+    double waited = 0;
+    
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        if (!lease.acquire()) {
+            state.SkipWithError("lease timed out");
+            break;
+        }
+        waited += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::this_thread::sleep_for(std::chrono::microseconds(hold));
+        lease.release();
+        std::this_thread::sleep_for(std::chrono::microseconds(hold));
+    }
+    state.counters["wait_us"] = benchmark::Counter(waited, benchmark::Counter::kAvgIterations);
+    
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+}
+BENCHMARK(BM_I2cLeaseAcrossProcesses)->Arg(200)->Arg(1000)->UseRealTime();
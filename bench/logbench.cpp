@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include "logger.h"
+
+/*
+ * What a call site cost before the logger, a syslog() call and the
+ * same line built on std::cerr. The stream goes to a string so the
+ * terminal isn't what's measured, syslog goes wherever /dev/log does.
+ */
+static void BM_LogSyslogAndStream(benchmark::State &state)
+{
+    std::ostringstream sink;
+    std::streambuf *err = std::cerr.rdbuf(sink.rdbuf());
+    std::string device("28-0316a2794bff");
+    int pin = 4;
+    
+    openlog("aquarium_bench", LOG_PID | LOG_NDELAY, LOG_LOCAL1);
+    for (auto _ : state) {
+        syslog(LOG_INFO, "Found DS18B20 device %s on pin %d", device.c_str(), pin);
+        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Found DS18B20 device " << device << " on pin " << pin << std::endl;
+        sink.str(std::string());
+    }
+    closelog();
+    std::cerr.rdbuf(err);
+}
+BENCHMARK(BM_LogSyslogAndStream);
+
+/*
+ * The same line through the logger. Each iteration fills half a ring
+ * and only that is timed, the flush that empties it again is not, so
+ * nothing is dropped and per_record is the caller's side alone.
+ */
+static void BM_LogStructured(benchmark::State &state)
+{
+    const int batch = LOG_BUFFER_RECORDS / 2;
+    std::string device("28-0316a2794bff");
+    int pin = 4;
+    
+    Logger::setConsole(false);
+    Logger::setLevel(LOG_DEBUG);
+    Logger::instance()->flush();
+    unsigned long dropped = Logger::instance()->dropped();
+    
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < batch; i++)
+            LOGI("Found DS18B20 device", "device", device, "pin", pin);
+        auto end = std::chrono::steady_clock::now();
+        
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+        Logger::instance()->flush();
+    }
+    state.counters["per_record"] = benchmark::Counter(state.iterations() * batch, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["dropped"] = Logger::instance()->dropped() - dropped;
+    Logger::setConsole(true);
+}
+BENCHMARK(BM_LogStructured)->UseManualTime();
+
+/*
+ * A debug line with the level set to warnings, one relaxed load.
+ */
+static void BM_LogFilteredAtRuntime(benchmark::State &state)
+{
+    std::string device("28-0316a2794bff");
+    
+    Logger::setLevel(LOG_WARNING);
+    for (auto _ : state) {
+        LOGD("Found DS18B20 device", "device", device);
+        benchmark::ClobberMemory();
+    }
+    Logger::setLevel(LOG_DEBUG);
+}
+BENCHMARK(BM_LogFilteredAtRuntime);
+
+/*
+ * As if built with -DAQUARIUM_LOG_LEVEL=LOG_INFO, the call is gone.
+ */
+#undef AQUARIUM_LOG_LEVEL
+#define AQUARIUM_LOG_LEVEL LOG_INFO
+
+static void BM_LogCompiledOut(benchmark::State &state)
+{
+    std::string device("28-0316a2794bff");
+    
+    for (auto _ : state) {
+        LOGD("Found DS18B20 device", "device", device);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_LogCompiledOut);
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "metrics.h"
+
+/*
+ * A counter bump from several threads at once, this is the cost added
+ * to every instrumented path.
+ */
+static void BM_CounterInc(benchmark::State &state)
+{
+    static Counter *counter = MetricsRegistry::instance()->counter("bench_counter_total", "Benchmark counter");
+    
+    for (auto _ : state) {
+        counter->inc();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CounterInc)->Threads(1)->Threads(4);
+
+static void BM_HistogramObserve(benchmark::State &state)
+{
+    static Histogram *histogram = MetricsRegistry::instance()->histogram("bench_latency_seconds", "Benchmark histogram");
+    double value = 0.0001;
+    
+    for (auto _ : state) {
+        histogram->observe(value);
+        value = value < 5 ? value * 2 : 0.0001;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HistogramObserve)->Threads(1)->Threads(4);
+
+/*
+ * Rendering the whole registry, what a scrape costs the daemon.
+ */
+static void BM_MetricsRender(benchmark::State &state)
+{
+    MetricsRegistry::instance()->registerProcessMetrics();
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MetricsRegistry::instance()->render());
+    }
+}
+BENCHMARK(BM_MetricsRender);
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstring>
+
+#include <benchmark/benchmark.h>
+
+#include "ezocommand.h"
+#include "ezotraits.h"
+#include "potentialhydrogen.h"
+#include "dissolvedoxygen.h"
+#include "temperature.h"
+
+/*
+ * Probes with no i2c address never open the bus, these just switch
+ * them on so response() runs the real parsing.
+ */
+class BenchPH : public PotentialHydrogen
+{
+public:
+    BenchPH() : PotentialHydrogen(1, 0)
+    {
+        m_enabled = true;
+        setCallback([](int, std::string) {});
+    }
+};
+
+class BenchDO : public DissolvedOxygen
+{
+public:
+    BenchDO() : DissolvedOxygen(1, 0)
+    {
+        m_enabled = true;
+        setCallback([](int, std::string) {});
+    }
+};
+
+/*
+ * Replies as they come off the bus, status byte first.
+ */
+static const char *PH_READING = "\x01" "7.021";
+static const char *PH_STATUS = "\x01" "?STATUS,P,5.038";
+static const char *DO_READING = "\x01" "8.42";
+static const char *DO_STATUS = "\x01" "?STATUS,P,3.302";
+static const char *W1_SLAVE = "72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=23125\n";
+
+static void BM_EzoSplit(benchmark::State &state)
+{
+    const uint8_t *reply = reinterpret_cast<const uint8_t*>(PH_STATUS);
+    int size = strlen(PH_STATUS);
+    
+    for (auto _ : state) {
+        EzoResponse fields(reply, size);
+        benchmark::DoNotOptimize(fields.count());
+    }
+}
+BENCHMARK(BM_EzoSplit);
+
+static void BM_EzoEncodeTempComp(benchmark::State &state)
+{
+    static constexpr EzoCommand prefix("T,");
+    
+    for (auto _ : state) {
+        EzoCommand command(prefix);
+        command.append(25.437);
+        benchmark::DoNotOptimize(command.data());
+    }
+}
+BENCHMARK(BM_EzoEncodeTempComp);
+
+static void BM_EzoEncodeCalibration(benchmark::State &state)
+{
+    for (auto _ : state) {
+        const EzoCalibration *row = ezoCalibration(PhTraits::calibrations, 102);
+        EzoCommand command(row->command);
+        command.append(7.0);
+        benchmark::DoNotOptimize(command.data());
+    }
+}
+BENCHMARK(BM_EzoEncodeCalibration);
+
+static void BM_PhReadResponse(benchmark::State &state)
+{
+    BenchPH ph;
+    uint8_t *reply = reinterpret_cast<uint8_t*>(const_cast<char*>(PH_READING));
+    int size = strlen(PH_READING);
+    
+    for (auto _ : state) {
+        ph.response(AtlasScientificI2C::READING, reply, size);
+    }
+    benchmark::DoNotOptimize(ph.getRawPH());
+}
+BENCHMARK(BM_PhReadResponse);
+
+static void BM_PhStatusResponse(benchmark::State &state)
+{
+    BenchPH ph;
+    uint8_t *reply = reinterpret_cast<uint8_t*>(const_cast<char*>(PH_STATUS));
+    int size = strlen(PH_STATUS);
+    
+    for (auto _ : state) {
+        ph.response(AtlasScientificI2C::STATUS, reply, size);
+    }
+    benchmark::DoNotOptimize(ph.getVoltage());
+}
+BENCHMARK(BM_PhStatusResponse);
+
+static void BM_DoReadResponse(benchmark::State &state)
+{
+    BenchDO oxygen;
+    uint8_t *reply = reinterpret_cast<uint8_t*>(const_cast<char*>(DO_READING));
+    int size = strlen(DO_READING);
+    
+    for (auto _ : state) {
+        oxygen.response(AtlasScientificI2C::READING, reply, size);
+    }
+    benchmark::DoNotOptimize(oxygen.getRawDO());
+}
+BENCHMARK(BM_DoReadResponse);
+
+static void BM_DoStatusResponse(benchmark::State &state)
+{
+    BenchDO oxygen;
+    uint8_t *reply = reinterpret_cast<uint8_t*>(const_cast<char*>(DO_STATUS));
+    int size = strlen(DO_STATUS);
+    
+    for (auto _ : state) {
+        oxygen.response(AtlasScientificI2C::STATUS, reply, size);
+    }
+}
+BENCHMARK(BM_DoStatusResponse);
+
+static void BM_W1Parse(benchmark::State &state)
+{
+    std::string contents(W1_SLAVE);
+    double celsius = 0;
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Temperature::parse(contents, celsius));
+    }
+}
+BENCHMARK(BM_W1Parse);
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "localresult.h"
+
+/*
+ * The aquarium2/data message with every optional section present and
+ * the given number of temperature probes, built and serialised.
+ */
+static void BM_LocalResultPayload(benchmark::State &state)
+{
+    LocalResult result;
+    
+    result.m_time = 1700000000;
+    result.m_waterLevel = 612;
+    for (int i = 0; i < state.range(0); i++)
+        result.m_temperatures["probe" + std::to_string(i)] = 24.5 + i;
+    result.m_ph = 8.12;
+    result.m_oxygen = 7.9;
+    result.m_rawPh = 8.14;
+    result.m_rawOxygen = 7.86;
+    result.m_readings["ph"] = 8.12;
+    result.m_readings["dissolvedoxygen"] = 7.9;
+    result.m_readings["waterlevel"] = 612;
+    result.m_quality["ph"] = { 4200, Sample::FRESH };
+    result.m_quality["dissolvedoxygen"] = { 4800, Sample::FRESH };
+    result.m_quality["waterlevel"] = { 0, Sample::FRESH };
+    result.m_haveGpioOne = true;
+    result.m_haveGpioTwo = true;
+    result.m_haveFlowRate = true;
+    result.m_flowRate = 11.2;
+    result.m_havePump = true;
+    result.m_pumpRunning = true;
+    result.m_pumpInterlock = "none";
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(result.payload().dump());
+    }
+}
+BENCHMARK(BM_LocalResultPayload)->Arg(1)->Arg(4);
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include <benchmark/benchmark.h>
+
+#include "gpio.h"
+#include "fakegpiobackend.h"
+#include "pumpcontroller.h"
+
+#define PUMP_PIN        11
+#define OVERFLOW_PIN    9
+
+/*
+ * Time from an overflow edge being handed to the controller until the
+ * pump line has been written low, measured by the controller itself.
+ * The max counter is the worst case seen across all iterations. Run as
+ * root to get the SCHED_FIFO thread, otherwise this is best effort.
+ */
+static void BM_PumpOverflowReaction(benchmark::State &state)
+{
+    Gpio::instance()->setBackend(new FakeGpioBackend());
+    PumpController pump(PUMP_PIN, 80, 1000);
+    
+    pump.start();
+    while (!pump.running())
+        std::this_thread::yield();
+    
+    for (auto _ : state) {
+        pump.overflow(OVERFLOW_PIN, PumpController::now());
+        while (pump.running())
+            std::this_thread::yield();
+        
+        state.PauseTiming();
+        pump.overflowCleared(OVERFLOW_PIN);
+        while (!pump.running())
+            std::this_thread::yield();
+        state.ResumeTiming();
+    }
+    
+    PumpController::Stats stats = pump.stats();
+    pump.stop();
+    state.counters["trips"] = stats.trips;
+    state.counters["max_us"] = stats.maxLatency;
+    state.counters["last_us"] = stats.lastLatency;
+}
+BENCHMARK(BM_PumpOverflowReaction)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/*
+ * Low water seen by polling the level source. Reaction is bounded by
+ * the poll period, so this reports how close to one period it gets.
+ */
+static void BM_PumpLowLevelReaction(benchmark::State &state)
+{
+    std::atomic<int> level(500);
+    
+    Gpio::instance()->setBackend(new FakeGpioBackend());
+    PumpController pump(PUMP_PIN, 80, state.range(0));
+    pump.setLevelSource([&level]() { return level.load(); }, 100, 10);
+    
+    pump.start();
+    while (!pump.running())
+        std::this_thread::yield();
+    
+    for (auto _ : state) {
+        level = 50;
+        while (pump.running())
+            std::this_thread::yield();
+        
+        state.PauseTiming();
+        level = 500;
+        while (!pump.running())
+            std::this_thread::yield();
+        state.ResumeTiming();
+    }
+    pump.stop();
+}
+BENCHMARK(BM_PumpLowLevelReaction)->Arg(5)->Arg(50)->Iterations(20)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <mutex>
+#include <condition_variable>
+
+#include <benchmark/benchmark.h>
+
+#include "itimer.h"
+
+/*
+ * Cost of scheduling a zero delay ITimer timeout and waiting for the
+ * callback, which is mostly starting its thread.
+ */
+static void BM_ITimerTimeout(benchmark::State &state)
+{
+    ITimer timer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool fired = false;
+    
+    for (auto _ : state) {
+        fired = false;
+        timer.setTimeout([&](void*) {
+            std::lock_guard<std::mutex> lock(mutex);
+            fired = true;
+            cv.notify_one();
+        }, 0);
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return fired; });
+    }
+}
+BENCHMARK(BM_ITimerTimeout)->UseRealTime();
+
+/*
+ * How late a short timeout fires, reported as a counter in
+ * microseconds so it shows up in the JSON output.
+ */
+static void BM_ITimerLateness(benchmark::State &state)
+{
+    ITimer timer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::chrono::steady_clock::time_point fired;
+    bool done = false;
+    double lateness = 0;
+    
+    for (auto _ : state) {
+        done = false;
+        auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(state.range(0));
+        timer.setTimeout([&](void*) {
+            std::lock_guard<std::mutex> lock(mutex);
+            fired = std::chrono::steady_clock::now();
+            done = true;
+            cv.notify_one();
+        }, state.range(0));
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return done; });
+        lateness += std::chrono::duration<double, std::micro>(fired - due).count();
+    }
+    state.counters["lateness_us"] = benchmark::Counter(lateness, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ITimerLateness)->Arg(1)->Arg(10)->UseRealTime();
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "trace.h"
+
+/*
+ * What an instrumented function pays when tracing is off.
+ */
+static void BM_TraceScopeDisabled(benchmark::State &state)
+{
+    Tracer::setEnabled(false);
+    
+    for (auto _ : state) {
+        TRACE_SCOPE("bench");
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_TraceScopeDisabled);
+
+/*
+ * Two clock reads and a ring store with it on.
+ */
+static void BM_TraceScopeEnabled(benchmark::State &state)
+{
+    Tracer::setEnabled(true);
+    
+    for (auto _ : state) {
+        TRACE_SCOPE("bench");
+        benchmark::ClobberMemory();
+    }
+    Tracer::setEnabled(false);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TraceScopeEnabled)->Threads(1)->Threads(4);
@@ -28,9 +28,8 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <cstdlib>
 #include <iomanip>
-#include <mutex>
-#include <condition_variable>
 
 #include <wiringPi.h>
 #include <libconfig.h>
@@ -39,8 +38,11 @@
 #include <errno.h>
 
 #include "configuration.h"
+#include "ezosensor.h"
+#include "gpio.h"
 #include "dissolvedoxygen.h"
 #include "itimer.h"
+#include "sensorcalibration.h"
 
 #define ONE_SECOND          1000
 #define TWO_SECONDS         (2 * ONE_SECOND)
@@ -49,46 +51,48 @@
 
 struct LocalConfig {
     DissolvedOxygen *oxygen;
+    Sensor *device;
     std::string configFile;
+    std::string sensor;
     int dosensor_address;
     int red_led;
     int yellow_led;
     int green_led;
-    int operation;
-    bool done;
+    int window;
+    double slope;
+    double deviation;
     bool clear;
     bool query;
 };
 
 struct LocalConfig *g_localConfig;
-std::mutex g_mutex;
 
 void eternalBlinkAndDie(int pin, int millihz)
 {
     int state = 0;
-    digitalWrite(pin, state);
+    Gpio::instance()->write(pin, state);
     while (1) {
         std::this_thread::sleep_for(std::chrono::milliseconds(millihz));
         state ^= 1UL << 0;
-        digitalWrite(pin, state); 
+        Gpio::instance()->write(pin, state); 
     }
 }
 
 void initializeLeds()
 {
-    digitalWrite(Configuration::instance()->m_greenLed, 1);
-    digitalWrite(Configuration::instance()->m_yellowLed, 0);
-    digitalWrite(Configuration::instance()->m_redLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);
 
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    digitalWrite(Configuration::instance()->m_yellowLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_yellowLed, 0);
-    digitalWrite(Configuration::instance()->m_redLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_redLed, 0);
-    digitalWrite(Configuration::instance()->m_greenLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
 }
 
 bool cisCompare(const std::string & str1, const std::string &str2)
@@ -100,40 +104,40 @@ bool cisCompare(const std::string & str1, const std::string &str2)
 
 void setNormalDisplay()
 {
-    digitalWrite(g_localConfig->green_led, 1);
-    digitalWrite(g_localConfig->yellow_led, 0);
-    digitalWrite(g_localConfig->red_led, 0);    
+    Gpio::instance()->write(g_localConfig->green_led, 1);
+    Gpio::instance()->write(g_localConfig->yellow_led, 0);
+    Gpio::instance()->write(g_localConfig->red_led, 0);    
 }
 
 void setWarningDisplay()
 {
-    digitalWrite(g_localConfig->green_led, 0);
-    digitalWrite(g_localConfig->yellow_led, 1);
-    digitalWrite(g_localConfig->red_led, 0);    
+    Gpio::instance()->write(g_localConfig->green_led, 0);
+    Gpio::instance()->write(g_localConfig->yellow_led, 1);
+    Gpio::instance()->write(g_localConfig->red_led, 0);    
 }
 
 void setErrorDisplay()
 {
-    digitalWrite(g_localConfig->green_led, 0);
-    digitalWrite(g_localConfig->yellow_led, 0);
-    digitalWrite(g_localConfig->red_led, 1);    
+    Gpio::instance()->write(g_localConfig->green_led, 0);
+    Gpio::instance()->write(g_localConfig->yellow_led, 0);
+    Gpio::instance()->write(g_localConfig->red_led, 1);    
 }
 
 void initializeLeds(struct LocalConfig &lc)
 {
-    digitalWrite(lc.green_led, 1);
-    digitalWrite(lc.yellow_led, 0);
-    digitalWrite(lc.red_led, 0);
+    Gpio::instance()->write(lc.green_led, 1);
+    Gpio::instance()->write(lc.yellow_led, 0);
+    Gpio::instance()->write(lc.red_led, 0);
 
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(lc.green_led, 0);
-    digitalWrite(lc.yellow_led, 1);
+    Gpio::instance()->write(lc.green_led, 0);
+    Gpio::instance()->write(lc.yellow_led, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(lc.yellow_led, 0);
-    digitalWrite(lc.red_led, 1);
+    Gpio::instance()->write(lc.yellow_led, 0);
+    Gpio::instance()->write(lc.red_led, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(lc.red_led, 0);
-    digitalWrite(lc.green_led, 1);
+    Gpio::instance()->write(lc.red_led, 0);
+    Gpio::instance()->write(lc.green_led, 1);
 }
 
 void mqttIncomingMessage(std::string, std::string)
@@ -168,29 +172,13 @@ void aioConnectionLost(const std::string &cause)
     Configuration::instance()->m_aioEnabled = false;
 }
 
-void waitForInput()
-{
-    while (!g_localConfig->done) {
-        g_mutex.lock();
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        g_mutex.unlock();
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    }
-}
-
-void writeCalibrationData()
-{
-    g_mutex.lock();
-    Configuration::instance()->m_oxygen->calibrate(DissolvedOxygen::DO_DEFAULT, nullptr, 0);
-    g_mutex.unlock();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-}
-
-void doCallback(int cmd, std::string response)
+/*
+ * Only the calibration query is of interest, the readings are shown as
+ * the engine takes them.
+ */
+void doCallback(Sensor*, int cmd, std::string response)
 {
     switch (cmd) {
-        case AtlasScientificI2C::INFO:
-            break;
         case AtlasScientificI2C::CALIBRATE:
             if (response.find("?CAL") != std::string::npos) {
                 std::cout << "There are " << response.substr(6) << " points of calibration" << std::endl;
@@ -202,8 +190,30 @@ void doCallback(int cmd, std::string response)
                 }
             }
             break;
-        case AtlasScientificI2C::READING:
-            std::cout << "DO: " << response << '\r' << std::flush;
+        default:
+            break;
+    }
+}
+
+void doProgress(Sensor*, CalibrationEngine::State state, const CalibrationPoint &point, const Sample &sample, const StabilityDetector &detector)
+{
+    switch (state) {
+        case CalibrationEngine::PLACE:
+            if (sample.time != 0)
+                std::cout << "DO: " << std::fixed << std::setprecision(2) << sample.value << " waiting for a good reading          \r" << std::flush;
+            break;
+        case CalibrationEngine::SETTLING:
+            std::cout << "DO: " << std::fixed << std::setprecision(2) << sample.value << " settling " << detector.count() << "/" << detector.window()
+                      << " deviation " << std::setprecision(3) << detector.deviation() << " drift " << detector.slope() << "/min   \r" << std::flush;
+            break;
+        case CalibrationEngine::ACCEPTED:
+            std::cout << std::endl << point.name << " stored, the probe read " << std::setprecision(2) << detector.mean() << std::endl;
+            break;
+        case CalibrationEngine::TIMEOUT:
+            std::cout << std::endl << point.name << " never settled, giving up." << std::endl;
+            break;
+        case CalibrationEngine::FAILED:
+            std::cout << std::endl << "The probe would not take the " << point.name << " point." << std::endl;
             break;
         default:
             break;
@@ -217,6 +227,10 @@ void usage(const char *name)
     std::cerr << "\t-l Clear calibration data and exit" << std::endl;
     std::cerr << "\t-q Query calibration state and exit" << std::endl;
     std::cerr << "\t-z Zero calibration and exit" << std::endl;
+    std::cerr << "\t-s Name of the DO sensor to calibrate (defaults to the first one configured)" << std::endl;
+    std::cerr << "\t-w Number of readings that have to agree before the point is stored (default " << CALIBRATION_WINDOW << ")" << std::endl;
+    std::cerr << "\t-t Largest standard deviation over those readings, in mg/L (default " << DO_STABLE_DEVIATION << ")" << std::endl;
+    std::cerr << "\t-r Largest drift over those readings, in mg/L per minute (default " << DO_STABLE_SLOPE << ")" << std::endl;
     std::cerr << "\t-h Print usage and exit" << std::endl;
     exit(-1);
 }
@@ -240,8 +254,11 @@ bool parse_args(int argc, char **argv, struct LocalConfig &config)
     
     config.clear = false;
     config.query = false;
+    config.window = CALIBRATION_WINDOW;
+    config.slope = DO_STABLE_SLOPE;
+    config.deviation = DO_STABLE_DEVIATION;
 	if (argv) {
-		while ((opt = getopt(argc, argv, "c:hlq")) != -1) {
+		while ((opt = getopt(argc, argv, "c:hlqs:w:t:r:")) != -1) {
 			switch (opt) {
             case 'h':
                 usage(argv[0]);
@@ -255,6 +272,18 @@ bool parse_args(int argc, char **argv, struct LocalConfig &config)
             case 'q':
                 config.query = true;
                 break;
+            case 's':
+                config.sensor = optarg;
+                break;
+            case 'w':
+                config.window = std::atoi(optarg);
+                break;
+            case 't':
+                config.deviation = std::atof(optarg);
+                break;
+            case 'r':
+                config.slope = std::atof(optarg);
+                break;
 	        default:
                 syslog(LOG_ERR, "Unexpected command line argument given");
 	            usage(argv[0]);
@@ -279,30 +308,44 @@ bool parse_args(int argc, char **argv, struct LocalConfig &config)
     return rval;
 }
 
+/*
+ * The point is stored as soon as the reading in air settles.
+ */
 void mainloop(struct LocalConfig &lc)
 {
-    ITimer oxygen;
-    auto dofunc = [lc](void*) { lc.oxygen->sendReadCommand(900); };
-        
+    CalibrationPlan plan;
+    
+    SensorCalibration::plan("do", plan);
+    plan.window = lc.window;
+    plan.slope = lc.slope;
+    plan.deviation = lc.deviation;
+    
+    SensorCalibration calibration(lc.device, plan);
+    std::vector<CalibrationResult> results;
+    bool complete = false;
+    
+    calibration.setProgress(doProgress);
+    calibration.setDone([&](Sensor*, bool done, const std::vector<CalibrationResult> &r) { complete = done; results = r; });
+    
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     std::cout << "Calibration operation for the DO probe." << std::endl;
-    std::cout << "This is a single point calibration routine. Expose the probe to air for 30 seconds." << std::endl;
-    std::cout << "When readings stabilize, press enter to store calibration." << std::endl;
+    std::cout << "This is a single point calibration routine. Expose the probe to air and press enter." << std::endl;
+    std::cout << "The calibration is stored as soon as the readings stabilize." << std::endl;
     
     initializeLeds(lc);
     
-    g_localConfig->done = false;
     std::cin.ignore( std::numeric_limits <std::streamsize> ::max(), '\n' );
-    Configuration::instance()->m_oxygen->sendReadCommand(600);
-    std::thread listener(waitForInput);
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    std::thread sender(writeCalibrationData);
-    oxygen.setInterval(dofunc, TWO_SECONDS);
-    sender.join();
-    g_localConfig->done = true;
-    std::cout << "Calibration complete, cleaning up, press enter to start cleaning up" << std::endl;
-    oxygen.stop();
-    listener.join();
+    calibration.start();
+    calibration.wait();
+    
+    std::cout << std::endl;
+    for (auto &result : results) {
+        if (result.accepted)
+            std::cout << result.name << ": stored, read " << std::fixed << std::setprecision(2) << result.reading << ", settled in " << std::setprecision(1) << result.settle / 1000.0 << " seconds" << std::endl;
+        else
+            std::cout << result.name << ": not stored" << std::endl;
+    }
+    std::cout << (complete ? "Calibration complete" : "Calibration incomplete") << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(2));
 }
 
@@ -328,23 +371,40 @@ int main(int argc, char *argv[])
         exit(-2);
     }
 
+    Sensor *sensor = lc.sensor.empty() ? SensorRegistry::instance()->primary("do") : SensorRegistry::instance()->find(lc.sensor);
+    DoSensor *probe = dynamic_cast<DoSensor*>(sensor);
+    lc.oxygen = probe ? probe->probe() : nullptr;
+    lc.device = probe;
+    if (probe)
+        probe->setCallback(doCallback);
+    
+    if (lc.oxygen == nullptr) {
+        std::cerr << "No DO probe found in the sensors configuration, exiting..." << std::endl;
+        syslog(LOG_ERR, "No DO probe found in the sensors configuration, exiting...");
+        exit(-3);
+    }
+
+    // Only the LEDs are driven here, calibration can go ahead without them
+    Gpio::instance()->setBackend(Gpio::createBackend(Configuration::instance()->m_gpioBackend, Configuration::instance()->m_gpioChip));
+    if (Gpio::instance()->backend() == nullptr)
+        std::cerr << "No GPIO backend, the LEDs are off" << std::endl;
     initializeLeds();
         
     g_localConfig = &lc;
     if (g_localConfig->clear) {
         std::cout << "Clearing calibration data..." << std::endl;
-        Configuration::instance()->m_oxygen->calibrate(DissolvedOxygen::DO_CLEAR, nullptr, 0);
-        Configuration::instance()->m_oxygen->calibrate(DissolvedOxygen::DO_QUERY, nullptr, 0);
+        g_localConfig->oxygen->calibrate(DissolvedOxygen::DO_CLEAR);
+        g_localConfig->oxygen->calibrate(DissolvedOxygen::DO_QUERY);
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }
     else if (g_localConfig->query) {
         std::cout << "Checking calibration data..." << std::endl;
-        Configuration::instance()->m_oxygen->calibrate(DissolvedOxygen::DO_QUERY, nullptr, 0);
+        g_localConfig->oxygen->calibrate(DissolvedOxygen::DO_QUERY);
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }        
     else {
-        Configuration::instance()->m_oxygen->sendInfoCommand();
-        Configuration::instance()->m_oxygen->calibrate(DissolvedOxygen::DO_QUERY, nullptr, 0);
+        g_localConfig->oxygen->sendInfoCommand();
+        g_localConfig->oxygen->calibrate(DissolvedOxygen::DO_QUERY);
         mainloop(lc);
     }
     
@@ -28,9 +28,8 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <cstdlib>
 #include <iomanip>
-#include <mutex>
-#include <condition_variable>
 
 #include <wiringPi.h>
 #include <libconfig.h>
@@ -39,8 +38,11 @@
 #include <errno.h>
 
 #include "configuration.h"
+#include "ezosensor.h"
+#include "gpio.h"
 #include "potentialhydrogen.h"
 #include "itimer.h"
+#include "sensorcalibration.h"
 #include "temperature.h"
 
 #define ONE_SECOND          1000
@@ -50,46 +52,48 @@
 
 struct LocalConfig {
     PotentialHydrogen *ph;
+    Sensor *device;
     std::string configFile;
+    std::string sensor;
     int phsensor_address;
     int red_led;
     int yellow_led;
     int green_led;
-    int operation;
-    bool done;
+    int window;
+    double slope;
+    double deviation;
     bool clear;
     bool query;
 };
 
 struct LocalConfig *g_localConfig;
-std::mutex g_mutex;
 
 void eternalBlinkAndDie(int pin, int millihz)
 {
     int state = 0;
-    digitalWrite(pin, state);
+    Gpio::instance()->write(pin, state);
     while (1) {
         std::this_thread::sleep_for(std::chrono::milliseconds(millihz));
         state ^= 1UL << 0;
-        digitalWrite(pin, state); 
+        Gpio::instance()->write(pin, state); 
     }
 }
 
 void initializeLeds()
 {
-    digitalWrite(Configuration::instance()->m_greenLed, 1);
-    digitalWrite(Configuration::instance()->m_yellowLed, 0);
-    digitalWrite(Configuration::instance()->m_redLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);
 
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    digitalWrite(Configuration::instance()->m_yellowLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_yellowLed, 0);
-    digitalWrite(Configuration::instance()->m_redLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 1);
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    digitalWrite(Configuration::instance()->m_redLed, 0);
-    digitalWrite(Configuration::instance()->m_greenLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
 }
 
 bool cisCompare(const std::string & str1, const std::string &str2)
@@ -101,33 +105,23 @@ bool cisCompare(const std::string & str1, const std::string &str2)
 
 void setNormalDisplay()
 {
-    digitalWrite(Configuration::instance()->m_greenLed, 1);
-    digitalWrite(Configuration::instance()->m_yellowLed, 0);
-    digitalWrite(Configuration::instance()->m_redLed, 0);    
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);    
 }
 
 void setWarningDisplay()
 {
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    digitalWrite(Configuration::instance()->m_yellowLed, 1);
-    digitalWrite(Configuration::instance()->m_redLed, 0);    
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 1);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 0);    
 }
 
 void setErrorDisplay()
 {
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    digitalWrite(Configuration::instance()->m_yellowLed, 0);
-    digitalWrite(Configuration::instance()->m_redLed, 1);    
-}
-
-void waitForInput()
-{
-    while (!g_localConfig->done) {
-        g_mutex.lock();
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        g_mutex.unlock();
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    }
+    Gpio::instance()->write(Configuration::instance()->m_greenLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_yellowLed, 0);
+    Gpio::instance()->write(Configuration::instance()->m_redLed, 1);    
 }
 
 void mqttIncomingMessage(std::string, std::string)
@@ -162,36 +156,13 @@ void aioConnectionLost(const std::string &cause)
     Configuration::instance()->m_aioEnabled = false;
 }
 
-void writeCalibrationData()
-{
-    while (1) {
-        g_mutex.lock();
-        Configuration::instance()->m_ph->calibrate(g_localConfig->operation);
-        g_mutex.unlock();
-        switch (g_localConfig->operation) {
-            case PotentialHydrogen::PH_MID:
-                g_localConfig->operation = PotentialHydrogen::PH_LOW;
-                std::cout << "Place sensor in pH 4.00 solution now." << std::endl;
-                setWarningDisplay();
-                break;
-            case PotentialHydrogen::PH_LOW:
-                g_localConfig->operation = PotentialHydrogen::PH_HIGH;
-                std::cout << "Place sensor in pH 10.00 solution now." << std::endl;
-                setErrorDisplay();
-                break;
-            case PotentialHydrogen::PH_HIGH:
-                Configuration::instance()->m_ph->calibrate(PotentialHydrogen::PH_QUERY, nullptr, 0);
-                return;
-        }
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
-}
-
-void phCallback(int cmd, std::string response)
+/*
+ * Only the calibration query is of interest, the readings are shown as
+ * the engine takes them.
+ */
+void phCallback(Sensor*, int cmd, std::string response)
 {
     switch (cmd) {
-        case AtlasScientificI2C::INFO:
-            break;
         case AtlasScientificI2C::CALIBRATE:
             if (response.find("?CAL") != std::string::npos) {
                 std::cout << "There are " << response.substr(6) << " points of calibration" << std::endl;
@@ -206,8 +177,42 @@ void phCallback(int cmd, std::string response)
                 }
             }
             break;
-        case AtlasScientificI2C::READING:
-            std::cout << "PH: " << response << '\r' << std::flush;
+        default:
+            break;
+    }
+}
+
+/*
+ * The LEDs go green, yellow, red for the 7, 4 and 10 points as they
+ * always have.
+ */
+void phProgress(Sensor*, CalibrationEngine::State state, const CalibrationPoint &point, const Sample &sample, const StabilityDetector &detector)
+{
+    switch (state) {
+        case CalibrationEngine::PLACE:
+            if (sample.time == 0) {
+                std::cout << std::endl << "Place sensor in " << point.name << " solution now." << std::endl;
+                if (point.command == PotentialHydrogen::PH_LOW)
+                    setWarningDisplay();
+                if (point.command == PotentialHydrogen::PH_HIGH)
+                    setErrorDisplay();
+            }
+            else {
+                std::cout << "PH: " << std::fixed << std::setprecision(3) << sample.value << " waiting for " << point.name << "          \r" << std::flush;
+            }
+            break;
+        case CalibrationEngine::SETTLING:
+            std::cout << "PH: " << std::fixed << std::setprecision(3) << sample.value << " settling " << detector.count() << "/" << detector.window()
+                      << " deviation " << std::setprecision(4) << detector.deviation() << " drift " << detector.slope() << "/min   \r" << std::flush;
+            break;
+        case CalibrationEngine::ACCEPTED:
+            std::cout << std::endl << point.name << " stored as " << std::setprecision(2) << point.expected << ", the probe read " << std::setprecision(3) << detector.mean() << std::endl;
+            break;
+        case CalibrationEngine::TIMEOUT:
+            std::cout << std::endl << point.name << " never settled, giving up." << std::endl;
+            break;
+        case CalibrationEngine::FAILED:
+            std::cout << std::endl << "The probe would not take the " << point.name << " point." << std::endl;
             break;
         default:
             break;
@@ -220,6 +225,10 @@ void usage(const char *name)
     std::cerr << "\t-c alternate configuration file (defaults to $HOME/.config/aquarium.conf" << std::endl;
     std::cerr << "\t-l Clear calibration data and exit" << std::endl;
     std::cerr << "\t-q Query calibration state and exit" << std::endl;
+    std::cerr << "\t-s Name of the pH sensor to calibrate (defaults to the first one configured)" << std::endl;
+    std::cerr << "\t-w Number of readings that have to agree before a point is stored (default " << CALIBRATION_WINDOW << ")" << std::endl;
+    std::cerr << "\t-t Largest standard deviation over those readings, in pH (default " << PH_STABLE_DEVIATION << ")" << std::endl;
+    std::cerr << "\t-r Largest drift over those readings, in pH per minute (default " << PH_STABLE_SLOPE << ")" << std::endl;
     std::cerr << "\t-h Print usage and exit" << std::endl;
     exit(-1);
 }
@@ -243,8 +252,11 @@ bool parse_args(int argc, char **argv, struct LocalConfig &config)
     
     config.clear = false;
     config.query = false;
+    config.window = CALIBRATION_WINDOW;
+    config.slope = PH_STABLE_SLOPE;
+    config.deviation = PH_STABLE_DEVIATION;
 	if (argv) {
-		while ((opt = getopt(argc, argv, "c:hlq")) != -1) {
+		while ((opt = getopt(argc, argv, "c:hlqs:w:t:r:")) != -1) {
 			switch (opt) {
             case 'h':
                 usage(argv[0]);
@@ -258,6 +270,18 @@ bool parse_args(int argc, char **argv, struct LocalConfig &config)
             case 'q':
                 config.query = true;
                 break;
+            case 's':
+                config.sensor = optarg;
+                break;
+            case 'w':
+                config.window = std::atoi(optarg);
+                break;
+            case 't':
+                config.deviation = std::atof(optarg);
+                break;
+            case 'r':
+                config.slope = std::atof(optarg);
+                break;
 	        default:
                 syslog(LOG_ERR, "Unexpected command line argument given");
 	            usage(argv[0]);
@@ -282,32 +306,45 @@ bool parse_args(int argc, char **argv, struct LocalConfig &config)
     return rval;
 }
 
+/*
+ * Each point is stored as soon as its reading settles, nobody has to
+ * watch the numbers or press a key between them.
+ */
 void mainloop(struct LocalConfig &lc)
 {
-    ITimer ph;
-    auto phfunc = [lc](void*) { lc.ph->sendReadCommand(900); };
-        
+    CalibrationPlan plan;
+    
+    SensorCalibration::plan("ph", plan);
+    plan.window = lc.window;
+    plan.slope = lc.slope;
+    plan.deviation = lc.deviation;
+    
+    SensorCalibration calibration(lc.device, plan);
+    std::vector<CalibrationResult> results;
+    bool complete = false;
+    
+    calibration.setProgress(phProgress);
+    calibration.setDone([&](Sensor*, bool done, const std::vector<CalibrationResult> &r) { complete = done; results = r; });
+    
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     std::cout << "Calibration operation for the pH probe" << std::endl;
     std::cout << "Calibrate using the pH 7.00 solution first, then the pH 4.00 solution, and finally the pH 10.00 solution." << std::endl;
-    std::cout << "When you achieve a valid calibration value, press the enter key to store that value." << std::endl;
-    std::cout << "The program will then transition to the next calibration step and wait for the enter key" << std::endl;
+    std::cout << "Each value is stored as soon as the reading settles, then the program asks for the next solution." << std::endl;
     std::cout << "When you have finished, the program will print out the calibration results and exit." << std::endl;
     std::cout << "Insert the probe into the 7.00 solution, and press the enter key to begin." << std::endl;
     
-    g_localConfig->done = false;
     std::cin.ignore( std::numeric_limits <std::streamsize> ::max(), '\n' );
-    Configuration::instance()->m_ph->sendReadCommand(900);
-    std::thread listener(waitForInput);
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    std::thread sender(writeCalibrationData);
-    ph.setInterval(phfunc, TWO_SECONDS);
-    g_localConfig->operation = PotentialHydrogen::PH_MID;
-    sender.join();
-    g_localConfig->done = true;
-    std::cout << "Calibration complete, cleaning up, press enter to start cleaning up" << std::endl;
-    ph.stop();
-    listener.join();
+    calibration.start();
+    calibration.wait();
+    
+    std::cout << std::endl;
+    for (auto &result : results) {
+        if (result.accepted)
+            std::cout << result.name << ": stored as " << std::fixed << std::setprecision(2) << result.value << ", read " << std::setprecision(3) << result.reading << ", settled in " << std::setprecision(1) << result.settle / 1000.0 << " seconds" << std::endl;
+        else
+            std::cout << result.name << ": not stored" << std::endl;
+    }
+    std::cout << (complete ? "Calibration complete" : "Calibration incomplete") << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(2));
 }
 
@@ -333,23 +370,40 @@ int main(int argc, char *argv[])
         exit(-2);
     }
 
+    Sensor *sensor = lc.sensor.empty() ? SensorRegistry::instance()->primary("ph") : SensorRegistry::instance()->find(lc.sensor);
+    PhSensor *probe = dynamic_cast<PhSensor*>(sensor);
+    lc.ph = probe ? probe->probe() : nullptr;
+    lc.device = probe;
+    if (probe)
+        probe->setCallback(phCallback);
+    
+    if (lc.ph == nullptr) {
+        std::cerr << "No pH probe found in the sensors configuration, exiting..." << std::endl;
+        syslog(LOG_ERR, "No pH probe found in the sensors configuration, exiting...");
+        exit(-3);
+    }
+
+    // Only the LEDs are driven here, calibration can go ahead without them
+    Gpio::instance()->setBackend(Gpio::createBackend(Configuration::instance()->m_gpioBackend, Configuration::instance()->m_gpioChip));
+    if (Gpio::instance()->backend() == nullptr)
+        std::cerr << "No GPIO backend, the LEDs are off" << std::endl;
     initializeLeds();
     
     g_localConfig = &lc;
     if (g_localConfig->clear) {
         std::cout << "Clearing calibration data..." << std::endl;
-        Configuration::instance()->m_ph->calibrate(PotentialHydrogen::PH_CLEAR, nullptr, 0);
-        Configuration::instance()->m_ph->calibrate(PotentialHydrogen::PH_QUERY, nullptr, 0);
+        g_localConfig->ph->calibrate(PotentialHydrogen::PH_CLEAR);
+        g_localConfig->ph->calibrate(PotentialHydrogen::PH_QUERY);
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }
     else if (g_localConfig->query) {
         std::cout << "Checking calibration data..." << std::endl;
-        Configuration::instance()->m_ph->calibrate(PotentialHydrogen::PH_QUERY, nullptr, 0);
+        g_localConfig->ph->calibrate(PotentialHydrogen::PH_QUERY);
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }        
     else {
-        Configuration::instance()->m_ph->sendInfoCommand();
-        Configuration::instance()->m_ph->calibrate(PotentialHydrogen::PH_QUERY, nullptr, 0);
+        g_localConfig->ph->sendInfoCommand();
+        g_localConfig->ph->calibrate(PotentialHydrogen::PH_QUERY);
         mainloop(lc);
     }
     
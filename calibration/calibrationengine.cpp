@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <chrono>
+
+#include "calibrationengine.h"
+#include "logger.h"
+
+CalibrationEngine::CalibrationEngine(Reader read, Source sample, Writer calibrate) : 
+    m_read(read), m_sample(sample), m_calibrate(calibrate), m_detector(CALIBRATION_WINDOW, 0, 0)
+{
+    m_abort = false;
+    m_interval = CALIBRATION_INTERVAL_MS;
+    m_timeout = CALIBRATION_TIMEOUT_MS;
+}
+
+/*
+ * slope is in probe units per minute and deviation in probe units, both
+ * 0 until this is called, which never settles.
+ */
+void CalibrationEngine::setStability(int window, double slope, double deviation)
+{
+    m_detector = StabilityDetector(window, slope, deviation);
+}
+
+void CalibrationEngine::abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_abort = true;
+    }
+    m_cv.notify_all();
+}
+
+/*
+ * Sleeps for ms unless aborted first, returns false if it was.
+ */
+bool CalibrationEngine::wait(int ms)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return !m_cv.wait_for(lock, std::chrono::milliseconds(ms), [this]() { return m_abort.load(); });
+}
+
+void CalibrationEngine::report(State state, const CalibrationPoint &point, const Sample &sample)
+{
+    if (m_progress)
+        m_progress(state, point, sample, m_detector);
+}
+
+/**
+ * \fn bool CalibrationEngine::run()
+ * 
+ * Runs every point in the order they were added. Stops at the first one
+ * that times out or when aborted, the points written before that stay
+ * written. Returns true if they were all accepted.
+ */
+bool CalibrationEngine::run()
+{
+    m_results.clear();
+    
+    for (auto &point : m_points) {
+        CalibrationResult result;
+        result.name = point.name;
+        result.expected = point.expected;
+        
+        State state = settle(point, result);
+        m_results.push_back(result);
+        if (state != ACCEPTED)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * A reading counts once, when its time changes. Readings that aren't
+ * good, or aren't near what the point expects, start the window over,
+ * the probe isn't in the solution yet or was just moved.
+ */
+CalibrationEngine::State CalibrationEngine::settle(const CalibrationPoint &point, CalibrationResult &result)
+{
+    auto start = std::chrono::steady_clock::now();
+    int64_t last = m_sample().time;
+    
+    m_detector.reset();
+    LOGI("Calibration point started", "point", point.name);
+    report(PLACE, point, Sample());
+    
+    while (!m_abort) {
+        auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_interval);
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        
+        if (elapsed > m_timeout) {
+            LOGW("Calibration point never settled", "point", point.name, "timeout_s", m_timeout / 1000, "deviation", m_detector.deviation(), "slope", m_detector.slope());
+            report(TIMEOUT, point, m_sample());
+            return TIMEOUT;
+        }
+        
+        if (m_read()) {
+            while (m_sample().time == last && std::chrono::steady_clock::now() < next) {
+                if (!wait(CALIBRATION_POLL_MS))
+                    break;
+            }
+        }
+        
+        Sample sample = m_sample();
+        if (sample.time != last) {
+            last = sample.time;
+            if (sample.good() && point.accepts(sample.value)) {
+                m_detector.add(sample.time, sample.value);
+                report(SETTLING, point, sample);
+            }
+            else {
+                m_detector.reset();
+                report(PLACE, point, sample);
+            }
+        }
+        
+        if (m_detector.stable()) {
+            // The probe is told what the solution is, not what it already reads
+            result.reading = m_detector.mean();
+            result.value = std::isnan(point.expected) ? result.reading : point.expected;
+            result.settle = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            result.accepted = m_calibrate(point.command, result.value);
+            if (!result.accepted) {
+                LOGE("Probe refused the calibration point", "point", point.name, "value", result.value, "reading", result.reading);
+                report(FAILED, point, sample);
+                return FAILED;
+            }
+            LOGI("Calibration point accepted", "point", point.name, "value", result.value, "reading", result.reading,
+                 "settle_s", result.settle / 1000.0, "deviation", m_detector.deviation(), "slope", m_detector.slope());
+            report(ACCEPTED, point, sample);
+            return ACCEPTED;
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        if (now < next && !wait(std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count()))
+            break;
+    }
+    
+    LOGW("Calibration aborted", "point", point.name);
+    report(ABORTED, point, m_sample());
+    return ABORTED;
+}
+
+const char* CalibrationEngine::name(State state)
+{
+    switch (state) {
+        case PLACE: return "place";
+        case SETTLING: return "settling";
+        case ACCEPTED: return "accepted";
+        case TIMEOUT: return "timeout";
+        case FAILED: return "failed";
+        case ABORTED: return "aborted";
+    }
+    return "unknown";
+}
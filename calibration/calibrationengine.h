@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CALIBRATIONENGINE_H
+#define CALIBRATIONENGINE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <cmath>
+
+#include "sample.h"
+#include "stabilitydetector.h"
+
+#define CALIBRATION_INTERVAL_MS     1000
+#define CALIBRATION_TIMEOUT_MS      (15 * 60 * 1000)
+#define CALIBRATION_WINDOW          10
+#define CALIBRATION_POLL_MS         50
+
+/**
+ * \struct CalibrationPoint
+ * 
+ * One step of a calibration. command is the probe's calibration code.
+ * A point with an expected value only starts settling once readings
+ * are within range of it, so a probe still sitting in the last
+ * solution isn't taken for this one. NAN takes any reading.
+ */
+struct CalibrationPoint {
+    int command;
+    std::string name;
+    double expected;
+    double range;
+    
+    CalibrationPoint(int c, std::string n, double e = NAN, double r = 0) : command(c), name(n), expected(e), range(r) {}
+    
+    bool accepts(double value) const { return std::isnan(expected) || std::fabs(value - expected) <= range; }
+};
+
+/**
+ * \struct CalibrationResult
+ * 
+ * What happened to a point. settle is the ms from the point starting
+ * to its reading being stable, reading the mean over the window and
+ * value what was sent to the probe. That's the point's expected value,
+ * the solution's, and only the reading for points that have none.
+ */
+struct CalibrationResult {
+    std::string name;
+    double expected;
+    double value;
+    double reading;
+    int64_t settle;
+    bool accepted;
+    
+    CalibrationResult() : expected(NAN), value(0), reading(0), settle(0), accepted(false) {}
+};
+
+/**
+ * \class CalibrationEngine
+ * 
+ * Walks a probe through its calibration points without anyone watching
+ * the numbers. The probe is read every interval, each good reading goes
+ * to a StabilityDetector and the point is written to the probe as soon
+ * as the detector says the reading has settled. The engine only knows
+ * the probe through three functions, start a reading, get the latest
+ * Sample and write a calibration point with its value, so the same
+ * engine runs any EZO circuit.
+ * 
+ * run() blocks the calling thread. Progress is called from it on every
+ * reading with the state of the current point, and with PLACE and an
+ * empty Sample as each point starts. abort() may be called from
+ * anywhere.
+ */
+class CalibrationEngine
+{
+public:
+    enum State {
+        PLACE,
+        SETTLING,
+        ACCEPTED,
+        TIMEOUT,
+        FAILED,
+        ABORTED,
+    };
+    
+    typedef std::function<bool()> Reader;
+    typedef std::function<Sample()> Source;
+    typedef std::function<bool(int, double)> Writer;
+    typedef std::function<void(State, const CalibrationPoint&, const Sample&, const StabilityDetector&)> Progress;
+    
+    CalibrationEngine(Reader read, Source sample, Writer calibrate);
+    
+    void setStability(int window, double slope, double deviation);
+    void setInterval(int ms) { m_interval = ms; }
+    void setTimeout(int ms) { m_timeout = ms; }
+    void setProgress(Progress progress) { m_progress = progress; }
+    void addPoint(const CalibrationPoint &point) { m_points.push_back(point); }
+    
+    bool run();
+    void abort();
+    bool aborted() const { return m_abort; }
+    const std::vector<CalibrationResult>& results() const { return m_results; }
+    
+    static const char* name(State state);
+    
+private:
+    State settle(const CalibrationPoint &point, CalibrationResult &result);
+    bool wait(int ms);
+    void report(State state, const CalibrationPoint &point, const Sample &sample);
+    
+    Reader m_read;
+    Source m_sample;
+    Writer m_calibrate;
+    Progress m_progress;
+    StabilityDetector m_detector;
+    std::vector<CalibrationPoint> m_points;
+    std::vector<CalibrationResult> m_results;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<bool> m_abort;
+    int m_interval;
+    int m_timeout;
+};
+
+#endif // CALIBRATIONENGINE_H
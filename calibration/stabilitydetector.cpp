@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "stabilitydetector.h"
+
+StabilityDetector::StabilityDetector(int window, double slope, double deviation)
+{
+    if (window < 3)
+        window = 3;
+    if (window > MAX_STABILITY_WINDOW)
+        window = MAX_STABILITY_WINDOW;
+    
+    m_window = window;
+    m_slopeTolerance = std::fabs(slope);
+    m_deviationTolerance = std::fabs(deviation);
+    reset();
+}
+
+void StabilityDetector::reset()
+{
+    m_times.fill(0);
+    m_values.fill(0.0);
+    m_count = 0;
+    m_next = 0;
+    m_mean = 0.0;
+    m_slope = 0.0;
+    m_deviation = 0.0;
+}
+
+/**
+ * \fn void StabilityDetector::add(int64_t time, double value)
+ * 
+ * time is in ms, only the differences matter. A reading with the same
+ * time as the one before it is the same reading seen twice and is
+ * ignored.
+ */
+void StabilityDetector::add(int64_t time, double value)
+{
+    if (m_count > 0) {
+        int last = (m_next + m_window - 1) % m_window;
+        if (m_times[last] == time)
+            return;
+    }
+    
+    m_times[m_next] = time;
+    m_values[m_next] = value;
+    m_next = (m_next + 1) % m_window;
+    if (m_count < m_window)
+        m_count++;
+    
+    update();
+}
+
+/*
+ * The window is small enough that going over it again per reading is
+ * cheaper than keeping running sums exact. Times are taken from the
+ * oldest reading and in minutes so the slope comes out per minute.
+ */
+void StabilityDetector::update()
+{
+    int oldest = m_count < m_window ? 0 : m_next;
+    double meanTime = 0.0;
+    double meanValue = 0.0;
+    
+    for (int i = 0; i < m_count; i++) {
+        int index = (oldest + i) % m_window;
+        meanTime += (m_times[index] - m_times[oldest]) / 60000.0;
+        meanValue += m_values[index];
+    }
+    meanTime /= m_count;
+    meanValue /= m_count;
+    
+    double sxx = 0.0;
+    double sxy = 0.0;
+    double syy = 0.0;
+    for (int i = 0; i < m_count; i++) {
+        int index = (oldest + i) % m_window;
+        double dt = (m_times[index] - m_times[oldest]) / 60000.0 - meanTime;
+        double dv = m_values[index] - meanValue;
+        sxx += dt * dt;
+        sxy += dt * dv;
+        syy += dv * dv;
+    }
+    
+    m_mean = meanValue;
+    m_slope = sxx > 0.0 ? sxy / sxx : 0.0;
+    m_deviation = m_count > 1 ? std::sqrt(syy / (m_count - 1)) : 0.0;
+}
+
+bool StabilityDetector::stable() const
+{
+    return full() && std::fabs(m_slope) <= m_slopeTolerance && m_deviation <= m_deviationTolerance;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STABILITYDETECTOR_H
+#define STABILITYDETECTOR_H
+
+#include <array>
+#include <cstdint>
+
+#define MAX_STABILITY_WINDOW    64
+
+/**
+ * \class StabilityDetector
+ * 
+ * Decides when a probe sitting in a calibration solution has settled.
+ * The last window readings are fit with a least squares line, and the
+ * reading is stable once the slope of that line is under slope units
+ * per minute and the standard deviation of the readings is under
+ * deviation. A probe still drifting toward the solution value fails
+ * the slope test, one still noisy from being moved fails the other.
+ * 
+ * Readings are kept in a fixed ring, add() never allocates. The window
+ * is clamped to MAX_STABILITY_WINDOW and is at least 3.
+ */
+class StabilityDetector
+{
+public:
+    StabilityDetector(int window, double slope, double deviation);
+    
+    void add(int64_t time, double value);
+    void reset();
+    
+    bool stable() const;
+    bool full() const { return m_count == m_window; }
+    double mean() const { return m_mean; }
+    double slope() const { return m_slope; }
+    double deviation() const { return m_deviation; }
+    int window() const { return m_window; }
+    int count() const { return m_count; }
+    
+private:
+    void update();
+    
+    std::array<int64_t, MAX_STABILITY_WINDOW> m_times;
+    std::array<double, MAX_STABILITY_WINDOW> m_values;
+    int m_window;
+    int m_count;
+    int m_next;
+    double m_slopeTolerance;
+    double m_deviationTolerance;
+    double m_mean;
+    double m_slope;
+    double m_deviation;
+};
+
+#endif // STABILITYDETECTOR_H
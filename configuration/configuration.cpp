@@ -24,11 +24,36 @@
  */
 
 #include "configuration.h"
+#include "ds18b20sensor.h"
+#include "adcsensor.h"
+#include "i2clease.h"
+#include "logger.h"
 
-Configuration::Configuration()
+Configuration::Configuration() : m_localPublish("local"), m_aioPublish("aio")
 {
     m_handle = 1;
     m_newTempDeviceFound = false;
+    m_flowRate = nullptr;
+    m_pump = nullptr;
+    m_mqtt = nullptr;
+    m_mqttConnected = false;
+    m_aioConnected = false;
+    m_pumpPin = 0;
+    m_flowRatePin = 0;
+    m_flowRateEnabled = false;
+    m_gpioPortOne = 0;
+    m_gpioPortTwo = 0;
+    m_redLed = 0;
+    m_yellowLed = 0;
+    m_greenLed = 0;
+    m_metricsPort = 0;
+    m_traceEnabled = false;
+    m_traceFile = "/tmp/aquarium-trace.json";
+    m_cycleTrigger = false;
+    m_cycleInterval = ACQUISITION_CYCLE_MS;
+    m_cycleSettle = ACQUISITION_SETTLE_MS;
+    m_i2cLockDir = I2C_LEASE_DIR;
+    m_i2cLockWait = I2C_LEASE_WAIT_MS;
 }
 
 Configuration::~Configuration()
@@ -49,32 +74,32 @@ bool Configuration::updateArray(std::string array, std::map<std::string, std::st
         config.readFile(m_configFile.c_str());
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << "I/O error while reading file." << std::endl;
+        LOGE("I/O error while reading configuration", "path", m_configFile);
         return false;
     }
     catch(const libconfig::ParseException &pex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << "Parse error at " << pex.getFile() << ":" << pex.getLine() << " - " << pex.getError() << std::endl;
+        LOGE("Parse error in configuration", "file", pex.getFile(), "line", pex.getLine(), "error", pex.getError());
         return false;
     }
     
     libconfig::Setting &root = config.getRoot();
     
     if (!root.exists(array)) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Array " << array.c_str() << "does not exist, use addArray()"  << std::endl;
+        LOGE("Array does not exist, use addArray()", "array", array);
         return false;
     }
 
     try {
         libconfig::Setting &arrayEntry = root[array.c_str()];
         for (const auto& [key, value] : entry) {
-            std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Searching for " << key << ":" << value << std::endl;
+            LOGD("Searching array", "device", key, "name", value);
             bool found = false;
             for (int i = 0; i < arrayEntry.getLength(); i++) {
                 const libconfig::Setting &device = arrayEntry[i];
                 std::string serial;
                 std::string name;
                 if (!device.lookupValue("device", serial) || !device.lookupValue("name", name)) {
-                    std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Unable to find device or name in array..." << std::endl;
+                    LOGE("Unable to find device or name in array", "array", array);
                     return false;
                 }
                 
@@ -90,16 +115,16 @@ bool Configuration::updateArray(std::string array, std::map<std::string, std::st
         }
     }
     catch (const libconfig::SettingException &e) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Unable to add elements to the new array: " << e.what() << std::endl;
+        LOGE("Unable to add elements to the new array", "array", array, "error", e.what());
         return false;
     }
     
     try {
         config.writeFile(m_configFile.c_str());
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Updated configuration successfully written to: " << m_configFile << std::endl;
+        LOGI("Updated configuration written", "path", m_configFile);
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": I/O error while writing file: " << m_configFile << std::endl;
+        LOGE("I/O error while writing configuration", "path", m_configFile);
         return false;
     }
     
@@ -119,11 +144,11 @@ bool Configuration::addArray(std::string array, std::map<std::string, std::strin
         config.readFile(m_configFile.c_str());
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": I/O error while reading file." << std::endl;
+        LOGE("I/O error while reading configuration", "path", m_configFile);
         return false;
     }
     catch(const libconfig::ParseException &pex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Parse error at " << pex.getFile() << ":" << pex.getLine() << " - " << pex.getError() << std::endl;
+        LOGE("Parse error in configuration", "file", pex.getFile(), "line", pex.getLine(), "error", pex.getError());
         return false;
     }
     
@@ -137,21 +162,21 @@ bool Configuration::addArray(std::string array, std::map<std::string, std::strin
         libconfig::Setting &arrayEntry = root[array.c_str()];
         for (const auto& [key, value] : entry) {
             libconfig::Setting &device = arrayEntry.add(libconfig::Setting::TypeGroup);
-            std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Adding " << key << ":" << value << std::endl;
+            LOGD("Adding to array", "array", array, "device", key, "name", value);
             device.add("device", libconfig::Setting::TypeString) = key;
             device.add("name", libconfig::Setting::TypeString) = value;
         }
     }
     catch (const libconfig::SettingTypeException &e) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Unable to add elements to the new array: " << e.what() << std::endl;
+        LOGE("Unable to add elements to the new array", "array", array, "error", e.what());
     }
     
     try {
         config.writeFile(m_configFile.c_str());
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Updated configuration successfully written to: " << m_configFile << std::endl;
+        LOGI("Updated configuration written", "path", m_configFile);
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": I/O error while writing file: " << m_configFile << std::endl;
+        LOGE("I/O error while writing configuration", "path", m_configFile);
         return false;
     }
     return true;
@@ -165,11 +190,11 @@ bool Configuration::setValue(std::string key, std::string value)
         config.readFile(m_configFile.c_str());
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": I/O error while reading file." << std::endl;
+        LOGE("I/O error while reading configuration", "path", m_configFile);
         return false;
     }
     catch(const libconfig::ParseException &pex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Parse error at " << pex.getFile() << ":" << pex.getLine() << " - " << pex.getError() << std::endl;
+        LOGE("Parse error in configuration", "file", pex.getFile(), "line", pex.getLine(), "error", pex.getError());
         return false;
     }
     
@@ -184,10 +209,10 @@ bool Configuration::setValue(std::string key, std::string value)
     
     try {
         config.writeFile(m_configFile.c_str());
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Updated configuration successfully written to: " << m_configFile << std::endl;
+        LOGI("Updated configuration written", "path", m_configFile);
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": I/O error while writing file: " << m_configFile << std::endl;
+        LOGE("I/O error while writing configuration", "path", m_configFile);
         return false;
     }
     return true;
@@ -199,22 +224,21 @@ bool Configuration::readConfigFile()
     std::string serial;
     std::string name;
     std::string debug;
+    int level = LOG_WARNING;
     std::map<std::string, std::string> tempDevices;
     bool noDeviceArray = false;
-    
-    m_temp = new Temperature();
-    tempDevices = m_temp->devices();
+    Ds18b20Sensor *bus = nullptr;
 
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__  << ": Staring config file read for " << m_configFile << std::endl;
+    LOGI("Starting config file read", "path", m_configFile);
     try {
         config.readFile(m_configFile.c_str());
     }
     catch(const libconfig::FileIOException &fioex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": I/O error while reading file." << std::endl;
+        LOGE("I/O error while reading configuration", "path", m_configFile);
         return false;
     }
     catch(const libconfig::ParseException &pex) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Parse error at " << pex.getFile() << ":" << pex.getLine() << " - " << pex.getError() << std::endl;
+        LOGE("Parse error in configuration", "file", pex.getFile(), "line", pex.getLine(), "error", pex.getError());
         return false;
     }
 
@@ -228,8 +252,7 @@ bool Configuration::readConfigFile()
             generateLocalId();
         }
         
-        syslog(LOG_INFO, "Using %s as our MQTT identifier", m_localId.c_str());
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Using " << m_localId.c_str() << " as our MQTT identifier"  << std::endl;
+        LOGI("Using MQTT identifier", "id", m_localId);
         
         if (root.exists("enable_adafruitio")) {
             root.lookupValue("enable_adafruitio", m_aioEnabled);
@@ -256,26 +279,22 @@ bool Configuration::readConfigFile()
             }
             else {
                 m_aioEnabled = false;
-                syslog(LOG_ERR, "No AIO username in config, disabling AdafruitIO connection");
-                std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": No AIO username in config, disabling AdafruitIO connection" << std::endl;
+                LOGE("No AIO username in config, disabling AdafruitIO connection");
             }
             if (root.exists("adafruitio_key")) {
                 root.lookupValue("adafruitio_key", m_aioKey);
             }
             else {
                 m_aioEnabled = false;
-                syslog(LOG_ERR, "No AIO key in config, disabling AdafruitIO connection");
-                std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": No AIO key in config, disabling AdafruitIO connection" << std::endl;
+                LOGE("No AIO key in config, disabling AdafruitIO connection");
             }
             
             if (m_aioEnabled) {
-                syslog(LOG_INFO, "Access to AdafruiIO is enabled to %s on port %d for user %s", m_aioServer.c_str(), m_aioPort, m_aioUserName.c_str());
-                std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Access to AdafruiIO is enabled to " << m_aioServer << " on port " << m_aioPort << " for user " << m_aioUserName.c_str() << ":" << m_aioKey.c_str() << std::endl;
+                LOGI("Access to AdafruitIO is enabled", "server", m_aioServer, "port", m_aioPort, "user", m_aioUserName);
             }
         }
         else {
-            syslog(LOG_INFO, "Access to AdafruitIO is disabled");
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Access to AdafruitIO is disabled" << std::endl;
+            LOGI("Access to AdafruitIO is disabled");
         }
         
         if (root.exists("mqtt_port")) {
@@ -295,18 +314,15 @@ bool Configuration::readConfigFile()
             if (root.exists("mqtt_password")) {
                 root.lookupValue("mqtt_password", m_mqttPassword);
             }
-            syslog(LOG_INFO, "MQTT is connecting to %s:%d for user %s", m_mqttServer.c_str(), m_mqttPort, m_mqttUserName.c_str());
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": MQTT is connecting to " << m_mqttServer << ":" << m_mqttPort << " for user " << m_mqttUserName.c_str() << std::endl;
+            LOGI("MQTT is connecting", "server", m_mqttServer, "port", m_mqttPort, "user", m_mqttUserName);
         }
         else {
-            syslog(LOG_INFO, "MQTT is connecting to %s:%d", m_mqttServer.c_str(), m_mqttPort);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": MQTT is connecting to " << m_mqttServer.c_str() << ":" << m_mqttPort << std::endl;
+            LOGI("MQTT is connecting", "server", m_mqttServer, "port", m_mqttPort);
         }
         
         if (root.exists("onewire_pin")) {
             root.lookupValue("onewire_pin", m_onewirepin);
-            syslog(LOG_INFO, "DS18B20 bus on pin %d", m_onewirepin);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": DS18B20 bus on pin " << m_onewirepin << std::endl;
+            LOGI("DS18B20 bus", "pin", m_onewirepin);
         }
         else {
             m_onewirepin = -1;
@@ -332,93 +348,151 @@ bool Configuration::readConfigFile()
             m_greenLed = 25;
         }
         
-        if (root.exists("waterlevel_index")) {
-            root.lookupValue("waterlevel_index", m_adcWaterLevelIndex);
-        }
-        else {
-            m_adcWaterLevelIndex = 0;
-        }
-        
         if (root.exists("gpio_one")) {
             root.lookupValue("gpio_one", m_gpioPortOne);
-            syslog(LOG_INFO, "GPIO Port One toggle set to pin %d", m_gpioPortOne);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": GPIO Toggle set to pin " << m_gpioPortOne << std::endl;
+            LOGI("GPIO port one toggle", "pin", m_gpioPortOne);
         }
         else {
             m_gpioPortOne = 0;
-            syslog(LOG_INFO, "GPIO Port One disabled");
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": GPIO Port One disabled" << std::endl;
+            LOGI("GPIO port one disabled");
         }
 
         if (root.exists("gpio_two")) {
-            root.lookupValue("gpio_one", m_gpioPortTwo);
-            syslog(LOG_INFO, "GPIO Port Two toggle set to pin %d", m_gpioPortTwo);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": GPIO Port Two Toggle set to pin " << m_gpioPortTwo << std::endl;
+            root.lookupValue("gpio_two", m_gpioPortTwo);
+            LOGI("GPIO port two toggle", "pin", m_gpioPortTwo);
         }
         else {
             m_gpioPortTwo = 0;
-            syslog(LOG_INFO, "GPIO Port Two disabled");
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": GPIO Port Two disabled" << std::endl;
+            LOGI("GPIO port two disabled");
         }
 
-        if (root.exists("phsensor_address")) {
-            root.lookupValue("phsensor_address", m_phSensorAddress);
-            syslog(LOG_INFO, "PH device on i2c address %x", m_phSensorAddress);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": PH device on i2c address " << m_phSensorAddress << std::endl;
+        if (root.exists("enable_flowrate")) {
+            root.lookupValue("enable_flowrate", m_flowRateEnabled);
         }
         else {
-            m_phSensorAddress = 0;
-            syslog(LOG_INFO, "PH device disabled");
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": PH device disabled" << std::endl;
+            m_flowRateEnabled = false;
+        }
+        
+        if (m_flowRateEnabled) {
+            double pulsesPerLiter = 450.0;
+            int window = 5000;
+            
+            m_flowRatePin = 0;
+            root.lookupValue("flowrate_pin", m_flowRatePin);
+            root.lookupValue("flowrate_pulses_per_liter", pulsesPerLiter);
+            root.lookupValue("flowrate_window_ms", window);
+            if (m_flowRatePin != 0) {
+                m_flowRate = new FlowRate(pulsesPerLiter, window);
+                LOGI("Flow rate sensor", "pin", m_flowRatePin, "pulses_per_liter", pulsesPerLiter, "window_ms", window);
+            }
+            else {
+                m_flowRateEnabled = false;
+                LOGE("Flow rate enabled but flowrate_pin is not set");
+            }
         }
 
-        if (root.exists("o2sensor_address")) {
-            root.lookupValue("o2sensor_address", m_o2SensorAddress);
-            syslog(LOG_INFO, "Oxygen sensor on i2c address %x", m_o2SensorAddress);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Oxygen sensor on i2c address " << m_o2SensorAddress << std::endl;
+        m_errorJournalSize = 256;
+        m_errorJournalFiles = 4;
+        if (root.exists("error_journal")) {
+            root.lookupValue("error_journal", m_errorJournal);
+            root.lookupValue("error_journal_size_kb", m_errorJournalSize);
+            root.lookupValue("error_journal_files", m_errorJournalFiles);
+            LOGI("Error journal", "path", m_errorJournal, "files", m_errorJournalFiles, "size_kb", m_errorJournalSize);
+        }
+
+        m_metricsPort = 0;
+        m_metricsAddress = "127.0.0.1";
+        root.lookupValue("metrics_port", m_metricsPort);
+        root.lookupValue("metrics_address", m_metricsAddress);
+        root.lookupValue("metrics_socket", m_metricsSocket);
+        root.lookupValue("trace_enabled", m_traceEnabled);
+        root.lookupValue("trace_file", m_traceFile);
+        
+        std::string acquisition;
+        if (root.lookupValue("acquisition", acquisition)) {
+            if (cisCompare(acquisition, "cycle"))
+                m_cycleTrigger = true;
+            else if (cisCompare(acquisition, "interval"))
+                m_cycleTrigger = false;
+            else
+                LOGE("Unknown acquisition mode", "acquisition", acquisition);
+        }
+        root.lookupValue("cycle_ms", m_cycleInterval);
+        root.lookupValue("cycle_settle_ms", m_cycleSettle);
+        SensorRegistry::instance()->setCycleMode(m_cycleTrigger, m_cycleInterval);
+
+        int debounce = 50;
+        if (root.exists("gpio_debounce_ms")) {
+            root.lookupValue("gpio_debounce_ms", debounce);
+        }
+        m_gpioPortOneDebounce = debounce;
+        m_gpioPortTwoDebounce = debounce;
+        if (root.exists("gpio_one_debounce_ms")) {
+            root.lookupValue("gpio_one_debounce_ms", m_gpioPortOneDebounce);
+        }
+        if (root.exists("gpio_two_debounce_ms")) {
+            root.lookupValue("gpio_two_debounce_ms", m_gpioPortTwoDebounce);
+        }
+        LOGI("GPIO debounce windows", "port_one_ms", m_gpioPortOneDebounce, "port_two_ms", m_gpioPortTwoDebounce);
+
+        if (root.exists("gpio_backend")) {
+            root.lookupValue("gpio_backend", m_gpioBackend);
         }
         else {
-            m_o2SensorAddress = 0;
-            syslog(LOG_INFO, "Oxygen sensor disabled");
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Oxygen sensor disabled" << std::endl;
+            m_gpioBackend = "gpiochip";
         }
-        
-        if (root.exists("ecsensor_address")) {
-            root.lookupValue("ecsensor_address", m_ecSensorAddress);
-            syslog(LOG_INFO, "Conductivity sensor on i2c address %x", m_ecSensorAddress);
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Conductivity sensor on i2c address " << m_ecSensorAddress << std::endl;
+
+        if (root.exists("gpio_chip")) {
+            root.lookupValue("gpio_chip", m_gpioChip);
         }
         else {
-            m_ecSensorAddress = 0;
-            syslog(LOG_INFO, "Conductivity sensor disabled");
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Conductivity sensor disabled" << std::endl;
+            m_gpioChip = "/dev/gpiochip0";
+        }
+        LOGI("GPIO backend", "backend", m_gpioBackend, "chip", m_gpioChip);
+
+        // Before any device opens the bus, the leases are taken out as they're created
+        root.lookupValue("i2c_lock_dir", m_i2cLockDir);
+        root.lookupValue("i2c_lock_wait_ms", m_i2cLockWait);
+        I2cLease::setDirectory(m_i2cLockDir);
+        I2cLease::setWait(m_i2cLockWait);
+        LOGI("I2C leases", "dir", m_i2cLockDir, "wait_ms", m_i2cLockWait);
+
+        try {
+            createSensors(root);
+        }
+        catch (libconfig::SettingException &e) {
+            LOGE("Error configuring sensors", "error", e.what());
         }
 
         try {
             if (root.exists("debug")) {
                 root.lookupValue("debug", debug);
-                if (cisCompare(debug, "INFO"))
-                    setlogmask(LOG_UPTO (LOG_INFO));
+                if (cisCompare(debug, "DEBUG"))
+                    level = LOG_DEBUG;
+                else if (cisCompare(debug, "INFO"))
+                    level = LOG_INFO;
                 else if (cisCompare(debug, "WARNING"))
-                    setlogmask(LOG_UPTO (LOG_WARNING));
+                    level = LOG_WARNING;
                 else if (cisCompare(debug, "ERROR"))
-                    setlogmask(LOG_UPTO (LOG_ERR));
-            }
-            else {
-                setlogmask(LOG_UPTO (LOG_WARNING));
+                    level = LOG_ERR;
             }
+            // Filter before the record is queued, not just when syslog gets it
+            setlogmask(LOG_UPTO (level));
+            Logger::setLevel(level);
         }
         catch (libconfig::SettingException &e) {
-            syslog(LOG_ERR, "Error configuring logging: : %s", e.what());
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Error configuring logging: " << e.what() << std::endl;
+            LOGE("Error configuring logging", "error", e.what());
         }
         
+        bus = SensorRegistry::instance()->first<Ds18b20Sensor>();
+        if (bus)
+            tempDevices = bus->temperature()->devices();
+        
         try {
-            if (root.exists("ds18b20")) {
+            if (bus && root.exists("ds18b20")) {
                 const libconfig::Setting &probe = root["ds18b20"];
                 if (tempDevices.size() > probe.getLength()) {
-                    syslog(LOG_WARNING, "New DS18B20 device detected, adding to configuration");
-                    std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": New DS18B20 device detected, adding to configuration" << std::endl;                    
+                    LOGW("New DS18B20 device detected, adding to configuration");
                     m_newTempDeviceFound = true;
                 }
                 for (int i = 0; i < probe.getLength(); i++) {
@@ -428,13 +502,12 @@ bool Configuration::readConfigFile()
                     
                     auto found = tempDevices.find(serial);
                     if (found != tempDevices.end()) {
-                        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Renaming DS18B20 device " << serial << " to " << name << std::endl;
-                        m_temp->setNameForDevice(serial, name);
+                        LOGI("Renaming DS18B20 device", "device", serial, "name", name);
+                        bus->temperature()->setNameForDevice(serial, name);
                     }
                     else { // TODO: Figure out how to report this as an error!
                         m_invalidTempDeviceInConfig.push_back(serial);
-                        syslog(LOG_WARNING, "DS18B20 probe %s in config, but not connected...", serial.c_str());
-                        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": DS18B20 probe " << serial << " in config, but not connected..." << std::endl;
+                        LOGW("DS18B20 probe in config, but not connected", "device", serial);
                     }
                 }
             }
@@ -444,14 +517,12 @@ bool Configuration::readConfigFile()
             }
         }
         catch (libconfig::SettingException &e) {
-            syslog(LOG_ERR, "Cannot update ds18b20 array: %s", e.what());
-            std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Cannot update ds18b20 array: " << e.what() << std::endl;
+            LOGE("Cannot update ds18b20 array", "error", e.what());
         }
             
     }
     catch (libconfig::SettingException &e) {
-        syslog(LOG_ERR, "SettingException: %s", e.what());
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": SettingException: " << e.what() << std::endl;
+        LOGE("SettingException", "error", e.what());
     }
 
     if (noDeviceArray)
@@ -460,13 +531,378 @@ bool Configuration::readConfigFile()
     if (m_newTempDeviceFound)
         updateArray("ds18b20", tempDevices);
     
-    m_oxygen = new DissolvedOxygen(1, m_o2SensorAddress);
-    m_ph = new PotentialHydrogen (1, m_phSensorAddress);
-    m_adc = new MCP3008(0);
+    try {
+        createPumpController(root);
+    }
+    catch (libconfig::SettingException &e) {
+        LOGE("Cannot create the pump controller", "error", e.what());
+    }
     
+    return checkPins();
+}
+
+/**
+ * \fn bool Configuration::checkPins()
+ * 
+ * A GPIO can only have one owner, a second watch on a pin replaces the
+ * first. Two overflow switches on one pin would leave one of them
+ * unwatched, so a config that reuses a pin is refused. 0 is unused.
+ */
+bool Configuration::checkPins()
+{
+    std::map<int, std::string> used;
+    std::vector<std::pair<std::string, int>> pins = {
+        { "gpio_one", m_gpioPortOne },
+        { "gpio_two", m_gpioPortTwo },
+        { "pump_pin", m_pumpPin },
+        { "flowrate_pin", m_flowRateEnabled ? m_flowRatePin : 0 },
+        { "red_led", m_redLed },
+        { "yellow_led", m_yellowLed },
+        { "green_led", m_greenLed }
+    };
+    
+    for (auto &pin : pins) {
+        if (pin.second == 0)
+            continue;
+        
+        auto found = used.find(pin.second);
+        if (found != used.end()) {
+            LOGE("GPIO pin is configured twice", "pin", pin.second, "first", found->second, "second", pin.first);
+            return false;
+        }
+        used[pin.second] = pin.first;
+    }
     return true;
 }
 
+/**
+ * \fn void Configuration::createPumpController(const libconfig::Setting &root)
+ * 
+ * The pump is only driven when enable_pump is set. The low water interlock
+ * uses the mcp3008 sensor named by pump_level_sensor, waterlevel unless
+ * set, and is off while pump_min_level is 0.
+ * The flow stall interlock needs the flow rate sensor and is off while
+ * pump_flow_stall_ms is 0.
+ */
+void Configuration::createPumpController(const libconfig::Setting &root)
+{
+    bool enabled = false;
+    int priority = 80;
+    int period = 50;
+    int minLevel = 0;
+    int hysteresis = 20;
+    int stall = 0;
+    std::string levelSensor = "waterlevel";
+    
+    root.lookupValue("enable_pump", enabled);
+    if (!enabled)
+        return;
+    
+    m_pumpPin = 0;
+    root.lookupValue("pump_pin", m_pumpPin);
+    if (m_pumpPin == 0) {
+        LOGE("Pump enabled but pump_pin is not set");
+        return;
+    }
+    
+    root.lookupValue("pump_priority", priority);
+    root.lookupValue("pump_period_ms", period);
+    root.lookupValue("pump_min_level", minLevel);
+    root.lookupValue("pump_level_hysteresis", hysteresis);
+    root.lookupValue("pump_flow_stall_ms", stall);
+    root.lookupValue("pump_level_sensor", levelSensor);
+    
+    m_pump = new PumpController(m_pumpPin, priority, period);
+    if (minLevel > 0) {
+        AdcSensor *level = dynamic_cast<AdcSensor*>(SensorRegistry::instance()->find(levelSensor));
+        if (level)
+            m_pump->setLevelSource([level]() { return level->reading(); }, minLevel, hysteresis);
+        else
+            LOGE("Pump low level interlock needs an mcp3008 sensor", "sensor", levelSensor);
+    }
+    if (stall > 0 && m_flowRate) {
+        m_pump->setFlowSource([this]() { return m_flowRate->lastPulse(); }, stall);
+    }
+    LOGI("Pump", "pin", m_pumpPin, "minimum_level", minLevel, "flow_stall_ms", stall);
+}
+
+/**
+ * \fn void Configuration::createSensors(const libconfig::Setting &root)
+ * 
+ * Replaces whatever is in the sensor registry with the tanks and
+ * sensors from the config. Each tank has its own sensors list, topic
+ * and AIO feed, and a bus its sensors use unless they name one. Without
+ * a tanks list there is one tank using the top level sensors list, or
+ * the old single probe keys if there isn't one either. Filters and
+ * detectors are matched to a sensor by name from the filters and
+ * anomaly groups.
+ * 
+ * tanks = ( { name = "reef"; topic = "aquarium2/reef"; feed = "pbuelow/feeds/reef"; bus = 3;
+ *             level = "reef_level"; sensors = ( ... ); } );
+ * sensors = ( { type = "ph"; name = "ph"; label = "pH"; bus = 1; address = 0x63; interval_ms = 10000;
+ *               stale_ms = 120000; } );
+ */
+void Configuration::createSensors(const libconfig::Setting &root)
+{
+    std::vector<SensorConfig> configs;
+    
+    SensorRegistry::instance()->clear();
+    
+    if (root.exists("tanks")) {
+        const libconfig::Setting &list = root["tanks"];
+        for (int i = 0; i < list.getLength(); i++) {
+            const libconfig::Setting &entry = list[i];
+            TankConfig tank;
+            
+            if (!entry.lookupValue("name", tank.name)) {
+                LOGE("Tank entry needs a name", "index", i);
+                continue;
+            }
+            tank.topic = "aquarium2/" + tank.name;
+            tank.feed = "pbuelow/feeds/" + tank.name;
+            entry.lookupValue("topic", tank.topic);
+            entry.lookupValue("feed", tank.feed);
+            entry.lookupValue("level", tank.level);
+            entry.lookupValue("bus", tank.bus);
+            readCompensation(entry, tank.compensation, tank.perReadCompensation);
+            SensorRegistry::instance()->addTank(tank);
+            
+            if (entry.exists("sensors"))
+                readSensors(entry["sensors"], tank, configs);
+        }
+    }
+    else {
+        TankConfig tank;
+        
+        readCompensation(root, tank.compensation, tank.perReadCompensation);
+        SensorRegistry::instance()->addTank(tank);
+        if (root.exists("sensors")) {
+            readSensors(root["sensors"], tank, configs);
+        }
+        else {
+            legacySensors(root, configs);
+            for (auto &config : configs) {
+                config.tank = tank.name;
+                config.compensation = tank.compensation;
+                config.perReadCompensation = tank.perReadCompensation;
+            }
+        }
+    }
+    
+    for (auto &config : configs) {
+        Sensor *sensor = SensorRegistry::instance()->create(config);
+        if (sensor == nullptr)
+            continue;
+        
+        try {
+            if (root.exists("filters") && root["filters"].exists(config.filter))
+                sensor->setFilter(createFilterChain(config.filter, root["filters"][config.filter.c_str()]));
+        }
+        catch (libconfig::SettingException &e) {
+            LOGE("Error configuring probe filters", "sensor", config.name, "error", e.what());
+        }
+        
+        try {
+            if (root.exists("anomaly") && root["anomaly"].exists(config.anomaly))
+                sensor->setDetector(createAnomalyDetector(sensor->name(), root["anomaly"][config.anomaly.c_str()]));
+        }
+        catch (libconfig::SettingException &e) {
+            LOGE("Error configuring anomaly detection", "sensor", config.name, "error", e.what());
+        }
+    }
+}
+
+/*
+ * compensation names the temperature source, compensation_mode is
+ * "read" to send it with every reading or "hourly" for the old push.
+ * Either can be set on a tank or on a single sensor.
+ */
+void Configuration::readCompensation(const libconfig::Setting &setting, std::string &source, bool &perRead)
+{
+    std::string mode;
+    
+    setting.lookupValue("compensation", source);
+    if (setting.lookupValue("compensation_mode", mode)) {
+        if (cisCompare(mode, "read"))
+            perRead = true;
+        else if (cisCompare(mode, "hourly"))
+            perRead = false;
+        else
+            LOGE("Unknown compensation mode", "mode", mode);
+    }
+}
+
+/*
+ * Entries of one tank's sensors list. bus and the compensation settings
+ * default to the tank's.
+ */
+void Configuration::readSensors(const libconfig::Setting &list, const TankConfig &tank, std::vector<SensorConfig> &configs)
+{
+    for (int i = 0; i < list.getLength(); i++) {
+        const libconfig::Setting &entry = list[i];
+        SensorConfig config;
+        
+        if (!entry.lookupValue("type", config.type) || !entry.lookupValue("name", config.name)) {
+            LOGE("Sensor entry needs a type and a name", "tank", tank.name, "index", i);
+            continue;
+        }
+        config.tank = tank.name;
+        config.bus = tank.bus;
+        config.compensation = tank.compensation;
+        config.perReadCompensation = tank.perReadCompensation;
+        config.filter = config.name;
+        config.anomaly = config.name;
+        entry.lookupValue("label", config.label);
+        entry.lookupValue("bus", config.bus);
+        entry.lookupValue("address", config.address);
+        entry.lookupValue("channel", config.channel);
+        entry.lookupValue("mux", config.mux);
+        entry.lookupValue("mux_channel", config.muxChannel);
+        entry.lookupValue("interval_ms", config.interval);
+        entry.lookupValue("stale_ms", config.staleMs);
+        entry.lookupValue("filter", config.filter);
+        entry.lookupValue("anomaly", config.anomaly);
+        readCompensation(entry, config.compensation, config.perReadCompensation);
+        if (entry.exists("probes")) {
+            const libconfig::Setting &probes = entry["probes"];
+            for (int j = 0; j < probes.getLength(); j++)
+                config.probes.push_back(probes[j].c_str());
+        }
+        configs.push_back(config);
+    }
+}
+
+/*
+ * The keys from before the sensors list, one pH, one DO and one EC on
+ * bus 1, the water level channel and the 1-wire bus. Names and labels
+ * match what the daemon has always published and logged.
+ */
+void Configuration::legacySensors(const libconfig::Setting &root, std::vector<SensorConfig> &configs)
+{
+    SensorConfig config;
+    int address = 0;
+    
+    if (root.lookupValue("phsensor_address", address) && address != 0) {
+        config = SensorConfig();
+        config.type = "ph";
+        config.name = config.filter = config.anomaly = "ph";
+        config.label = "pH";
+        config.address = address;
+        configs.push_back(config);
+    }
+    else {
+        LOGI("PH device disabled");
+    }
+    
+    address = 0;
+    if (root.lookupValue("o2sensor_address", address) && address != 0) {
+        config = SensorConfig();
+        config.type = "do";
+        config.name = "dissolvedoxygen";
+        config.label = "DO";
+        config.filter = config.anomaly = "oxygen";
+        config.address = address;
+        configs.push_back(config);
+    }
+    else {
+        LOGI("Oxygen sensor disabled");
+    }
+    
+    address = 0;
+    if (root.lookupValue("ecsensor_address", address) && address != 0) {
+        config = SensorConfig();
+        config.type = "ec";
+        config.name = config.filter = config.anomaly = "conductivity";
+        config.label = "EC";
+        config.address = address;
+        configs.push_back(config);
+    }
+    else {
+        LOGI("Conductivity sensor disabled");
+    }
+    
+    config = SensorConfig();
+    config.type = "ds18b20";
+    config.name = config.filter = config.anomaly = "temperature";
+    configs.push_back(config);
+    
+    config = SensorConfig();
+    config.type = "mcp3008";
+    config.name = config.filter = config.anomaly = "waterlevel";
+    root.lookupValue("waterlevel_index", config.channel);
+    configs.push_back(config);
+}
+
+/**
+ * \fn FilterChain* Configuration::createFilterChain(std::string name, const libconfig::Setting &setting)
+ * 
+ * Builds the filter pipeline for one probe channel. Stages are always
+ * run median first to knock out spikes, then the Kalman stage, then
+ * the EWMA. Any stage not named in the config is left out.
+ * 
+ * filters = { ph = { median = 5; kalman_q = 0.0001; kalman_r = 0.0025; kalman_tempcoeff = 0.0; ewma = 0.3; }; };
+ */
+FilterChain* Configuration::createFilterChain(std::string name, const libconfig::Setting &setting)
+{
+    FilterChain *chain = new FilterChain(name);
+    int median = 0;
+    double ewma = 0.0;
+    double q = 0.0;
+    double r = 0.0;
+    double tempCoeff = 0.0;
+    
+    if (setting.lookupValue("median", median) && median > 1) {
+        chain->addStage(new MedianFilter(median));
+        LOGI("Probe filter rolling median", "probe", name, "samples", median);
+    }
+    if (setting.lookupValue("kalman_q", q) && setting.lookupValue("kalman_r", r)) {
+        setting.lookupValue("kalman_tempcoeff", tempCoeff);
+        chain->addStage(new KalmanFilter(q, r, tempCoeff));
+        LOGI("Probe filter kalman", "probe", name, "q", q, "r", r, "tempcoeff", tempCoeff);
+    }
+    if (setting.lookupValue("ewma", ewma)) {
+        chain->addStage(new EWMAFilter(ewma));
+        LOGI("Probe filter ewma", "probe", name, "alpha", ewma);
+    }
+    
+    LOGI("Probe filter chain", "probe", name, "stages", chain->stages());
+    return chain;
+}
+
+/**
+ * \fn AnomalyDetector* Configuration::createAnomalyDetector(std::string name, const libconfig::Setting &setting)
+ * 
+ * Rate limits are in units per hour, diurnal limits are in standard
+ * deviations from the normal for that hour of the day.
+ * 
+ * anomaly = { oxygen = { rate_warning = 1.0; rate_critical = 2.0; cusum_k = 0.2; cusum_h = 2.0; diurnal_warning = 3.0; diurnal_critical = 5.0; }; };
+ */
+AnomalyDetector* Configuration::createAnomalyDetector(std::string name, const libconfig::Setting &setting)
+{
+    AnomalyDetector *detector = new AnomalyDetector(name);
+    double warning = 0.0;
+    double critical = 0.0;
+    double k = 0.0;
+    double h = 0.0;
+    
+    if (setting.lookupValue("rate_warning", warning) | setting.lookupValue("rate_critical", critical)) {
+        detector->enableRateOfChange(warning, critical);
+        LOGI("Anomaly rate of change", "probe", name, "warning_per_hour", warning, "critical_per_hour", critical);
+    }
+    if (setting.lookupValue("cusum_k", k) && setting.lookupValue("cusum_h", h)) {
+        detector->enableCusum(k, h);
+        LOGI("Anomaly cusum", "probe", name, "k", k, "h", h);
+    }
+    warning = 0.0;
+    critical = 0.0;
+    if (setting.lookupValue("diurnal_warning", warning) | setting.lookupValue("diurnal_critical", critical)) {
+        detector->enableDiurnal(warning, critical);
+        LOGI("Anomaly diurnal baseline", "probe", name, "warning_sigma", warning, "critical_sigma", critical);
+    }
+    
+    return detector;
+}
+
 /**
  * \func void generateLocalId(struct LocalConfig **lc)
  * \param name Pointer to local configuration structure
@@ -478,8 +914,7 @@ void Configuration::generateLocalId()
 
 	ifs.open("/proc/sys/kernel/hostname");
 	if (!ifs) {
-		syslog(LOG_ERR, "Unable to open /proc/sys/kernel/hostname for reading");
-		std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Unable to open /proc/sys/kernel/hostname for reading" << std::endl;
+		LOGE("Unable to open /proc/sys/kernel/hostname for reading");
 		m_localId = "Aquarium";
 	}
 	m_localId.assign((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
@@ -487,11 +922,10 @@ void Configuration::generateLocalId()
 		m_localId.erase(m_localId.find('\n'));
 	}
 	catch (std::out_of_range &e) {
-		syslog(LOG_ERR, "handled exception: %s", e.what());
-		std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": handled exception: " << e.what() << std::endl;
+		LOGE("handled exception", "error", e.what());
 	}
 
-    syslog(LOG_INFO, "Assigning %s as device name", m_localId.c_str());
+    LOGI("Assigning device name", "id", m_localId);
 }
 
 bool Configuration::cisCompare(const std::string & str1, const std::string &str2)
@@ -513,7 +947,6 @@ bool Configuration::createLocalConnection()
     server += m_mqttServer;
     server += ":";
     server += std::to_string(m_mqttPort);
-    std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": " << server << std::endl;
 
     m_mqtt = new mqtt::async_client(server, m_localId);
     m_localCallback.setConnectedCallback(mqttConnected);
@@ -521,11 +954,11 @@ bool Configuration::createLocalConnection()
     m_mqtt->set_callback(m_localCallback);
 
     try {
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Connecting to the Local MQTT server at: " << m_mqtt->get_server_uri() << std::endl << std::flush;
+        LOGI("Connecting to the local MQTT server", "uri", m_mqtt->get_server_uri());
         m_mqtt->connect(connopts);
     }
     catch (const mqtt::exception&) {
-        std::cerr << __PRETTY_FUNCTION__ << ": ERROR: Unable to connect to MQTT server: '" << m_mqtt->get_server_uri() << "'" << std::endl;
+        LOGE("Unable to connect to MQTT server", "uri", m_mqtt->get_server_uri());
         return false;
     }
     return true;
@@ -562,11 +995,11 @@ bool Configuration::createAIOConnection()
     m_aio->set_callback(m_aioCallback);
 
     try {
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << "Connecting to AIO server at " << server << std::endl << std::flush;
+        LOGI("Connecting to AIO server", "uri", server);
         m_aio->connect(*m_aioConnOpts);
     }
     catch (const mqtt::exception&) {
-        std::cerr << __PRETTY_FUNCTION__ << ":" << __LINE__ << "ERROR: Unable to connect to AIO server: '" << m_aioServer << "'" << std::endl;
+        LOGE("Unable to connect to AIO server", "server", m_aioServer);
         return false;
     }
     return true;
@@ -31,18 +31,22 @@
 #include <fstream>
 #include <memory>
 #include <functional>
+#include <map>
+#include <vector>
 
 #include <libconfig.h++>
 #include <syslog.h>
 
 #include <mqtt/async_client.h>
 
-#include "potentialhydrogen.h"
-#include "dissolvedoxygen.h"
 #include "localmqttcallback.h"
 #include "itimer.h"
-#include "temperature.h"
-#include "mcp3008.h"
+#include "sensorregistry.h"
+#include "acquisitioncycle.h"
+#include "filterchain.h"
+#include "anomalydetector.h"
+#include "flowrate.h"
+#include "pumpcontroller.h"
 
 extern void mqttIncomingMessage(std::string topic, std::string message);
 extern void mqttConnectionLost(const std::string &cause);
@@ -81,10 +85,10 @@ public:
     mqtt::ssl_options m_aioSSLOpts;
     callback m_localCallback;
     callback m_aioCallback;
-    DissolvedOxygen *m_oxygen;
-    PotentialHydrogen *m_ph;
-    Temperature *m_temp;
-    MCP3008 *m_adc;
+    publish_listener m_localPublish;
+    publish_listener m_aioPublish;
+    FlowRate *m_flowRate;
+    PumpController *m_pump;
     std::vector<std::string> m_invalidTempDeviceInConfig;
     std::string m_aioServer;
     std::string m_aioUserName;
@@ -94,30 +98,39 @@ public:
     std::string m_mqttPassword;
     std::string m_localId;
     std::string m_mcp3008Device;
-    std::string m_phVersion;
-    std::string m_phVoltage;
-    std::string m_phTempComp;
-    std::string m_o2Version;
-    std::string m_o2Voltage;
-    std::string m_o2TempComp;
     bool m_daemonize;
     bool m_aioConnected;
     bool m_mqttConnected;
     bool m_aioEnabled;
+    bool m_flowRateEnabled;
     bool m_newTempDeviceFound;
-    int m_o2SensorAddress;
-    int m_phSensorAddress;
-    int m_ecSensorAddress;
     int m_onewirepin;
     int m_redLed;
     int m_yellowLed;
     int m_greenLed;
     int m_aioPort;
     int m_flowRatePin;
+    int m_pumpPin;
     int m_mqttPort;
-    int m_adcWaterLevelIndex;
     int m_gpioPortOne;
     int m_gpioPortTwo;
+    int m_gpioPortOneDebounce;
+    int m_gpioPortTwoDebounce;
+    std::string m_gpioBackend;
+    std::string m_errorJournal;
+    int m_errorJournalSize;
+    int m_errorJournalFiles;
+    std::string m_gpioChip;
+    std::string m_metricsAddress;
+    std::string m_metricsSocket;
+    int m_metricsPort;
+    std::string m_traceFile;
+    bool m_traceEnabled;
+    bool m_cycleTrigger;
+    int m_cycleInterval;
+    int m_cycleSettle;
+    std::string m_i2cLockDir;
+    int m_i2cLockWait;
 
 private:
     Configuration();
@@ -126,6 +139,14 @@ private:
     Configuration(Configuration&);
     
     void generateLocalId();
+    void createPumpController(const libconfig::Setting &root);
+    bool checkPins();
+    void createSensors(const libconfig::Setting &root);
+    void readSensors(const libconfig::Setting &list, const TankConfig &tank, std::vector<SensorConfig> &configs);
+    void readCompensation(const libconfig::Setting &setting, std::string &source, bool &perRead);
+    void legacySensors(const libconfig::Setting &root, std::vector<SensorConfig> &configs);
+    FilterChain* createFilterChain(std::string name, const libconfig::Setting &setting);
+    AnomalyDetector* createAnomalyDetector(std::string name, const libconfig::Setting &setting);
     bool cisCompare(const std::string & str1, const std::string &str2);
     
     std::string m_configFile;
@@ -38,6 +38,10 @@
 #include <atomic>
 #include <mqtt/async_client.h>
 
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+
 /**
  * A callback class for use with the main MQTT client.
  */
@@ -46,15 +50,13 @@ class callback : public virtual mqtt::callback
 public:
 	void connection_lost(const std::string& cause) override 
 	{
-		std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Connection lost" << std::endl;
-		if (!cause.empty())
-			std::cout << "\tcause: " << cause << std::endl;
+		LOGW("MQTT connection lost", "cause", cause);
         if (m_disconnectedCallback) {
             try {
                 m_disconnectedCallback(cause);
             }
             catch (std::exception &e) {
-                std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Error using callback: " << e.what();
+                LOGE("MQTT disconnect callback failed", "error", e.what());
             }
         }
 	}
@@ -66,13 +68,13 @@ public:
 	
 	void connected(const std::string &cause) override 
 	{
-        std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Connected" << std::endl;
+        LOGI("MQTT connected");
         if (m_connectedCallback) {
             try {
                 m_connectedCallback();
             }
             catch (std::exception &e) {
-                std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Error using callback: " << e.what();
+                LOGE("MQTT connect callback failed", "error", e.what());
             }
         }
     }
@@ -94,13 +96,11 @@ class action_listener : public virtual mqtt::iaction_listener
 {
 protected:
 	void on_failure(const mqtt::token& tok) override {
-		std::cout << "\tListener failure for token: "
-			<< tok.get_message_id() << std::endl;
+		LOGW("MQTT action failed", "token", tok.get_message_id());
 	}
 
 	void on_success(const mqtt::token& tok) override {
-		std::cout << "\tListener success for token: "
-			<< tok.get_message_id() << std::endl;
+		LOGD("MQTT action succeeded", "token", tok.get_message_id());
 	}
 };
 
@@ -128,4 +128,53 @@ public:
 	bool is_done() const { return done_; }
 };
 
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Times publishes from the call to the broker acknowledging them. The
+ * start time rides along as the token's user context, in microseconds
+ * truncated to 32 bits so it fits a pointer on the Pi. That wraps every
+ * 71 minutes, the unsigned difference is still right for anything
+ * shorter. One listener is shared by every publish on a client. With
+ * tracing on, the wait for the ack is also recorded as a span.
+ */
+class publish_listener : public virtual mqtt::iaction_listener
+{
+public:
+	publish_listener(std::string broker)
+	{
+		std::string labels = "broker=\"" + broker + "\"";
+		m_latency = MetricsRegistry::instance()->histogram("aquarium_mqtt_publish_seconds", "Time from publish to broker acknowledgement", MetricsRegistry::latencyBuckets(), labels);
+		m_failures = MetricsRegistry::instance()->counter("aquarium_mqtt_publish_failures_total", "Publishes the client reported as failed", labels);
+	}
+	
+	static void* context()
+	{
+		return reinterpret_cast<void*>(static_cast<uintptr_t>(now()));
+	}
+
+private:
+	static uint32_t now()
+	{
+		return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void on_failure(const mqtt::token& tok) override {
+		m_failures->inc();
+	}
+
+	void on_success(const mqtt::token& tok) override {
+		uint32_t start = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(tok.get_user_context()));
+		uint32_t elapsed = now() - start;
+		m_latency->observe(elapsed / 1000000.0);
+		if (Tracer::enabled()) {
+			uint64_t end = Tracer::now();
+			Tracer::record("mqtt::ack", end - elapsed * 1000ULL, end);
+		}
+	}
+
+	Histogram *m_latency;
+	Counter *m_failures;
+};
+
 #endif // MQTTCLIENT_H
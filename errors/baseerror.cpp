@@ -24,9 +24,11 @@
  */
 
 #include "baseerror.h"
+#include "logger.h"
 
 BaseError::BaseError()
 {
+    m_mqtt = nullptr;
     m_timeout = 0;
     m_handle = 0;
     m_priority = Priority::FATAL;
@@ -40,3 +42,47 @@ BaseError::BaseError(unsigned int handle, std::string msg, mqtt::async_client *c
 BaseError::~BaseError()
 {
 }
+
+std::string BaseError::type() const
+{
+    switch (m_priority) {
+        case WARNING:
+            return "warning";
+        case CRITICAL:
+            return "critical";
+        default:
+            return "fatal";
+    }
+}
+
+/**
+ * \fn void BaseError::publish(std::string message, unsigned int repeats)
+ * 
+ * Send the error state to its tank's error topic, or aquarium/error if
+ * it wasn't raised for a tank. repeats is how many times the
+ * same error has been raised again since it was first published, it is
+ * only included when non zero. Quietly does nothing if there is no
+ * MQTT client yet.
+ */
+void BaseError::publish(std::string message, unsigned int repeats)
+{
+    mqtt::async_client *client = m_mqtt ? m_mqtt : Configuration::instance()->m_mqtt;
+    nlohmann::json j;
+    
+    if (client == nullptr)
+        return;
+    
+    j["aquarium"]["error"]["type"] = type();
+    j["aquarium"]["error"]["message"] = message;
+    j["aquarium"]["error"]["handle"] = m_handle;
+    j["aquarium"]["error"]["timeout"] = m_timeout;
+    if (repeats)
+        j["aquarium"]["error"]["repeats"] = repeats;
+    
+    try {
+        client->publish(mqtt::make_message(m_topic.empty() ? "aquarium/error" : m_topic, j.dump()));
+    }
+    catch (std::exception &e) {
+        LOGE("Unable to publish error", "handle", m_handle, "error", e.what());
+    }
+}
@@ -46,6 +46,9 @@
  * 
  * Errors are pushed into the queue by the priority level with
  * warning being the lowest priority.
+ * 
+ * A timeout in milliseconds is only recorded here, ErrorHandler expires
+ * the error when it runs out. 0 means it stays until cleared.
  */
 class BaseError
 {
@@ -58,15 +61,18 @@ public:
     
     BaseError();
     BaseError(unsigned int handle, std::string msg, mqtt::async_client *client = nullptr, unsigned int timeout = 0);
-    ~BaseError();
+    virtual ~BaseError();
 
     Priority priority() const { return m_priority; }
     unsigned int handle() const { return m_handle; }
     std::string message() const { return m_message; }
     unsigned int timeout() const { return m_timeout; }
-    int timeRemaining() const { return m_timer.remaining(); }
     mqtt::async_client* client() const { return m_mqtt; }
+    std::string topic() const { return m_topic; }
+    void setTopic(std::string topic) { m_topic = topic; }
     void setCancelCallback(std::function<void(int)> f) { m_callback = f; }
+    std::string type() const;
+    void publish(std::string message, unsigned int repeats = 0);
     
     virtual void cancel() = 0;
     virtual void activate() = 0;
@@ -75,9 +81,9 @@ protected:
     mqtt::async_client *m_mqtt;
     Priority m_priority;
     std::string m_message;
+    std::string m_topic;
     unsigned int m_timeout;
     unsigned int m_handle;
-    ITimer m_timer;
     std::function<void(int)> m_callback;
 };
 
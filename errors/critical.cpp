@@ -24,6 +24,7 @@
  */
 
 #include "critical.h"
+#include "logger.h"
 
 Critical::Critical()
 {
@@ -39,6 +40,7 @@ Critical::Critical(const Critical& ce)
     m_timeout = ce.timeout();
     m_handle = ce.handle();
     m_mqtt = ce.client();
+    m_topic = ce.topic();
 }
 
 Critical::Critical(unsigned int handle, std::string msg, mqtt::async_client *client, unsigned int timeout) : BaseError(handle, msg, client, timeout)
@@ -52,45 +54,19 @@ Critical::~Critical()
 
 void Critical::cancel()
 {
-    mqtt::message_ptr pubmsg;
-    nlohmann::json j;
-    
-    j["aquarium"]["error"]["type"] = "critical";
-    j["aquarium"]["error"]["message"] = "cleared";
-    j["aquarium"]["error"]["handle"] = m_handle;
-    j["aquarium"]["error"]["timeout"] = m_timeout;
-
-    digitalWrite(Configuration::instance()->m_redLed, 0);
-
-    pubmsg = mqtt::make_message("aquarium/error", j.dump());
-    Configuration::instance()->m_mqtt->publish(pubmsg);
+    publish("cleared");
 
     if (m_callback) {
         try {
             m_callback(m_handle);
         }
         catch (std::exception &e) {
-            syslog(LOG_ERR, "%s: Unable to execute function: %s\n", __PRETTY_FUNCTION__, e.what());
+            LOGE("Unable to execute function", "handle", m_handle, "error", e.what());
         }
     }
 }
 
 void Critical::activate()
 {
-    mqtt::message_ptr pubmsg;
-    nlohmann::json j;
-    
-    if (m_timeout >= 0) {
-        m_timer.setTimeout(std::bind(&Critical::cancel, this), m_timeout);
-    }
-    
-    j["aquarium"]["error"]["type"] = "critical";
-    j["aquarium"]["error"]["message"] = m_message;
-    j["aquarium"]["error"]["handle"] = m_handle;
-    j["aquarium"]["error"]["timeout"] = m_timeout;
-    
-    digitalWrite(Configuration::instance()->m_redLed, 1);
-
-    pubmsg = mqtt::make_message("aquarium/error", j.dump());
-    Configuration::instance()->m_mqtt->publish(pubmsg);
+    publish(m_message);
 }
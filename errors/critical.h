@@ -26,7 +26,6 @@
 #ifndef CRITICALERROR_H
 #define CRITICALERROR_H
 
-#include <wiringPi.h>
 #include <mqtt/async_client.h>
 
 #include "baseerror.h"
@@ -1,6 +1,6 @@
 /*
- * Copyright (c) 2020 <copyright holder> <email>
- *
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
  * Permission is hereby granted, free of charge, to any person
  * obtaining a copy of this software and associated documentation
  * files (the "Software"), to deal in the Software without
@@ -9,10 +9,10 @@
  * copies of the Software, and to permit persons to whom the
  * Software is furnished to do so, subject to the following
  * conditions:
- *
+ * 
  * The above copyright notice and this permission notice shall be
  * included in all copies or substantial portions of the Software.
- *
+ * 
  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
  * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
  * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
@@ -33,102 +33,318 @@
  */
 ErrorHandler::ErrorHandler()
 {
-    m_storedErrors = 0;
     m_handle = 100;
+    m_published = 0;
+    m_suppressed = 0;
+    m_journal = nullptr;
+    m_busy = false;
+    m_running = true;
+    for (auto &c : m_counts)
+        c = 0;
+    
+    m_owner = std::thread(&ErrorHandler::run, this);
 }
 
 ErrorHandler::~ErrorHandler()
 {
+    stop();
 }
 
-unsigned int ErrorHandler::critical(std::string msg, mqtt::async_client *client, int timeout, int handle)
+unsigned int ErrorHandler::critical(std::string msg, mqtt::async_client *client, int timeout, int handle, std::string topic)
 {
-    if (handle > 0)
-        m_handle = handle;
-    else
-        m_handle++;
-    
-    Critical err(m_handle, msg, client, timeout);
-    
-    err.activate();
-    
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    m_criticals[m_handle] = err;
-    m_storedErrors++;
-    return m_handle;
+    return raise(BaseError::CRITICAL, msg, client, timeout, handle, topic);
+}
+
+unsigned int ErrorHandler::fatal(std::string msg, mqtt::async_client *client, int handle, std::string topic)
+{
+    return raise(BaseError::FATAL, msg, client, 0, handle, topic);
+}
+
+unsigned int ErrorHandler::warning(std::string msg, mqtt::async_client *client, int timeout, int handle, std::string topic)
+{
+    return raise(BaseError::WARNING, msg, client, timeout, handle, topic);
+}
+
+void ErrorHandler::clearCritical(unsigned int handle)
+{
+    clear(handle);
 }
 
-unsigned int ErrorHandler::fatal(std::string msg, mqtt::async_client *client, int handle)
+void ErrorHandler::clearWarning(unsigned int handle)
+{
+    clear(handle);
+}
+
+/**
+ * \fn unsigned int ErrorHandler::raise(BaseError::Priority priority, std::string msg, mqtt::async_client *client, unsigned int timeout, int handle, std::string topic)
+ * 
+ * Runs on the caller's thread. The handle is decided here so it can be
+ * returned right away, everything else happens on the owner thread.
+ */
+unsigned int ErrorHandler::raise(BaseError::Priority priority, std::string msg, mqtt::async_client *client, unsigned int timeout, int handle, std::string topic)
 {
-    if (handle > 0)
-        m_handle = handle;
-    else
-        m_handle++;
+    std::string key = std::to_string(priority) + ":" + topic + ":" + msg;
+    unsigned int h = 0;
     
-    Fatal err(m_handle, msg, client);
-    err.activate();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_keys.find(key);
+        if (it != m_keys.end()) {
+            h = it->second;
+            m_queue.push_back({REPEAT, priority, h, std::string(), client, timeout, topic});
+        }
+        else {
+            h = (handle > 0) ? handle : ++m_handle;
+            if (m_handleKeys.find(h) != m_handleKeys.end()) {
+                m_queue.push_back({REPEAT, priority, h, std::string(), client, timeout, topic});
+            }
+            else {
+                m_keys[key] = h;
+                m_handleKeys[h] = std::make_pair(priority, key);
+                m_queue.push_back({RAISE, priority, h, msg, client, timeout, topic});
+            }
+        }
+    }
+    m_cv.notify_one();
+    return h;
+}
+
+/**
+ * \fn void ErrorHandler::clear(unsigned int handle)
+ * 
+ * Fatal errors cannot be cleared, so their key stays put and any repeat
+ * keeps landing on the same handle.
+ */
+void ErrorHandler::clear(unsigned int handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_handleKeys.find(handle);
+        if (it == m_handleKeys.end() || it->second.first == BaseError::FATAL)
+            return;
+        
+        m_keys.erase(it->second.second);
+        m_handleKeys.erase(it);
+        m_queue.push_back({CLEAR, BaseError::WARNING, handle, std::string(), nullptr, 0, std::string()});
+    }
+    m_cv.notify_one();
+}
+
+/**
+ * \fn void ErrorHandler::flush()
+ * 
+ * Wait until everything queued so far has been handled.
+ */
+void ErrorHandler::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return (m_queue.empty() && !m_busy) || !m_running; });
+}
+
+/**
+ * \fn void ErrorHandler::stop()
+ * 
+ * Handles whatever is still queued, then stops the owner thread. Call
+ * this before exit, the owner uses Configuration which may be gone by
+ * the time the destructor runs.
+ */
+void ErrorHandler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_cv.notify_one();
     
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    m_fatals[m_handle] = err;
-    m_storedErrors++;
-    return m_handle;
+    if (m_owner.joinable())
+        m_owner.join();
+    m_idle.notify_all();
+}
+
+unsigned int ErrorHandler::active(BaseError::Priority priority)
+{
+    return m_counts[priority];
 }
 
-unsigned int ErrorHandler::warning(std::string msg, mqtt::async_client *client, int timeout, int handle)
+size_t ErrorHandler::queued()
 {
-    if (handle > 0)
-        m_handle = handle;
-    else
-        m_handle++;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+void ErrorHandler::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto ready = [this] { return !m_queue.empty() || !m_running; };
     
-    Warning err(m_handle, msg, client, timeout);
+    while (true) {
+        if (m_deadlines.empty())
+            m_cv.wait(lock, ready);
+        else
+            m_cv.wait_until(lock, m_deadlines.top().first, ready);
+        
+        if (m_queue.empty() && !m_running)
+            break;
+        
+        std::deque<Request> batch;
+        batch.swap(m_queue);
+        m_busy = true;
+        lock.unlock();
+        
+        for (auto &request : batch)
+            process(request);
+        expire();
+        setLeds();
+        
+        lock.lock();
+        m_busy = false;
+        if (m_queue.empty())
+            m_idle.notify_all();
+    }
+}
+
+void ErrorHandler::process(Request &request)
+{
+    switch (request.type) {
+        case RAISE:
+            {
+                if (m_errors.find(request.handle) != m_errors.end()) {
+                    repeat(request.handle);
+                    return;
+                }
+                
+                Entry &entry = m_errors[request.handle];
+                auto now = std::chrono::steady_clock::now();
+                
+                if (request.priority == BaseError::CRITICAL)
+                    entry.error.reset(new Critical(request.handle, request.message, request.client, request.timeout));
+                else if (request.priority == BaseError::WARNING)
+                    entry.error.reset(new Warning(request.handle, request.message, request.client, request.timeout));
+                else
+                    entry.error.reset(new Fatal(request.handle, request.message, request.client));
+                entry.error->setTopic(request.topic);
+                
+                entry.raised = now;
+                entry.repeats = 0;
+                entry.backoff = ERROR_BACKOFF_MIN;
+                entry.next = now + std::chrono::milliseconds(ERROR_BACKOFF_MIN);
+                if (request.priority != BaseError::FATAL && request.timeout > 0) {
+                    entry.deadline = now + std::chrono::milliseconds(request.timeout);
+                    m_deadlines.push(std::make_pair(entry.deadline, request.handle));
+                }
+                
+                entry.error->activate();
+                m_counts[request.priority]++;
+                m_published++;
+                if (ErrorJournal *journal = m_journal)
+                    journal->append(ErrorJournal::RAISE, request.priority, request.handle, 0, 0, request.message);
+            }
+            break;
+        case REPEAT:
+            repeat(request.handle);
+            break;
+        case CLEAR:
+            remove(request.handle);
+            break;
+    }
+}
+
+/**
+ * \fn void ErrorHandler::remove(unsigned int handle, bool expired)
+ * 
+ * Publish the clear and drop the error. Any heap entry for it is left
+ * behind and skipped when it comes up.
+ */
+void ErrorHandler::remove(unsigned int handle, bool expired)
+{
+    auto it = m_errors.find(handle);
+    if (it == m_errors.end() || it->second.error->priority() == BaseError::FATAL)
+        return;
     
-    err.activate();
+    if (ErrorJournal *journal = m_journal) {
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - it->second.raised).count();
+        journal->append(expired ? ErrorJournal::EXPIRE : ErrorJournal::CLEAR, it->second.error->priority(), handle, duration, it->second.repeats, it->second.error->message());
+    }
     
-    digitalWrite(Configuration::instance()->m_greenLed, 0);
-    m_warnings[m_handle] = err;
-    m_storedErrors++;
-    return m_handle;
+    it->second.error->cancel();
+    m_counts[it->second.error->priority()]--;
+    m_errors.erase(it);
 }
 
-void ErrorHandler::clearCritical(unsigned int handle)
+/**
+ * \fn void ErrorHandler::expire()
+ * 
+ * Time out everything whose deadline has passed. An entry whose error
+ * was cleared, or whose deadline was pushed out by a repeat, is either
+ * dropped or put back with the new time, so each error has at most one
+ * live entry on the heap.
+ */
+void ErrorHandler::expire()
 {
-    auto search = m_criticals.find(handle);
-    if (search != m_criticals.end()) {
-        Critical err = search->second;
-        err.cancel();
-        m_criticals.erase(search);
-        m_storedErrors--;
-    }
+    auto now = std::chrono::steady_clock::now();
     
-    if (m_criticals.size() == 0) {
-        if (m_warnings.size()) {
-            auto it = m_warnings.begin();
-            Warning err = it->second;
-            err.activate();
+    while (!m_deadlines.empty() && m_deadlines.top().first <= now) {
+        Deadline top = m_deadlines.top();
+        m_deadlines.pop();
+        
+        auto it = m_errors.find(top.second);
+        if (it == m_errors.end() || it->second.deadline != top.first) {
+            if (it != m_errors.end() && it->second.deadline > top.first)
+                m_deadlines.push(std::make_pair(it->second.deadline, top.second));
+            continue;
         }
-    }
-    else {
-        auto it = m_criticals.begin();
-        Critical err = it->second;
-        err.activate();
-    }
-    if (m_storedErrors == 0) {
-        digitalWrite(Configuration::instance()->m_greenLed, 1);
+        
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto key = m_handleKeys.find(top.second);
+            if (key != m_handleKeys.end()) {
+                m_keys.erase(key->second.second);
+                m_handleKeys.erase(key);
+            }
+        }
+        remove(top.second, true);
     }
 }
 
-void ErrorHandler::clearWarning(unsigned int handle)
+/**
+ * \fn void ErrorHandler::repeat(unsigned int handle)
+ * 
+ * Count the repeat and only republish it once the backoff has run out,
+ * so a flapping probe can't flood the broker.
+ */
+void ErrorHandler::repeat(unsigned int handle)
 {
-    auto search = m_warnings.find(handle);
-    if (search != m_warnings.end()) {
-        Warning err = search->second;
-        err.cancel();
-        m_warnings.erase(search);
-        m_storedErrors--;
-    }
-    if (m_storedErrors == 0) {
-        digitalWrite(Configuration::instance()->m_greenLed, 1);
+    auto it = m_errors.find(handle);
+    if (it == m_errors.end())
+        return;
+    
+    Entry &entry = it->second;
+    auto now = std::chrono::steady_clock::now();
+    
+    entry.repeats++;
+    if (entry.error->timeout() > 0 && entry.error->priority() != BaseError::FATAL)
+        entry.deadline = now + std::chrono::milliseconds(entry.error->timeout());
+    
+    if (now < entry.next) {
+        m_suppressed++;
+        return;
     }
+    
+    entry.error->publish(entry.error->message(), entry.repeats);
+    m_published++;
+    entry.next = now + std::chrono::milliseconds(entry.backoff);
+    entry.backoff = std::min(entry.backoff * 2, static_cast<unsigned int>(ERROR_BACKOFF_MAX));
+}
 
+/**
+ * \fn void ErrorHandler::setLeds()
+ * 
+ * Hand the active counts to the LED engine, it works out what to show
+ * and ignores calls that don't change anything.
+ */
+void ErrorHandler::setLeds()
+{
+    LedEngine::instance()->setErrorCounts(m_counts[BaseError::FATAL], m_counts[BaseError::CRITICAL], m_counts[BaseError::WARNING]);
 }
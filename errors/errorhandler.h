@@ -27,15 +27,48 @@
 #define ERRORHANDLER_H
 
 #include <vector>
+#include <map>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mqtt/async_client.h>
 
-#include <wiringPi.h>
-
 #include "configuration.h"
+#include "ledengine.h"
 #include "warning.h"
 #include "critical.h"
 #include "fatal.h"
+#include "errorjournal.h"
+
+#define ERROR_BACKOFF_MIN   1000
+#define ERROR_BACKOFF_MAX   (1000 * 60 * 5)
 
+/**
+ * \class ErrorHandler
+ * 
+ * Errors can be raised and cleared from any thread. The calls only
+ * allocate a handle and queue a request, one owner thread does the
+ * publishing and drives the LEDs, so callers never wait on MQTT.
+ * 
+ * Raising an error with the same priority, topic and message as one
+ * already active returns the existing handle. The topic is where the
+ * error is published, the owning tank's error topic, so the same fault
+ * on two tanks is two errors. The repeat is published again
+ * with a count, but no sooner than the backoff for that error, which
+ * doubles each time up to ERROR_BACKOFF_MAX.
+ * 
+ * Errors are owned by handle and never copied. Timeouts are kept in a
+ * deadline heap the owner thread sleeps on, so any number of timed
+ * errors costs that one thread. A repeat pushes the deadline out.
+ * 
+ * With a journal set, every raise, clear and expiry is appended to it
+ * from the owner thread.
+ */
 class ErrorHandler
 {
 public:
@@ -46,19 +79,77 @@ public:
     ErrorHandler();
     ~ErrorHandler();
     
-    unsigned int fatal(std::string msg, mqtt::async_client *client, int handle = 0);
-    unsigned int critical(std::string msg, mqtt::async_client *client, int timeout, int handle = 0);
-    unsigned int warning(std::string msg, mqtt::async_client *client, int timeout, int handle = 0);
+    unsigned int fatal(std::string msg, mqtt::async_client *client, int handle = 0, std::string topic = std::string());
+    unsigned int critical(std::string msg, mqtt::async_client *client, int timeout, int handle = 0, std::string topic = std::string());
+    unsigned int warning(std::string msg, mqtt::async_client *client, int timeout, int handle = 0, std::string topic = std::string());
     
     void clearCritical(unsigned int handle);
     void clearWarning(unsigned int handle);
+    
+    void setJournal(ErrorJournal *journal) { m_journal = journal; }
+    ErrorJournal* journal() const { return m_journal; }
+    
+    void flush();
+    void stop();
+    unsigned int active(BaseError::Priority priority);
+    unsigned long published() const { return m_published; }
+    unsigned long suppressed() const { return m_suppressed; }
+    size_t queued();
 
 private:
-    std::map<int, Critical> m_criticals;
-    std::map<int, Fatal> m_fatals;
-    std::map<int, Warning> m_warnings;
-    int m_storedErrors;
-    int m_handle;
+    typedef enum REQUESTTYPE:int {
+        RAISE,
+        REPEAT,
+        CLEAR
+    } RequestType;
+    
+    struct Request {
+        RequestType type;
+        BaseError::Priority priority;
+        unsigned int handle;
+        std::string message;
+        mqtt::async_client *client;
+        unsigned int timeout;
+        std::string topic;
+    };
+    
+    struct Entry {
+        std::unique_ptr<BaseError> error;
+        unsigned int repeats;
+        unsigned int backoff;
+        std::chrono::steady_clock::time_point next;
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::time_point raised;
+    };
+    
+    typedef std::pair<std::chrono::steady_clock::time_point, unsigned int> Deadline;
+    
+    unsigned int raise(BaseError::Priority priority, std::string msg, mqtt::async_client *client, unsigned int timeout, int handle, std::string topic);
+    void clear(unsigned int handle);
+    void run();
+    void process(Request &request);
+    void repeat(unsigned int handle);
+    void remove(unsigned int handle, bool expired = false);
+    void expire();
+    void setLeds();
+    
+    std::map<unsigned int, Entry> m_errors;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> m_deadlines;
+    std::atomic<unsigned int> m_counts[BaseError::FATAL + 1];
+    std::atomic<ErrorJournal*> m_journal;
+    
+    std::map<std::string, unsigned int> m_keys;
+    std::map<unsigned int, std::pair<BaseError::Priority, std::string>> m_handleKeys;
+    std::deque<Request> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_idle;
+    std::thread m_owner;
+    bool m_running;
+    bool m_busy;
+    std::atomic<unsigned int> m_handle;
+    std::atomic<unsigned long> m_published;
+    std::atomic<unsigned long> m_suppressed;
 };
 
 #endif // ERRORHANDLER_H
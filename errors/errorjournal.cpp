@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <deque>
+
+#include <unistd.h>
+#include <errno.h>
+
+#include "errorjournal.h"
+#include "logger.h"
+
+#define RECORD_FIXED_SIZE   28
+
+ErrorJournal::ErrorJournal(std::string path, size_t maxBytes, int files) : m_path(path), m_maxBytes(maxBytes), m_files(files)
+{
+    m_file = nullptr;
+    m_size = 0;
+    m_head = 0;
+    m_tail = 0;
+    m_dropped = 0;
+    m_running = false;
+    
+    if (m_files < 1)
+        m_files = 1;
+}
+
+ErrorJournal::~ErrorJournal()
+{
+    stop();
+}
+
+std::string ErrorJournal::eventName(Event event)
+{
+    switch (event) {
+        case RAISE:
+            return "raise";
+        case CLEAR:
+            return "clear";
+        case EXPIRE:
+            return "expire";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * \fn bool ErrorJournal::open()
+ * 
+ * Open the journal for append, writing the header if it's new. Must be
+ * called with m_fileMutex held.
+ */
+bool ErrorJournal::open()
+{
+    uint32_t header[2] = { ERROR_JOURNAL_MAGIC, ERROR_JOURNAL_VERSION };
+    
+    if ((m_file = fopen(m_path.c_str(), "ab")) == nullptr) {
+        LOGE("Unable to open error journal", "path", m_path, "error", strerror(errno));
+        return false;
+    }
+    
+    fseek(m_file, 0, SEEK_END);
+    m_size = ftell(m_file);
+    if (m_size == 0) {
+        fwrite(header, sizeof(header), 1, m_file);
+        m_size = sizeof(header);
+    }
+    return true;
+}
+
+/**
+ * \fn void ErrorJournal::rotate()
+ * 
+ * Shift journal.N-1 to journal.N and so on down to the live file, the
+ * oldest falls off the end. Must be called with m_fileMutex held.
+ */
+void ErrorJournal::rotate()
+{
+    fclose(m_file);
+    m_file = nullptr;
+    
+    for (int i = m_files - 1; i > 0; i--) {
+        std::string from = (i == 1) ? m_path : m_path + "." + std::to_string(i - 1);
+        std::string to = m_path + "." + std::to_string(i);
+        rename(from.c_str(), to.c_str());
+    }
+    if (m_files == 1)
+        unlink(m_path.c_str());
+    
+    open();
+}
+
+bool ErrorJournal::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_fileMutex);
+        if (m_file == nullptr && !open())
+            return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (m_running)
+        return true;
+    
+    m_running = true;
+    m_writer = std::thread(&ErrorJournal::run, this);
+    return true;
+}
+
+/**
+ * \fn void ErrorJournal::stop()
+ * 
+ * Writes out anything still queued and closes the file.
+ */
+void ErrorJournal::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_cv.notify_one();
+    
+    if (m_writer.joinable())
+        m_writer.join();
+    
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+/**
+ * \fn bool ErrorJournal::append(Event event, int priority, unsigned int handle, uint64_t duration, unsigned int repeats, std::string message)
+ * 
+ * Never waits on the disk. Returns false if the event was dropped.
+ */
+bool ErrorJournal::append(Event event, int priority, unsigned int handle, uint64_t duration, unsigned int repeats, std::string message)
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (m_head - m_tail >= ERROR_JOURNAL_QUEUE) {
+            m_dropped++;
+            return false;
+        }
+        
+        Entry &e = m_queue[m_head % ERROR_JOURNAL_QUEUE];
+        e.event = event;
+        e.priority = static_cast<uint8_t>(priority);
+        e.handle = handle;
+        e.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+        e.duration = duration;
+        e.repeats = repeats;
+        e.message = message;
+        m_head++;
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+/**
+ * \fn void ErrorJournal::write(const Entry &entry)
+ * 
+ * Must be called with m_fileMutex held.
+ */
+void ErrorJournal::write(const Entry &entry)
+{
+    uint8_t buffer[RECORD_FIXED_SIZE];
+    uint16_t length = RECORD_FIXED_SIZE + entry.message.size();
+    uint16_t reserved = 0;
+    
+    if (entry.message.size() > UINT16_MAX - RECORD_FIXED_SIZE)
+        length = UINT16_MAX;
+    
+    buffer[0] = entry.event;
+    buffer[1] = entry.priority;
+    memcpy(buffer + 2, &reserved, 2);
+    memcpy(buffer + 4, &entry.handle, 4);
+    memcpy(buffer + 8, &entry.timestamp, 8);
+    memcpy(buffer + 16, &entry.duration, 8);
+    memcpy(buffer + 24, &entry.repeats, 4);
+    
+    fwrite(&length, sizeof(length), 1, m_file);
+    fwrite(buffer, RECORD_FIXED_SIZE, 1, m_file);
+    fwrite(entry.message.data(), length - RECORD_FIXED_SIZE, 1, m_file);
+    m_size += sizeof(length) + length;
+}
+
+void ErrorJournal::run()
+{
+    std::vector<Entry> batch;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    
+    while (true) {
+        m_cv.wait(lock, [this] { return m_head != m_tail || !m_running; });
+        if (m_head == m_tail && !m_running)
+            break;
+        
+        batch.clear();
+        while (m_tail != m_head) {
+            batch.push_back(std::move(m_queue[m_tail % ERROR_JOURNAL_QUEUE]));
+            m_tail++;
+        }
+        lock.unlock();
+        
+        {
+            std::lock_guard<std::mutex> file(m_fileMutex);
+            for (auto &entry : batch) {
+                if (m_file == nullptr)
+                    break;
+                write(entry);
+                if (m_size >= m_maxBytes)
+                    rotate();
+            }
+            if (m_file) {
+                fflush(m_file);
+                fdatasync(fileno(m_file));
+            }
+        }
+        
+        lock.lock();
+    }
+}
+
+/**
+ * \fn bool ErrorJournal::readFile(std::string path, std::vector<Entry> &entries, size_t count)
+ * 
+ * Append the records in one journal file to entries, keeping at most
+ * the newest count. A torn record at the end is ignored.
+ */
+bool ErrorJournal::readFile(std::string path, std::vector<Entry> &entries, size_t count)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    uint32_t header[2];
+    uint8_t buffer[RECORD_FIXED_SIZE];
+    uint16_t length;
+    std::deque<Entry> found(entries.begin(), entries.end());
+    
+    if (fp == nullptr)
+        return false;
+    
+    if (fread(header, sizeof(header), 1, fp) != 1 || header[0] != ERROR_JOURNAL_MAGIC) {
+        fclose(fp);
+        return false;
+    }
+    
+    while (fread(&length, sizeof(length), 1, fp) == 1) {
+        Entry e;
+        
+        if (length < RECORD_FIXED_SIZE || fread(buffer, RECORD_FIXED_SIZE, 1, fp) != 1)
+            break;
+        
+        e.event = static_cast<Event>(buffer[0]);
+        e.priority = buffer[1];
+        memcpy(&e.handle, buffer + 4, 4);
+        memcpy(&e.timestamp, buffer + 8, 8);
+        memcpy(&e.duration, buffer + 16, 8);
+        memcpy(&e.repeats, buffer + 24, 4);
+        e.message.resize(length - RECORD_FIXED_SIZE);
+        if (e.message.size() && fread(&e.message[0], e.message.size(), 1, fp) != 1)
+            break;
+        
+        found.push_back(e);
+        if (found.size() > count)
+            found.pop_front();
+    }
+    fclose(fp);
+    
+    entries.assign(found.begin(), found.end());
+    return true;
+}
+
+size_t ErrorJournal::queued()
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_head - m_tail;
+}
+
+/**
+ * \fn std::vector<ErrorJournal::Entry> ErrorJournal::recent(size_t count)
+ * 
+ * The newest count events across the live and rotated files, oldest
+ * first. Only what the writer has already flushed is seen.
+ */
+std::vector<ErrorJournal::Entry> ErrorJournal::recent(size_t count)
+{
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    std::vector<Entry> entries;
+    
+    for (int i = m_files - 1; i > 0; i--)
+        readFile(m_path + "." + std::to_string(i), entries, count);
+    readFile(m_path, entries, count);
+    
+    return entries;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ERRORJOURNAL_H
+#define ERRORJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+#define ERROR_JOURNAL_MAGIC     0x4a455141
+#define ERROR_JOURNAL_VERSION   1
+#define ERROR_JOURNAL_QUEUE     1024
+
+/**
+ * \class ErrorJournal
+ * 
+ * Append only record of error transitions that survives a restart.
+ * append() copies the event into a fixed size queue and returns, a
+ * writer thread does the file I/O. If the writer falls behind the
+ * queue drops events rather than make the caller wait, dropped() says
+ * how many.
+ * 
+ * The file starts with an 8 byte header (magic, version) and then each
+ * record is a u16 length followed by that many bytes: u8 event, u8
+ * priority, u16 reserved, u32 handle, u64 wall clock ns, u64 duration
+ * ms, u32 repeats, then the message. Once the file passes the size
+ * limit it is rotated to .1, .2 and so on, keeping the given number.
+ */
+class ErrorJournal
+{
+public:
+    typedef enum JOURNALEVENT: uint8_t {
+        RAISE = 1,
+        CLEAR = 2,
+        EXPIRE = 3
+    } Event;
+    
+    struct Entry {
+        Event event;
+        uint8_t priority;
+        uint32_t handle;
+        uint64_t timestamp;
+        uint64_t duration;
+        uint32_t repeats;
+        std::string message;
+    };
+    
+    ErrorJournal(std::string path, size_t maxBytes = 256 * 1024, int files = 4);
+    ~ErrorJournal();
+    
+    bool start();
+    void stop();
+    bool append(Event event, int priority, unsigned int handle, uint64_t duration, unsigned int repeats, std::string message);
+    std::vector<Entry> recent(size_t count);
+    unsigned long dropped() const { return m_dropped; }
+    size_t queued();
+    
+    static std::string eventName(Event event);
+    
+private:
+    bool open();
+    void rotate();
+    void write(const Entry &entry);
+    void run();
+    bool readFile(std::string path, std::vector<Entry> &entries, size_t count);
+    
+    std::string m_path;
+    size_t m_maxBytes;
+    int m_files;
+    FILE *m_file;
+    size_t m_size;
+    
+    Entry m_queue[ERROR_JOURNAL_QUEUE];
+    size_t m_head;
+    size_t m_tail;
+    std::atomic<unsigned long> m_dropped;
+    std::mutex m_queueMutex;
+    std::mutex m_fileMutex;
+    std::condition_variable m_cv;
+    std::thread m_writer;
+    bool m_running;
+};
+
+#endif // ERRORJOURNAL_H
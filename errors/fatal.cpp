@@ -39,6 +39,7 @@ Fatal::Fatal(const Fatal& fe)
     m_timeout = 0;
     m_handle = fe.handle();
     m_mqtt = fe.client();
+    m_topic = fe.topic();
 }
 
 Fatal::Fatal(unsigned int handle, std::string msg, mqtt::async_client *client , unsigned int timeout) : BaseError(handle, msg, client, 0)
@@ -69,16 +70,5 @@ void Fatal::cancel()
  */
 void Fatal::activate()
 {
-    mqtt::message_ptr pubmsg;
-    nlohmann::json j;
-    
-    j["aquarium"]["error"]["type"] = "fatal";
-    j["aquarium"]["error"]["message"] = m_message;
-    j["aquarium"]["error"]["handle"] = m_handle;
-    j["aquarium"]["error"]["timeout"] = m_timeout;
-
-    digitalWrite(Configuration::instance()->m_redLed, 1);
-
-    pubmsg = mqtt::make_message("aquarium/error", j.dump());
-    Configuration::instance()->m_mqtt->publish(pubmsg);
+    publish(m_message);
 }
@@ -26,7 +26,6 @@
 #ifndef FATALERROR_H
 #define FATALERROR_H
 
-#include <wiringPi.h>
 #include <mqtt/async_client.h>
 
 #include "baseerror.h"
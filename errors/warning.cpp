@@ -24,6 +24,7 @@
  */
 
 #include "warning.h"
+#include "logger.h"
 
 Warning::Warning()
 {
@@ -39,6 +40,7 @@ Warning::Warning(const Warning& we)
     m_timeout = we.timeout();
     m_handle = we.handle();
     m_mqtt = we.client();
+    m_topic = we.topic();
 }
 
 Warning::Warning(unsigned int handle, std::string msg, mqtt::async_client *client, unsigned int timeout) : BaseError(handle, msg, client, timeout)
@@ -52,43 +54,19 @@ Warning::~Warning()
 
 void Warning::cancel()
 {
-    mqtt::message_ptr pubmsg;
-    nlohmann::json j;
-    
-    j["aquarium"]["error"]["type"] = "warning";
-    j["aquarium"]["error"]["message"] = "cleared";
-    j["aquarium"]["error"]["handle"] = m_handle;
-    j["aquarium"]["error"]["timeout"] = m_timeout;
+    publish("cleared");
 
-    pubmsg = mqtt::make_message("aquarium/error", j.dump());
-    Configuration::instance()->m_mqtt->publish(pubmsg);
-    
     if (m_callback) {
         try {
             m_callback(m_handle);
         }
         catch (std::exception &e) {
-            syslog(LOG_ERR, "%s: Unable to execute function: %s\n", __PRETTY_FUNCTION__, e.what());
+            LOGE("Unable to execute function", "handle", m_handle, "error", e.what());
         }
     }
 }
 
 void Warning::activate()
 {
-    mqtt::message_ptr pubmsg;
-    nlohmann::json j;
-    
-    if (m_timeout >= 0) {
-        m_timer.setTimeout(std::bind(&Warning::cancel, this), m_timeout);
-    }
-    
-    j["aquarium"]["error"]["type"] = "warning";
-    j["aquarium"]["error"]["message"] = m_message;
-    j["aquarium"]["error"]["handle"] = m_handle;
-    j["aquarium"]["error"]["timeout"] = m_timeout;
-
-    digitalWrite(Configuration::instance()->m_yellowLed, 1);
-
-    pubmsg = mqtt::make_message("aquarium/error", j.dump());
-    Configuration::instance()->m_mqtt->publish(pubmsg);
+    publish(m_message);
 }
@@ -26,7 +26,6 @@
 #ifndef WARNINGERROR_H
 #define WARNINGERROR_H
 
-#include <wiringPi.h>
 #include <mqtt/async_client.h>
 
 #include "baseerror.h"
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef WIRINGPI_H
+#define WIRINGPI_H
+
+/*
+ * Just enough of wiringPi for the tree to build and run on a machine
+ * without it, e.g. to run the benchmarks on an x86 box. The top level
+ * CMakeLists.txt only uses this when the real library isn't found.
+ * Setup succeeds and every ADC channel reads 0. Everything is inline
+ * so it doesn't matter where -lwiringPi lands on the link line.
+ */
+
+inline int wiringPiSetupGpio(void) { return 0; }
+inline int piHiPri(const int) { return 0; }
+inline int analogRead(int) { return 0; }
+
+#endif // WIRINGPI_H
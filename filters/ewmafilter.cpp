@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ewmafilter.h"
+
+EWMAFilter::EWMAFilter(double alpha)
+{
+    if (alpha <= 0.0 || alpha > 1.0)
+        alpha = 1.0;
+    
+    m_alpha = alpha;
+    reset();
+}
+
+EWMAFilter::~EWMAFilter()
+{
+}
+
+void EWMAFilter::reset()
+{
+    m_value = 0.0;
+    m_primed = false;
+}
+
+double EWMAFilter::process(double sample, double)
+{
+    if (!m_primed) {
+        m_value = sample;
+        m_primed = true;
+    }
+    else {
+        m_value += m_alpha * (sample - m_value);
+    }
+    return m_value;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EWMAFILTER_H
+#define EWMAFILTER_H
+
+#include "samplefilter.h"
+
+/**
+ * \class EWMAFilter
+ * 
+ * Exponentially weighted moving average. Alpha is the weight given
+ * to the newest sample, 1.0 passes the input straight through.
+ */
+class EWMAFilter : public SampleFilter
+{
+public:
+    EWMAFilter(double alpha);
+    ~EWMAFilter();
+    
+    double process(double sample, double covariate = NAN) override;
+    void reset() override;
+    double alpha() const { return m_alpha; }
+    
+private:
+    double m_alpha;
+    double m_value;
+    bool m_primed;
+};
+
+#endif // EWMAFILTER_H
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "filterchain.h"
+
+FilterChain::FilterChain(std::string name) : m_name(name)
+{
+    m_raw = 0.0;
+    m_filtered = 0.0;
+    m_samples = 0;
+    m_stageCount = 0;
+}
+
+FilterChain::~FilterChain()
+{
+}
+
+/**
+ * \fn bool FilterChain::addStage(SampleFilter *stage)
+ * 
+ * Takes ownership of stage. Returns false and deletes the stage if
+ * the chain is already full.
+ */
+bool FilterChain::addStage(SampleFilter *stage)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (m_stageCount >= MAX_FILTER_STAGES) {
+        delete stage;
+        return false;
+    }
+    
+    m_stages[m_stageCount++].reset(stage);
+    return true;
+}
+
+double FilterChain::process(double sample, double covariate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double value = sample;
+    
+    for (int i = 0; i < m_stageCount; i++) {
+        value = m_stages[i]->process(value, covariate);
+    }
+    
+    m_raw = sample;
+    m_filtered = value;
+    m_samples++;
+    return value;
+}
+
+Sample FilterChain::process(const Sample &sample, double covariate)
+{
+    Sample result = sample;
+    
+    result.value = process(sample.value, covariate);
+    return result;
+}
+
+void FilterChain::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    for (int i = 0; i < m_stageCount; i++) {
+        m_stages[i]->reset();
+    }
+    m_raw = 0.0;
+    m_filtered = 0.0;
+    m_samples = 0;
+}
+
+double FilterChain::raw()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_raw;
+}
+
+double FilterChain::filtered()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_filtered;
+}
+
+unsigned int FilterChain::samples()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_samples;
+}
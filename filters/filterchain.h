@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILTERCHAIN_H
+#define FILTERCHAIN_H
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "samplefilter.h"
+#include "medianfilter.h"
+#include "ewmafilter.h"
+#include "kalmanfilter.h"
+#include "sample.h"
+
+#define MAX_FILTER_STAGES   4
+
+/**
+ * \class FilterChain
+ * 
+ * Per channel filter pipeline. Stages are added once at config time
+ * and then every sample runs through them in the order they were
+ * added. Both the raw and the filtered value of the latest sample are
+ * kept so publishers can report either one.
+ * 
+ * process() may be called from the probe read thread while raw() and
+ * filtered() are called from the publishing timers, so access to the
+ * values is serialized.
+ * 
+ * The Sample overload hands back the same sample with the filtered
+ * value in it. Only good samples belong in here, a parse error or an
+ * out of range value would stay in the stage history for a window.
+ */
+class FilterChain
+{
+public:
+    FilterChain(std::string name);
+    ~FilterChain();
+    
+    bool addStage(SampleFilter *stage);
+    double process(double sample, double covariate = NAN);
+    Sample process(const Sample &sample, double covariate = NAN);
+    void reset();
+    
+    double raw();
+    double filtered();
+    unsigned int samples();
+    int stages() const { return m_stageCount; }
+    std::string name() const { return m_name; }
+    
+private:
+    std::array<std::unique_ptr<SampleFilter>, MAX_FILTER_STAGES> m_stages;
+    std::mutex m_mutex;
+    std::string m_name;
+    double m_raw;
+    double m_filtered;
+    unsigned int m_samples;
+    int m_stageCount;
+};
+
+#endif // FILTERCHAIN_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "kalmanfilter.h"
+
+KalmanFilter::KalmanFilter(double q, double r, double tempCoeff) :
+    m_q(q), m_r(r), m_tempCoeff(tempCoeff)
+{
+    if (m_q <= 0.0)
+        m_q = 1e-5;
+    if (m_r <= 0.0)
+        m_r = 1e-2;
+    
+    reset();
+}
+
+KalmanFilter::~KalmanFilter()
+{
+}
+
+void KalmanFilter::reset()
+{
+    m_estimate = 0.0;
+    m_error = 1.0;
+    m_gain = 0.0;
+    m_lastCovariate = NAN;
+    m_primed = false;
+}
+
+double KalmanFilter::process(double sample, double covariate)
+{
+    if (!m_primed) {
+        m_estimate = sample;
+        m_error = m_r;
+        m_lastCovariate = covariate;
+        m_primed = true;
+        return m_estimate;
+    }
+    
+    // Predict
+    if (!std::isnan(covariate) && !std::isnan(m_lastCovariate))
+        m_estimate += m_tempCoeff * (covariate - m_lastCovariate);
+    if (!std::isnan(covariate))
+        m_lastCovariate = covariate;
+    m_error += m_q;
+    
+    // Update
+    m_gain = m_error / (m_error + m_r);
+    m_estimate += m_gain * (sample - m_estimate);
+    m_error *= (1.0 - m_gain);
+    
+    return m_estimate;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef KALMANFILTER_H
+#define KALMANFILTER_H
+
+#include "samplefilter.h"
+
+/**
+ * \class KalmanFilter
+ * 
+ * Scalar Kalman filter for a slowly moving probe value. The state is
+ * predicted to move by tempCoeff units per degree C of temperature
+ * change since the last sample, which lets the filter follow a real
+ * temperature driven shift without waiting for the measurements to
+ * drag it along.
+ * 
+ * q is the process noise, r is the measurement noise. A larger r
+ * relative to q means the filter trusts the probe less.
+ */
+class KalmanFilter : public SampleFilter
+{
+public:
+    KalmanFilter(double q, double r, double tempCoeff = 0.0);
+    ~KalmanFilter();
+    
+    double process(double sample, double covariate = NAN) override;
+    void reset() override;
+    double gain() const { return m_gain; }
+    
+private:
+    double m_q;
+    double m_r;
+    double m_tempCoeff;
+    double m_estimate;
+    double m_error;
+    double m_gain;
+    double m_lastCovariate;
+    bool m_primed;
+};
+
+#endif // KALMANFILTER_H
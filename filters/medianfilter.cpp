@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "medianfilter.h"
+
+MedianFilter::MedianFilter(int window)
+{
+    if (window < 1)
+        window = 1;
+    if (window > MAX_MEDIAN_WINDOW)
+        window = MAX_MEDIAN_WINDOW;
+    if ((window % 2) == 0)
+        window--;
+    
+    m_window = window;
+    reset();
+}
+
+MedianFilter::~MedianFilter()
+{
+}
+
+void MedianFilter::reset()
+{
+    m_history.fill(0.0);
+    m_sorted.fill(0.0);
+    m_count = 0;
+    m_next = 0;
+}
+
+/**
+ * \fn double MedianFilter::process(double sample, double)
+ * 
+ * m_sorted is kept ordered at all times, so each new sample costs one
+ * removal of the oldest value and one insertion, both O(window).
+ * Until the window fills we return the median of what we have.
+ */
+double MedianFilter::process(double sample, double)
+{
+    int size = m_count;
+    
+    if (m_count == m_window) {
+        double oldest = m_history[m_next];
+        int pos = 0;
+        while (pos < size - 1 && m_sorted[pos] != oldest)
+            pos++;
+        for (int i = pos; i < size - 1; i++)
+            m_sorted[i] = m_sorted[i + 1];
+        size--;
+    }
+    else {
+        m_count++;
+    }
+    
+    int pos = size;
+    while (pos > 0 && m_sorted[pos - 1] > sample) {
+        m_sorted[pos] = m_sorted[pos - 1];
+        pos--;
+    }
+    m_sorted[pos] = sample;
+    
+    m_history[m_next] = sample;
+    m_next = (m_next + 1) % m_window;
+    
+    return m_sorted[m_count / 2];
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MEDIANFILTER_H
+#define MEDIANFILTER_H
+
+#include <array>
+
+#include "samplefilter.h"
+
+#define MAX_MEDIAN_WINDOW   15
+
+/**
+ * \class MedianFilter
+ * 
+ * Rolling median over the last N samples. Used as the first stage
+ * to throw away single sample spikes before anything else sees them.
+ * The window is clamped to MAX_MEDIAN_WINDOW and forced to be odd.
+ */
+class MedianFilter : public SampleFilter
+{
+public:
+    MedianFilter(int window);
+    ~MedianFilter();
+    
+    double process(double sample, double covariate = NAN) override;
+    void reset() override;
+    int window() const { return m_window; }
+    
+private:
+    std::array<double, MAX_MEDIAN_WINDOW> m_history;
+    std::array<double, MAX_MEDIAN_WINDOW> m_sorted;
+    int m_window;
+    int m_count;
+    int m_next;
+};
+
+#endif // MEDIANFILTER_H
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * \struct Sample
+ * 
+ * A value along with when it was acquired and what we think of it.
+ * time is the steady clock in ms of the last good reading, so age() is
+ * how old value is, not how long since the probe was last asked. It's
+ * steady rather than wall time so an NTP step on a Pi without an RTC
+ * can't hide a dead probe or make every sample stale at once, the
+ * published timestamp comes from the frame's wall time instead. The
+ * quality bits describe the latest attempt, a probe that stopped
+ * answering keeps its last value and time and picks up STALE once the
+ * age passes its threshold. Plain data, copying one around never
+ * allocates.
+ * 
+ * FRESH is only set on a good reading, anything else in quality means
+ * the value shouldn't be trusted. CALIBRATING marks a probe sitting in
+ * a calibration solution, its readings aren't the tank's.
+ */
+struct Sample {
+    enum Quality : uint8_t {
+        FRESH = 0x01,
+        STALE = 0x02,
+        PARSE_ERROR = 0x04,
+        OUT_OF_RANGE = 0x08,
+        DISABLED = 0x10,
+        CALIBRATING = 0x20,
+    };
+    
+    double value;
+    double raw;
+    int64_t time;
+    uint8_t quality;
+    
+    Sample() : value(0), raw(0), time(0), quality(0) {}
+    Sample(double v, double r, int64_t t, uint8_t q) : value(v), raw(r), time(t), quality(q) {}
+    
+    bool good() const { return quality == FRESH; }
+    bool has(Quality q) const { return (quality & q) != 0; }
+    int64_t age(int64_t now) const { return time > 0 && now > time ? now - time : 0; }
+    
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    static const char* name(Quality q)
+    {
+        switch (q) {
+            case FRESH: return "fresh";
+            case STALE: return "stale";
+            case PARSE_ERROR: return "parse-error";
+            case OUT_OF_RANGE: return "out-of-range";
+            case DISABLED: return "probe-disabled";
+            case CALIBRATING: return "calibrating";
+        }
+        return "unknown";
+    }
+};
+
+#endif // SAMPLE_H
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SAMPLEFILTER_H
+#define SAMPLEFILTER_H
+
+#include <cmath>
+
+/**
+ * \class SampleFilter
+ * 
+ * A single stage of a probe filter pipeline. Every stage is fed one
+ * sample at a time and must run in constant time and memory, so
+ * nothing in here is allowed to allocate after construction.
+ * 
+ * The covariate is an optional second measurement that a stage may
+ * use to predict the next value, today that is the water temperature.
+ * It is NAN when there is no covariate available.
+ */
+class SampleFilter
+{
+public:
+    SampleFilter() {}
+    virtual ~SampleFilter() {}
+    
+    virtual double process(double sample, double covariate = NAN) = 0;
+    virtual void reset() = 0;
+};
+
+#endif // SAMPLEFILTER_H
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <time.h>
+
+#include "flowrate.h"
+
+FlowRate::FlowRate(double pulsesPerLiter, unsigned int windowms) : m_pulsesPerLiter(pulsesPerLiter)
+{
+    if (m_pulsesPerLiter <= 0)
+        m_pulsesPerLiter = 1;
+    
+    m_window = static_cast<uint64_t>(windowms) * 1000000ULL;
+    m_count = 0;
+}
+
+FlowRate::~FlowRate()
+{
+}
+
+void FlowRate::pulse(uint64_t timestamp)
+{
+    uint64_t count = m_count.load(std::memory_order_relaxed);
+    
+    m_ring[count & (FLOWRATE_RING_SIZE - 1)] = timestamp;
+    m_count.store(count + 1, std::memory_order_release);
+}
+
+/**
+ * \fn double FlowRate::litersPerMinute(uint64_t now)
+ * 
+ * Counts back from the newest pulse until one falls out of the window.
+ * now is CLOCK_MONOTONIC in ns, 0 means read the clock. The walk stops
+ * short of a full ring so the writer can't lap us mid count.
+ */
+double FlowRate::litersPerMinute(uint64_t now)
+{
+    uint64_t count = m_count.load(std::memory_order_acquire);
+    uint64_t limit = (count < FLOWRATE_RING_SIZE / 2) ? count : FLOWRATE_RING_SIZE / 2;
+    uint64_t inWindow = 0;
+    
+    if (now == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+    
+    uint64_t cutoff = (now > m_window) ? now - m_window : 0;
+    while (inWindow < limit) {
+        if (m_ring[(count - inWindow - 1) & (FLOWRATE_RING_SIZE - 1)] <= cutoff)
+            break;
+        inWindow++;
+    }
+    
+    double minutes = static_cast<double>(m_window) / 60000000000.0;
+    return (inWindow / m_pulsesPerLiter) / minutes;
+}
+
+double FlowRate::liters()
+{
+    return m_count.load(std::memory_order_acquire) / m_pulsesPerLiter;
+}
+
+uint64_t FlowRate::pulses()
+{
+    return m_count.load(std::memory_order_acquire);
+}
+
+uint64_t FlowRate::lastPulse()
+{
+    uint64_t count = m_count.load(std::memory_order_acquire);
+    
+    if (count == 0)
+        return 0;
+    return m_ring[(count - 1) & (FLOWRATE_RING_SIZE - 1)];
+}
+
+void FlowRate::reset()
+{
+    m_count.store(0, std::memory_order_release);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FLOWRATE_H
+#define FLOWRATE_H
+
+#include <atomic>
+#include <cstdint>
+
+#define FLOWRATE_RING_SIZE  32768
+
+/**
+ * \class FlowRate
+ * 
+ * Hall effect flow sensor pulse counter. pulse() is called from the
+ * GPIO event thread with the kernel timestamp of each rising edge and
+ * only stores it in a ring, so it keeps up with kHz pulse trains. The
+ * rate is worked out on demand from the pulses inside the sliding
+ * window. There is only ever one writer, readers never block it.
+ * Half the ring must cover the window, 16k pulses is 3 kHz for 5s.
+ */
+class FlowRate
+{
+public:
+    FlowRate(double pulsesPerLiter, unsigned int windowms = 5000);
+    ~FlowRate();
+    
+    void pulse(uint64_t timestamp);
+    double litersPerMinute(uint64_t now = 0);
+    double liters();
+    uint64_t pulses();
+    uint64_t lastPulse();
+    void reset();
+    
+private:
+    uint64_t m_ring[FLOWRATE_RING_SIZE];
+    std::atomic<uint64_t> m_count;
+    double m_pulsesPerLiter;
+    uint64_t m_window;
+};
+
+#endif // FLOWRATE_H
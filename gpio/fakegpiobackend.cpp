@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <time.h>
+
+#include "fakegpiobackend.h"
+
+FakeGpioBackend::FakeGpioBackend()
+{
+}
+
+FakeGpioBackend::~FakeGpioBackend()
+{
+}
+
+bool FakeGpioBackend::setOutput(int pin, int value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lines[pin].value = value ? 1 : 0;
+    return true;
+}
+
+bool FakeGpioBackend::setInput(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lines[pin];
+    return true;
+}
+
+void FakeGpioBackend::write(int pin, int value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Line &line = m_lines[pin];
+    line.value = value ? 1 : 0;
+    line.writes++;
+}
+
+int FakeGpioBackend::read(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_lines.find(pin);
+    
+    if (it != m_lines.end())
+        return it->second.value;
+    return 0;
+}
+
+bool FakeGpioBackend::watch(int pin, Edge edge, std::function<void(GpioEvent)> cbk)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Line &line = m_lines[pin];
+    line.edge = edge;
+    line.callback = cbk;
+    return true;
+}
+
+void FakeGpioBackend::release(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lines.erase(pin);
+}
+
+/**
+ * \fn void FakeGpioBackend::inject(int pin, int value)
+ * 
+ * Only a real change of level counts as an edge, same as hardware.
+ */
+void FakeGpioBackend::inject(int pin, int value)
+{
+    std::function<void(GpioEvent)> cbk;
+    struct timespec ts;
+    GpioEvent event;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Line &line = m_lines[pin];
+        value = value ? 1 : 0;
+        if (line.value == value)
+            return;
+        
+        line.value = value;
+        if ((value && (line.edge & RISING)) || (!value && (line.edge & FALLING)))
+            cbk = line.callback;
+    }
+    
+    if (cbk) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        event.pin = pin;
+        event.value = value;
+        event.timestamp = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+        cbk(event);
+    }
+}
+
+unsigned int FakeGpioBackend::writes(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_lines.find(pin);
+    
+    if (it != m_lines.end())
+        return it->second.writes;
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FAKEGPIOBACKEND_H
+#define FAKEGPIOBACKEND_H
+
+#include <map>
+#include <mutex>
+
+#include "gpiobackend.h"
+
+/**
+ * \class FakeGpioBackend
+ * 
+ * In memory GPIO for running off target and for replay. Outputs just
+ * remember their value, and inject() drives an input the way the
+ * outside world would, calling any watcher from the caller's thread.
+ */
+class FakeGpioBackend : public GpioBackend
+{
+public:
+    FakeGpioBackend();
+    ~FakeGpioBackend();
+    
+    bool setOutput(int pin, int value = 0) override;
+    bool setInput(int pin) override;
+    void write(int pin, int value) override;
+    int read(int pin) override;
+    bool watch(int pin, Edge edge, std::function<void(GpioEvent)> cbk) override;
+    void release(int pin) override;
+    
+    void inject(int pin, int value);
+    unsigned int writes(int pin);
+    
+private:
+    struct Line {
+        int value = 0;
+        unsigned int writes = 0;
+        Edge edge = BOTH;
+        std::function<void(GpioEvent)> callback;
+    };
+    
+    std::map<int, Line> m_lines;
+    std::mutex m_mutex;
+};
+
+#endif // FAKEGPIOBACKEND_H
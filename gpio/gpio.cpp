@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <syslog.h>
+
+#include "gpio.h"
+#include "gpiochipbackend.h"
+#include "fakegpiobackend.h"
+#include "logger.h"
+
+Gpio::Gpio()
+{
+}
+
+Gpio::~Gpio()
+{
+}
+
+/**
+ * \fn GpioBackend* Gpio::createBackend(std::string name, std::string chip)
+ * 
+ * "gpiochip" opens the Linux GPIO character device at chip and "fake"
+ * gets the in memory fake. Anything else, or a chip that can't be
+ * opened, returns nullptr. Quietly running on the fake would leave the
+ * overflow switches unwatched and the pump relay undriven while
+ * everything still looked normal.
+ */
+GpioBackend* Gpio::createBackend(std::string name, std::string chip)
+{
+    if (name == "fake")
+        return new FakeGpioBackend();
+    
+    if (name == "gpiochip") {
+        GpioChipBackend *backend = new GpioChipBackend(chip);
+        if (backend->isOpen())
+            return backend;
+        
+        delete backend;
+        LOGE("Unable to open GPIO chip", "chip", chip);
+        return nullptr;
+    }
+    
+    LOGE("Unknown GPIO backend", "backend", name);
+    return nullptr;
+}
+
+bool Gpio::setOutput(int pin, int value)
+{
+    if (m_backend)
+        return m_backend->setOutput(pin, value);
+    return false;
+}
+
+bool Gpio::setInput(int pin)
+{
+    if (m_backend)
+        return m_backend->setInput(pin);
+    return false;
+}
+
+void Gpio::write(int pin, int value)
+{
+    if (m_backend)
+        m_backend->write(pin, value);
+}
+
+int Gpio::read(int pin)
+{
+    if (m_backend)
+        return m_backend->read(pin);
+    return 0;
+}
+
+bool Gpio::watch(int pin, GpioBackend::Edge edge, std::function<void(GpioEvent)> cbk)
+{
+    if (m_backend)
+        return m_backend->watch(pin, edge, cbk);
+    return false;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <string>
+#include <memory>
+
+#include "gpiobackend.h"
+
+/**
+ * \class Gpio
+ * 
+ * Owns the GPIO backend for the process. Call setBackend() once at
+ * startup, then use the passthroughs below instead of talking to the
+ * hardware directly. Until a backend is set every call is a no-op and
+ * reads return 0, so library code is safe to use off target.
+ */
+class Gpio
+{
+public:
+    static Gpio* instance()
+    {
+        static Gpio instance;
+        return &instance;
+    }
+    
+    static GpioBackend* createBackend(std::string name, std::string chip);
+    
+    void setBackend(GpioBackend *backend) { m_backend.reset(backend); }
+    GpioBackend* backend() { return m_backend.get(); }
+    
+    bool setOutput(int pin, int value = 0);
+    bool setInput(int pin);
+    void write(int pin, int value);
+    int read(int pin);
+    bool watch(int pin, GpioBackend::Edge edge, std::function<void(GpioEvent)> cbk);
+    
+private:
+    Gpio();
+    ~Gpio();
+    Gpio& operator=(Gpio const&) {return *this;}
+    Gpio(Gpio&);
+    
+    std::unique_ptr<GpioBackend> m_backend;
+};
+
+#endif // GPIO_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GPIOBACKEND_H
+#define GPIOBACKEND_H
+
+#include <functional>
+#include <cstdint>
+
+/**
+ * \struct GpioEvent
+ * 
+ * One edge on an input line. The timestamp is in nanoseconds on the
+ * monotonic clock, taken by the kernel when the edge was seen where
+ * the backend supports it.
+ */
+struct GpioEvent {
+    int pin;
+    int value;
+    uint64_t timestamp;
+};
+
+/**
+ * \class GpioBackend
+ * 
+ * Everything the daemon needs from GPIO. Pins are BCM line numbers,
+ * the same numbering wiringPiSetupGpio() used.
+ */
+class GpioBackend
+{
+public:
+    typedef enum EDGETYPE: int {
+        RISING = 1,
+        FALLING = 2,
+        BOTH = 3
+    } Edge;
+    
+    GpioBackend() {}
+    virtual ~GpioBackend() {}
+    
+    virtual bool setOutput(int pin, int value = 0) = 0;
+    virtual bool setInput(int pin) = 0;
+    virtual void write(int pin, int value) = 0;
+    virtual int read(int pin) = 0;
+    virtual bool watch(int pin, Edge edge, std::function<void(GpioEvent)> cbk) = 0;
+    virtual void release(int pin) = 0;
+};
+
+#endif // GPIOBACKEND_H
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "gpiochipbackend.h"
+#include "logger.h"
+
+GpioChipBackend::GpioChipBackend(std::string chip) : m_chip(chip)
+{
+    m_running = false;
+    m_epollfd = -1;
+    m_wakefd = -1;
+    
+    if ((m_chipfd = open(chip.c_str(), O_RDWR | O_CLOEXEC)) < 0) {
+        LOGE("Unable to open GPIO chip", "chip", chip, "error", strerror(errno));
+        return;
+    }
+    
+    m_epollfd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wakefd;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_wakefd, &ev);
+    
+    m_running = true;
+    m_eventThread = std::thread(&GpioChipBackend::eventLoop, this);
+}
+
+GpioChipBackend::~GpioChipBackend()
+{
+    uint64_t one = 1;
+    
+    if (m_running) {
+        m_running = false;
+        if (::write(m_wakefd, &one, sizeof(one)) < 0)
+            LOGE("Unable to wake the GPIO event thread");
+        m_eventThread.join();
+    }
+    
+    for (auto &it : m_lines) {
+        if (it.second.fd >= 0)
+            close(it.second.fd);
+    }
+    
+    if (m_wakefd >= 0)
+        close(m_wakefd);
+    if (m_epollfd >= 0)
+        close(m_epollfd);
+    if (m_chipfd >= 0)
+        close(m_chipfd);
+}
+
+/**
+ * \fn int GpioChipBackend::requestLine(int pin, uint64_t flags, int value)
+ * 
+ * A line can only be requested once, so any existing request for the
+ * pin is dropped first. Must be called with m_mutex held.
+ */
+int GpioChipBackend::requestLine(int pin, uint64_t flags, int value)
+{
+    struct gpio_v2_line_request req;
+    
+    if (m_chipfd < 0)
+        return -1;
+    
+    auto it = m_lines.find(pin);
+    if (it != m_lines.end() && it->second.fd >= 0) {
+        epoll_ctl(m_epollfd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        it->second.fd = -1;
+    }
+    
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = pin;
+    req.num_lines = 1;
+    req.config.flags = flags;
+    if (flags & (GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING))
+        req.event_buffer_size = GPIO_EVENT_BATCH * 4;
+    strncpy(req.consumer, "aquarium", GPIO_MAX_NAME_SIZE - 1);
+    
+    if (flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+        req.config.num_attrs = 1;
+        req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        req.config.attrs[0].attr.values = value ? 1 : 0;
+        req.config.attrs[0].mask = 1;
+    }
+    
+    if (ioctl(m_chipfd, GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+        LOGE("Unable to request GPIO line", "pin", pin, "chip", m_chip, "error", strerror(errno));
+        return -1;
+    }
+    
+    m_lines[pin].fd = req.fd;
+    m_lines[pin].seqno = 0;
+    return req.fd;
+}
+
+bool GpioChipBackend::setOutput(int pin, int value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return requestLine(pin, GPIO_V2_LINE_FLAG_OUTPUT, value) >= 0;
+}
+
+bool GpioChipBackend::setInput(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return requestLine(pin, GPIO_V2_LINE_FLAG_INPUT, 0) >= 0;
+}
+
+void GpioChipBackend::write(int pin, int value)
+{
+    struct gpio_v2_line_values values;
+    int fd = -1;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_lines.find(pin);
+        if (it == m_lines.end() || it->second.fd < 0)
+            fd = requestLine(pin, GPIO_V2_LINE_FLAG_OUTPUT, value);
+        else
+            fd = it->second.fd;
+    }
+    
+    if (fd < 0)
+        return;
+    
+    values.bits = value ? 1 : 0;
+    values.mask = 1;
+    if (ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+        LOGE("Unable to set GPIO line", "pin", pin, "error", strerror(errno));
+}
+
+int GpioChipBackend::read(int pin)
+{
+    struct gpio_v2_line_values values;
+    int fd = -1;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_lines.find(pin);
+        if (it == m_lines.end() || it->second.fd < 0)
+            fd = requestLine(pin, GPIO_V2_LINE_FLAG_INPUT, 0);
+        else
+            fd = it->second.fd;
+    }
+    
+    if (fd < 0)
+        return 0;
+    
+    values.bits = 0;
+    values.mask = 1;
+    if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+        LOGE("Unable to read GPIO line", "pin", pin, "error", strerror(errno));
+        return 0;
+    }
+    return (values.bits & 1) ? 1 : 0;
+}
+
+bool GpioChipBackend::watch(int pin, Edge edge, std::function<void(GpioEvent)> cbk)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t flags = GPIO_V2_LINE_FLAG_INPUT;
+    struct epoll_event ev;
+    
+    if (edge & RISING)
+        flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    if (edge & FALLING)
+        flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    
+    int fd = requestLine(pin, flags, 0);
+    if (fd < 0)
+        return false;
+    
+    m_lines[pin].callback = cbk;
+    
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = (static_cast<uint64_t>(pin) << 32) | static_cast<uint32_t>(fd);
+    if (epoll_ctl(m_epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOGE("Unable to watch GPIO line", "pin", pin, "error", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void GpioChipBackend::release(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_lines.find(pin);
+    
+    if (it != m_lines.end()) {
+        if (it->second.fd >= 0) {
+            epoll_ctl(m_epollfd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+            close(it->second.fd);
+        }
+        m_lines.erase(it);
+    }
+}
+
+/**
+ * \fn void GpioChipBackend::dispatch(int pin, int fd)
+ * 
+ * Drains everything the kernel has queued for the line in one read,
+ * then hands the events to the watcher in order. A gap in the line
+ * sequence numbers means the kernel buffer overflowed and edges were
+ * lost before we got to them.
+ */
+void GpioChipBackend::dispatch(int pin, int fd)
+{
+    struct gpio_v2_line_event events[GPIO_EVENT_BATCH];
+    std::function<void(GpioEvent)> cbk;
+    GpioEvent e;
+    
+    ssize_t bytes = ::read(fd, events, sizeof(events));
+    if (bytes < static_cast<ssize_t>(sizeof(struct gpio_v2_line_event)))
+        return;
+    
+    int count = bytes / sizeof(struct gpio_v2_line_event);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_lines.find(pin);
+        if (it == m_lines.end())
+            return;
+        cbk = it->second.callback;
+        if (it->second.seqno && events[0].line_seqno > it->second.seqno + 1) {
+            LOGW("GPIO line lost edges", "pin", pin, "lost", events[0].line_seqno - it->second.seqno - 1);
+        }
+        it->second.seqno = events[count - 1].line_seqno;
+    }
+    
+    if (!cbk)
+        return;
+    
+    for (int i = 0; i < count; i++) {
+        e.pin = pin;
+        e.value = (events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? 1 : 0;
+        e.timestamp = events[i].timestamp_ns;
+        try {
+            cbk(e);
+        }
+        catch (std::exception &ex) {
+            LOGE("Unable to execute function", "pin", pin, "error", ex.what());
+        }
+    }
+}
+
+void GpioChipBackend::eventLoop()
+{
+    struct epoll_event events[8];
+    
+    while (m_running) {
+        int count = epoll_wait(m_epollfd, events, 8, -1);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            LOGE("GPIO event wait failed", "error", strerror(errno));
+            return;
+        }
+        
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.u64 == static_cast<uint64_t>(m_wakefd))
+                continue;
+            dispatch(static_cast<int>(events[i].data.u64 >> 32), static_cast<int>(events[i].data.u64 & 0xffffffff));
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GPIOCHIPBACKEND_H
+#define GPIOCHIPBACKEND_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include <linux/gpio.h>
+
+#include "gpiobackend.h"
+
+#define GPIO_EVENT_BATCH    16
+
+/**
+ * \class GpioChipBackend
+ * 
+ * GPIO through the Linux character device (/dev/gpiochipN) using the
+ * v2 line request uAPI. Every pin we use is its own line request.
+ * Watched inputs are requested with edge detection and their fds are
+ * serviced by one epoll thread, so edges arrive with the kernel's
+ * monotonic timestamp instead of whenever a userspace ISR thread got
+ * around to calling digitalRead().
+ */
+class GpioChipBackend : public GpioBackend
+{
+public:
+    GpioChipBackend(std::string chip);
+    ~GpioChipBackend();
+    
+    bool isOpen() const { return m_chipfd >= 0; }
+    
+    bool setOutput(int pin, int value = 0) override;
+    bool setInput(int pin) override;
+    void write(int pin, int value) override;
+    int read(int pin) override;
+    bool watch(int pin, Edge edge, std::function<void(GpioEvent)> cbk) override;
+    void release(int pin) override;
+    
+private:
+    struct Line {
+        int fd = -1;
+        uint32_t seqno = 0;
+        std::function<void(GpioEvent)> callback;
+    };
+    
+    int requestLine(int pin, uint64_t flags, int value);
+    void eventLoop();
+    void dispatch(int pin, int fd);
+    
+    std::map<int, Line> m_lines;
+    std::mutex m_mutex;
+    std::thread m_eventThread;
+    std::atomic<bool> m_running;
+    std::string m_chip;
+    int m_chipfd;
+    int m_epollfd;
+    int m_wakefd;
+};
+
+#endif // GPIOCHIPBACKEND_H
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <vector>
+#include <syslog.h>
+#include <time.h>
+
+#include "gpiodebouncer.h"
+#include "logger.h"
+
+GpioDebouncer::GpioDebouncer()
+{
+    m_edges = 0;
+    m_bounces = 0;
+    m_changes = 0;
+    m_lastEdges = 0;
+    m_lastStats = now();
+    m_lastLatency = 0;
+    m_totalLatency = 0;
+    m_maxLatency = 0;
+    m_running = true;
+    m_worker = std::thread(&GpioDebouncer::run, this);
+}
+
+GpioDebouncer::~GpioDebouncer()
+{
+    stop();
+}
+
+uint64_t GpioDebouncer::now()
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * \fn void GpioDebouncer::addPin(int pin, unsigned int windowms, int initial, std::function<void(GpioEvent)> cbk, std::function<void(GpioEvent)> bounced)
+ * 
+ * Start debouncing a pin. initial is the level the pin is known to be
+ * at, changes are reported relative to it.
+ */
+void GpioDebouncer::addPin(int pin, unsigned int windowms, int initial, std::function<void(GpioEvent)> cbk, std::function<void(GpioEvent)> bounced)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Pin &p = m_pins[pin];
+    
+    p.window = static_cast<uint64_t>(windowms) * 1000000ULL;
+    p.firstEdge = 0;
+    p.deadline = 0;
+    p.stable = initial;
+    p.pending = initial;
+    p.settling = false;
+    p.callback = cbk;
+    p.bounced = bounced;
+}
+
+void GpioDebouncer::push(GpioEvent event)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(event);
+    }
+    m_cv.notify_one();
+}
+
+void GpioDebouncer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_cv.notify_one();
+    
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+size_t GpioDebouncer::queued()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+/**
+ * \fn GpioDebouncer::Stats GpioDebouncer::stats()
+ * 
+ * Counters are totals since startup, edgeRate is edges per second
+ * since the previous call. Latencies are in milliseconds.
+ */
+GpioDebouncer::Stats GpioDebouncer::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats s;
+    uint64_t t = now();
+    double elapsed = static_cast<double>(t - m_lastStats) / 1000000000.0;
+    
+    s.edges = m_edges;
+    s.bounces = m_bounces;
+    s.changes = m_changes;
+    s.edgeRate = (elapsed > 0) ? (m_edges - m_lastEdges) / elapsed : 0;
+    s.lastLatency = m_lastLatency;
+    s.averageLatency = m_changes ? m_totalLatency / m_changes : 0;
+    s.maxLatency = m_maxLatency;
+    
+    m_lastEdges = m_edges;
+    m_lastStats = t;
+    return s;
+}
+
+/**
+ * \fn void GpioDebouncer::settle(uint64_t timestamp)
+ * 
+ * Close out any pin whose window has expired. Must be called with
+ * m_mutex held, and will drop it while handlers run.
+ */
+void GpioDebouncer::settle(uint64_t timestamp)
+{
+    std::vector<std::pair<std::function<void(GpioEvent)>, GpioEvent>> changed;
+    std::vector<std::pair<std::function<void(GpioEvent)>, GpioEvent>> bounced;
+    
+    for (auto &it : m_pins) {
+        Pin &p = it.second;
+        if (!p.settling || p.deadline > timestamp)
+            continue;
+        
+        p.settling = false;
+        if (p.pending == p.stable) {
+            m_bounces++;
+            if (p.bounced)
+                bounced.push_back(std::make_pair(p.bounced, GpioEvent{it.first, p.stable, p.firstEdge}));
+            continue;
+        }
+        
+        p.stable = p.pending;
+        m_changes++;
+        if (p.callback)
+            changed.push_back(std::make_pair(p.callback, GpioEvent{it.first, p.stable, p.firstEdge}));
+    }
+    
+    if (changed.empty() && bounced.empty())
+        return;
+    
+    m_mutex.unlock();
+    for (auto &c : changed) {
+        try {
+            c.first(c.second);
+        }
+        catch (std::exception &e) {
+            LOGE("Unable to execute function", "error", e.what());
+        }
+        double latency = static_cast<double>(now() - c.second.timestamp) / 1000000.0;
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_lastLatency = latency;
+        m_totalLatency += latency;
+        if (latency > m_maxLatency)
+            m_maxLatency = latency;
+    }
+    // Not a change, so not counted in the latencies
+    for (auto &c : bounced) {
+        try {
+            c.first(c.second);
+        }
+        catch (std::exception &e) {
+            LOGE("Unable to execute function", "error", e.what());
+        }
+    }
+    m_mutex.lock();
+}
+
+void GpioDebouncer::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    while (m_running) {
+        while (!m_queue.empty()) {
+            GpioEvent event = m_queue.front();
+            m_queue.pop_front();
+            
+            auto it = m_pins.find(event.pin);
+            if (it == m_pins.end())
+                continue;
+            
+            Pin &p = it->second;
+            m_edges++;
+            if (p.settling) {
+                m_bounces++;
+            }
+            else {
+                p.settling = true;
+                p.firstEdge = event.timestamp;
+            }
+            p.pending = event.value;
+            p.deadline = event.timestamp + p.window;
+        }
+        
+        settle(now());
+        
+        uint64_t next = 0;
+        for (auto &it : m_pins) {
+            if (it.second.settling && (next == 0 || it.second.deadline < next))
+                next = it.second.deadline;
+        }
+        
+        if (!m_queue.empty() || !m_running)
+            continue;
+        
+        if (next) {
+            uint64_t t = now();
+            if (next > t)
+                m_cv.wait_for(lock, std::chrono::nanoseconds(next - t));
+        }
+        else {
+            m_cv.wait(lock);
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GPIODEBOUNCER_H
+#define GPIODEBOUNCER_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+#include "gpiobackend.h"
+
+/**
+ * \class GpioDebouncer
+ * 
+ * Software debounce for watched inputs. push() is called from the
+ * backend event thread with raw edges and only queues them. A worker
+ * thread applies each pin's window: a change is reported once the line
+ * has been quiet for the window, using the level of the last edge.
+ * Anything else seen while the line was settling counts as a bounce.
+ * A burst that ends at the level it started from is no change, the
+ * optional bounced handler hears about it with that level, for anyone
+ * who acted on the raw edges and has to undo it.
+ * 
+ * Handlers run on the worker thread, so a slow MQTT publish never
+ * holds up edge capture. Latency is measured from the kernel timestamp
+ * of the first edge in a burst to the handler returning, so it includes
+ * the debounce window.
+ */
+class GpioDebouncer
+{
+public:
+    struct Stats {
+        unsigned long edges;
+        unsigned long bounces;
+        unsigned long changes;
+        double edgeRate;
+        double lastLatency;
+        double averageLatency;
+        double maxLatency;
+    };
+    
+    GpioDebouncer();
+    ~GpioDebouncer();
+    
+    void addPin(int pin, unsigned int windowms, int initial, std::function<void(GpioEvent)> cbk, std::function<void(GpioEvent)> bounced = nullptr);
+    void push(GpioEvent event);
+    void stop();
+    Stats stats();
+    size_t queued();
+    
+    static uint64_t now();
+    
+private:
+    struct Pin {
+        uint64_t window;
+        uint64_t firstEdge;
+        uint64_t deadline;
+        int stable;
+        int pending;
+        bool settling;
+        std::function<void(GpioEvent)> callback;
+        std::function<void(GpioEvent)> bounced;
+    };
+    
+    void run();
+    void settle(uint64_t timestamp);
+    
+    std::map<int, Pin> m_pins;
+    std::deque<GpioEvent> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_worker;
+    bool m_running;
+    
+    unsigned long m_edges;
+    unsigned long m_bounces;
+    unsigned long m_changes;
+    unsigned long m_lastEdges;
+    uint64_t m_lastStats;
+    double m_lastLatency;
+    double m_totalLatency;
+    double m_maxLatency;
+};
+
+#endif // GPIODEBOUNCER_H
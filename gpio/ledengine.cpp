@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gpio.h"
+#include "ledengine.h"
+
+/*
+ * What each condition looks like, in red, yellow, green order.
+ */
+const LedEngine::Display LedEngine::s_displays[CONDITIONS] = {
+    { OFF, OFF, ON },       // NORMAL
+    { OFF, SLOW, ON },      // STALE
+    { OFF, ON, OFF },       // WARNING
+    { ON, OFF, OFF },       // CRITICAL
+    { FAST, OFF, OFF },     // FATAL
+    { ON, OFF, OFF }        // SHUTDOWN
+};
+
+LedEngine::LedEngine()
+{
+    m_active = 1 << NORMAL;
+    m_running = false;
+    m_dirty = true;
+    m_changed = std::chrono::steady_clock::now();
+    for (int i = 0; i < 3; i++) {
+        m_pins[i] = 0;
+        m_levels[i] = -1;
+    }
+}
+
+LedEngine::~LedEngine()
+{
+    stop();
+}
+
+void LedEngine::setPins(int red, int yellow, int green)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    m_pins[0] = red;
+    m_pins[1] = yellow;
+    m_pins[2] = green;
+}
+
+void LedEngine::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (m_running)
+        return;
+    
+    for (int i = 0; i < 3; i++) {
+        if (m_pins[i])
+            Gpio::instance()->setOutput(m_pins[i]);
+        m_levels[i] = -1;
+    }
+    m_dirty = true;
+    m_running = true;
+    m_thread = std::thread(&LedEngine::run, this);
+}
+
+/**
+ * \fn void LedEngine::stop()
+ * 
+ * Renders the current condition one last time with blinking frozen
+ * on, so whatever was showing stays visible after the thread is gone.
+ */
+void LedEngine::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_cv.notify_one();
+    
+    if (m_thread.joinable())
+        m_thread.join();
+    
+    const Display &d = s_displays[highest()];
+    Pattern patterns[3] = { d.red, d.yellow, d.green };
+    for (int i = 0; i < 3; i++) {
+        if (m_pins[i])
+            Gpio::instance()->write(m_pins[i], patterns[i] == OFF ? 0 : 1);
+    }
+}
+
+void LedEngine::setCondition(Condition condition, bool active)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        unsigned int previous = m_active;
+        
+        if (active)
+            m_active |= (1 << condition);
+        else if (condition != NORMAL)
+            m_active &= ~(1 << condition);
+        
+        if (m_active == previous)
+            return;
+        
+        m_dirty = true;
+        m_changed = std::chrono::steady_clock::now();
+    }
+    m_cv.notify_one();
+}
+
+/**
+ * \fn void LedEngine::setErrorCounts(unsigned int fatal, unsigned int critical, unsigned int warning)
+ * 
+ * Called by the error handler whenever its active set changes.
+ */
+void LedEngine::setErrorCounts(unsigned int fatal, unsigned int critical, unsigned int warning)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        unsigned int previous = m_active;
+        unsigned int errors = (1 << FATAL) | (1 << CRITICAL) | (1 << WARNING);
+        
+        m_active &= ~errors;
+        if (fatal)
+            m_active |= (1 << FATAL);
+        if (critical)
+            m_active |= (1 << CRITICAL);
+        if (warning)
+            m_active |= (1 << WARNING);
+        
+        if (m_active == previous)
+            return;
+        
+        m_dirty = true;
+        m_changed = std::chrono::steady_clock::now();
+    }
+    m_cv.notify_one();
+}
+
+LedEngine::Condition LedEngine::current()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return highest();
+}
+
+LedEngine::Condition LedEngine::highest() const
+{
+    for (int c = CONDITIONS - 1; c > NORMAL; c--) {
+        if (m_active & (1 << c))
+            return static_cast<Condition>(c);
+    }
+    return NORMAL;
+}
+
+/*
+ * Blinks start in the on half of their cycle, so a new condition shows
+ * straight away.
+ */
+int LedEngine::level(Pattern pattern, long elapsed) const
+{
+    switch (pattern) {
+        case ON:
+            return 1;
+        case SLOW:
+            return ((elapsed / LED_SLOW_BLINK) % 2) ? 0 : 1;
+        case FAST:
+            return ((elapsed / LED_FAST_BLINK) % 2) ? 0 : 1;
+        default:
+            return 0;
+    }
+}
+
+void LedEngine::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    while (m_running) {
+        const Display &d = s_displays[highest()];
+        Pattern patterns[3] = { d.red, d.yellow, d.green };
+        auto now = std::chrono::steady_clock::now();
+        long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_changed).count();
+        long step = 0;
+        
+        m_dirty = false;
+        for (int i = 0; i < 3; i++) {
+            int value = level(patterns[i], elapsed);
+            if (m_pins[i] && value != m_levels[i]) {
+                Gpio::instance()->write(m_pins[i], value);
+                m_levels[i] = value;
+            }
+            if (patterns[i] == FAST)
+                step = LED_FAST_BLINK;
+            else if (patterns[i] == SLOW && step == 0)
+                step = LED_SLOW_BLINK;
+        }
+        
+        if (step) {
+            auto next = m_changed + std::chrono::milliseconds(((elapsed / step) + 1) * step);
+            m_cv.wait_until(lock, next, [this] { return m_dirty || !m_running; });
+        }
+        else {
+            m_cv.wait(lock, [this] { return m_dirty || !m_running; });
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LEDENGINE_H
+#define LEDENGINE_H
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#define LED_SLOW_BLINK      500
+#define LED_FAST_BLINK      125
+
+/**
+ * \class LedEngine
+ * 
+ * Owns the red, yellow and green status LEDs. Code reports conditions,
+ * the engine shows the highest priority one that is active. Blinking
+ * is rendered by one thread that only wakes for the next toggle, or
+ * when a condition changes, and sleeps indefinitely when nothing is
+ * blinking. Nothing else should write the LED lines once it is started.
+ */
+class LedEngine
+{
+public:
+    typedef enum LEDCONDITION: int {
+        NORMAL = 0,
+        STALE,
+        WARNING,
+        CRITICAL,
+        FATAL,
+        SHUTDOWN,
+        CONDITIONS
+    } Condition;
+    
+    typedef enum LEDPATTERN: int {
+        OFF = 0,
+        ON,
+        SLOW,
+        FAST
+    } Pattern;
+    
+    static LedEngine* instance()
+    {
+        static LedEngine instance;
+        return &instance;
+    }
+    
+    void setPins(int red, int yellow, int green);
+    void start();
+    void stop();
+    
+    void setCondition(Condition condition, bool active);
+    void setErrorCounts(unsigned int fatal, unsigned int critical, unsigned int warning);
+    Condition current();
+    
+private:
+    LedEngine();
+    ~LedEngine();
+    LedEngine& operator=(LedEngine const&) {return *this;}
+    LedEngine(LedEngine&);
+    
+    struct Display {
+        Pattern red;
+        Pattern yellow;
+        Pattern green;
+    };
+    
+    void run();
+    Condition highest() const;
+    int level(Pattern pattern, long elapsed) const;
+    
+    static const Display s_displays[CONDITIONS];
+    
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    std::chrono::steady_clock::time_point m_changed;
+    unsigned int m_active;
+    bool m_running;
+    bool m_dirty;
+    int m_pins[3];
+    int m_levels[3];
+};
+
+#endif // LEDENGINE_H
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <cstdarg>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_SYSTEMD
+#define SD_JOURNAL_SUPPRESS_LOCATION
+#include <systemd/sd-journal.h>
+#endif
+
+#include "logger.h"
+
+std::atomic<int> Logger::s_level(LOG_DEBUG);
+std::atomic<bool> Logger::s_console(true);
+
+Logger::Holder::Holder()
+{
+    buffer = nullptr;
+    tid = static_cast<uint32_t>(syscall(SYS_gettid));
+}
+
+Logger::Holder::~Holder()
+{
+    if (buffer)
+        Logger::instance()->release(buffer);
+}
+
+Logger::Logger() : m_dropped(0), m_urgent(false), m_running(false), m_stopped(false)
+{
+}
+
+Logger::~Logger()
+{
+    stop();
+}
+
+Logger::Holder& Logger::holder()
+{
+    thread_local Holder holder;
+    
+    if (holder.buffer == nullptr)
+        holder.buffer = instance()->acquire();
+    
+    return holder;
+}
+
+/**
+ * \fn Logger::Record* Logger::begin(int level, const char *function, int line, const char *message)
+ * 
+ * Claim the next free slot in this thread's ring and start the record
+ * in place, nothing is copied again until the writer formats it. Returns
+ * nullptr if the ring is full, the record is counted as dropped.
+ */
+Logger::Record* Logger::begin(int level, const char *function, int line, const char *message)
+{
+    Holder &h = holder();
+    Buffer *buffer = h.buffer;
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    
+    if (head - buffer->tail.load(std::memory_order_acquire) >= LOG_BUFFER_RECORDS) {
+        instance()->m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    
+    Record *record = &buffer->records[head % LOG_BUFFER_RECORDS];
+    record->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record->function = function;
+    record->tid = h.tid;
+    record->line = static_cast<uint16_t>(line);
+    record->level = static_cast<uint8_t>(level);
+    record->fields = 0;
+    record->length = 0;
+    text(*record, message);
+    return record;
+}
+
+void Logger::commit(Record *record)
+{
+    Buffer *buffer = holder().buffer;
+    buffer->head.store(buffer->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    
+    if (record->level <= LOG_ERR) {
+        Logger *logger = instance();
+        logger->m_urgent.store(true, std::memory_order_relaxed);
+        logger->m_cv.notify_one();
+    }
+}
+
+void Logger::field(Record &record, const char *key)
+{
+    if (record.length < LOG_RECORD_TEXT) {
+        record.text[record.length++] = LOG_FIELD_SEPARATOR;
+        record.fields++;
+    }
+    text(record, key);
+    if (record.length < LOG_RECORD_TEXT)
+        record.text[record.length++] = '=';
+}
+
+/*
+ * Anything that doesn't fit is cut off, a log line is not worth a
+ * second allocation on the caller's thread.
+ */
+void Logger::text(Record &record, const char *value, size_t size)
+{
+    if (value == nullptr)
+        value = "(null)";
+    if (size == std::string::npos)
+        size = strlen(value);
+    
+    size = std::min(size, static_cast<size_t>(LOG_RECORD_TEXT - record.length));
+    memcpy(record.text + record.length, value, size);
+    record.length += size;
+}
+
+void Logger::number(Record &record, const char *format, ...)
+{
+    char buffer[32];
+    va_list args;
+    
+    va_start(args, format);
+    int size = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    
+    if (size > 0)
+        text(record, buffer, std::min(static_cast<size_t>(size), sizeof(buffer) - 1));
+}
+
+/**
+ * \fn std::string Logger::format(const Logger::Record &record)
+ * 
+ * The message and its fields as one line, "message key=value ...", which
+ * is what goes to syslog and the console.
+ */
+std::string Logger::format(const Record &record)
+{
+    std::string line(record.text, record.length);
+    std::replace(line.begin(), line.end(), LOG_FIELD_SEPARATOR, ' ');
+    return line;
+}
+
+Logger::Buffer* Logger::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (!m_running && !m_stopped) {
+        m_running = true;
+        m_writer = std::thread(&Logger::run, this);
+    }
+    
+    if (!m_free.empty()) {
+        Buffer *buffer = m_free.back();
+        m_free.pop_back();
+        return buffer;
+    }
+    
+    m_buffers.emplace_back(new Buffer());
+    m_buffers.back()->head = 0;
+    m_buffers.back()->tail = 0;
+    return m_buffers.back().get();
+}
+
+void Logger::release(Buffer *buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(buffer);
+}
+
+void Logger::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    while (m_running) {
+        m_cv.wait_for(lock, std::chrono::milliseconds(50), [this]{ return !m_running || m_urgent.load(std::memory_order_relaxed); });
+        m_urgent.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+/**
+ * \fn void Logger::drain()
+ * 
+ * Take everything committed so far out of every ring, put it back in
+ * time order across threads and write it out. The writer and flush()
+ * both get here, m_drainMutex keeps their output from interleaving.
+ */
+void Logger::drain()
+{
+    std::lock_guard<std::mutex> drainLock(m_drainMutex);
+    std::vector<Record> records;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &buffer : m_buffers) {
+            uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            
+            for (uint64_t i = tail; i < head; i++)
+                records.push_back(buffer->records[i % LOG_BUFFER_RECORDS]);
+            
+            buffer->tail.store(head, std::memory_order_release);
+        }
+    }
+    
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b) { return a.timestamp < b.timestamp; });
+    
+    for (auto &record : records)
+        emit(record);
+    
+    unsigned long dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped)
+        syslog(LOG_WARNING, "Log buffers full, dropped %lu messages", dropped);
+}
+
+void Logger::emit(const Record &record)
+{
+    std::string line = format(record);
+    
+#ifdef HAVE_SYSTEMD
+    /*
+     * Fields go to the journal as their own upper case fields so they
+     * can be matched with journalctl KEY=value, the message keeps them
+     * too for anyone reading it as text.
+     */
+    std::vector<std::string> entries;
+    std::vector<struct iovec> iov;
+    const char *end = record.text + record.length;
+    const char *field = std::find(record.text, end, LOG_FIELD_SEPARATOR);
+    
+    entries.push_back("MESSAGE=" + line);
+    entries.push_back("PRIORITY=" + std::to_string(record.level));
+    entries.push_back("CODE_FUNC=" + std::string(record.function));
+    entries.push_back("CODE_LINE=" + std::to_string(record.line));
+    entries.push_back("TID=" + std::to_string(record.tid));
+    while (field != end) {
+        const char *next = std::find(field + 1, end, LOG_FIELD_SEPARATOR);
+        std::string entry(field + 1, next);
+        size_t equals = entry.find('=');
+        if (equals != std::string::npos && equals > 0) {
+            std::transform(entry.begin(), entry.begin() + equals, entry.begin(), [](unsigned char c) { return isalnum(c) ? toupper(c) : '_'; });
+            entries.push_back(entry);
+        }
+        field = next;
+    }
+    for (auto &entry : entries)
+        iov.push_back({const_cast<char*>(entry.data()), entry.size()});
+    sd_journal_sendv(iov.data(), iov.size());
+#else
+    syslog(record.level, "%s", line.c_str());
+#endif
+    
+    if (s_console.load(std::memory_order_relaxed))
+        std::cerr << record.function << ":" << record.line << ": " << line << std::endl;
+}
+
+/**
+ * \fn void Logger::flush()
+ * 
+ * Write out whatever is queued now instead of waiting for the writer.
+ */
+void Logger::flush()
+{
+    drain();
+}
+
+void Logger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_stopped = true;
+    }
+    m_cv.notify_one();
+    
+    if (m_writer.joinable())
+        m_writer.join();
+    
+    drain();
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <type_traits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <syslog.h>
+
+/*
+ * Anything less severe than this is compiled out entirely, arguments
+ * and all. Set from CMake with -DAQUARIUM_LOG_LEVEL=LOG_INFO etc.
+ */
+#ifndef AQUARIUM_LOG_LEVEL
+#define AQUARIUM_LOG_LEVEL      LOG_DEBUG
+#endif
+
+#define LOG_RECORD_TEXT         224
+#define LOG_BUFFER_RECORDS      256
+#define LOG_FIELD_SEPARATOR     '\x1f'
+
+#define AQUARIUM_LOG(level, ...) \
+    do { \
+        if constexpr ((level) <= AQUARIUM_LOG_LEVEL) { \
+            if (Logger::enabled(level)) \
+                Logger::write(level, __PRETTY_FUNCTION__, __LINE__, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOGD(...)   AQUARIUM_LOG(LOG_DEBUG, __VA_ARGS__)
+#define LOGI(...)   AQUARIUM_LOG(LOG_INFO, __VA_ARGS__)
+#define LOGN(...)   AQUARIUM_LOG(LOG_NOTICE, __VA_ARGS__)
+#define LOGW(...)   AQUARIUM_LOG(LOG_WARNING, __VA_ARGS__)
+#define LOGE(...)   AQUARIUM_LOG(LOG_ERR, __VA_ARGS__)
+#define LOGC(...)   AQUARIUM_LOG(LOG_CRIT, __VA_ARGS__)
+
+/**
+ * \class Logger
+ * 
+ * Asynchronous structured logging. Use it through the LOGx macros,
+ * a message followed by key/value pairs:
+ * 
+ *     LOGI("Found DS18B20 device", "device", name);
+ * 
+ * The caller formats the record into a ring that belongs to its thread
+ * and returns, there is no lock and no system call. A writer thread
+ * drains every ring a few times a second, or straight away for errors,
+ * and hands the records to syslog (or journald with the fields as
+ * journal fields, when built with libsystemd) and to stderr unless
+ * that has been turned off. If a thread logs faster than that its
+ * ring fills and records are dropped and counted rather than block.
+ * 
+ * Like the tracer, rings are handed back when their thread exits and
+ * picked up by the next new thread, with whatever was still queued in
+ * them, so the short lived ITimer threads don't each cost a ring.
+ */
+class Logger
+{
+public:
+    struct Record {
+        uint64_t timestamp;
+        const char *function;
+        uint32_t tid;
+        uint16_t line;
+        uint8_t level;
+        uint8_t fields;
+        uint16_t length;
+        char text[LOG_RECORD_TEXT];
+    };
+    
+    static Logger* instance()
+    {
+        static Logger instance;
+        return &instance;
+    }
+    
+    static bool enabled(int level) { return level <= s_level.load(std::memory_order_relaxed); }
+    static void setLevel(int level) { s_level.store(level, std::memory_order_relaxed); }
+    static void setConsole(bool console) { s_console.store(console, std::memory_order_relaxed); }
+    
+    template<typename... Args>
+    static void write(int level, const char *function, int line, const char *message, const Args&... fields)
+    {
+        static_assert(sizeof...(Args) % 2 == 0, "log fields must be key, value pairs");
+        Record *record = begin(level, function, line, message);
+        if (record == nullptr)
+            return;
+        append(*record, fields...);
+        commit(record);
+    }
+    
+    void flush();
+    void stop();
+    unsigned long dropped() const { return m_dropped; }
+    
+    static std::string format(const Record &record);
+    
+private:
+    struct Buffer {
+        Record records[LOG_BUFFER_RECORDS];
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+    };
+    
+    struct Holder {
+        Buffer *buffer;
+        uint32_t tid;
+        Holder();
+        ~Holder();
+    };
+    
+    Logger();
+    ~Logger();
+    Logger& operator=(Logger const&) {return *this;}
+    Logger(Logger&);
+    
+    static Record* begin(int level, const char *function, int line, const char *message);
+    static void commit(Record *record);
+    static Holder& holder();
+    
+    static void append(Record&) {}
+    
+    template<typename T, typename... Args>
+    static void append(Record &record, const char *key, const T &value, const Args&... rest)
+    {
+        field(record, key);
+        put(record, value);
+        append(record, rest...);
+    }
+    
+    template<typename T>
+    static void put(Record &record, const T &value)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+            text(record, value ? "true" : "false");
+        else if constexpr (std::is_floating_point<T>::value)
+            number(record, "%g", static_cast<double>(value));
+        else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value)
+            number(record, "%lld", static_cast<long long>(value));
+        else if constexpr (std::is_integral<T>::value)
+            number(record, "%llu", static_cast<unsigned long long>(value));
+        else if constexpr (std::is_enum<T>::value)
+            number(record, "%lld", static_cast<long long>(value));
+        else if constexpr (std::is_same<T, std::string>::value)
+            text(record, value.c_str(), value.size());
+        else if constexpr (std::is_same<T, std::string_view>::value)
+            text(record, value.data(), value.size());
+        else
+            text(record, value);
+    }
+    
+    static void field(Record &record, const char *key);
+    static void text(Record &record, const char *value, size_t size = std::string::npos);
+    static void number(Record &record, const char *format, ...) __attribute__((format(printf, 2, 3)));
+    
+    Buffer* acquire();
+    void release(Buffer *buffer);
+    void run();
+    void drain();
+    void emit(const Record &record);
+    
+    static std::atomic<int> s_level;
+    static std::atomic<bool> s_console;
+    
+    std::mutex m_mutex;
+    std::mutex m_drainMutex;
+    std::condition_variable m_cv;
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+    std::vector<Buffer*> m_free;
+    std::thread m_writer;
+    std::atomic<unsigned long> m_dropped;
+    std::atomic<bool> m_urgent;
+    bool m_running;
+    bool m_stopped;
+};
+
+#endif // LOGGER_H
@@ -24,10 +24,17 @@
  */
 
 #include "mcp3008.h"
+#include "trace.h"
 
+/*
+ * Each chip select gets its own block of 8 wiringPi pins, device 0
+ * keeps the base it has always had so old recordings still replay.
+ */
 MCP3008::MCP3008(int device)
 {
-    mcp3004Setup(200, device); // 3004 and 3008 are the same 4/8 channels
+    m_base = MCP3008_PIN_BASE + (device * 8);
+    if (!SessionRecorder::instance()->replaying())
+        mcp3004Setup(m_base, device); // 3004 and 3008 are the same 4/8 channels
     m_enabled = true;
 }
 
@@ -37,9 +44,19 @@ MCP3008::~MCP3008()
 
 int MCP3008::reading(int channel)
 {
-    if (m_enabled)
-        return analogRead(200 + channel);
-
-    return 0;
+    TRACE_SCOPE("MCP3008::reading");
+    int value = 0;
+    
+    if (!m_enabled)
+        return 0;
+    
+    if (SessionRecorder::instance()->replaying()) {
+        SessionRecorder::instance()->nextAdcSample(m_base - MCP3008_PIN_BASE + channel, value);
+        return value;
+    }
+    
+    value = analogRead(m_base + channel);
+    SessionRecorder::instance()->recordAdcSample(m_base - MCP3008_PIN_BASE + channel, value);
+    return value;
 }
 
@@ -31,6 +31,9 @@
 #include <wiringPi.h>
 #include <mcp3004.h>
 
+#include "sessionrecorder.h"
+
+#define MCP3008_PIN_BASE    200
 
 class MCP3008
 {
@@ -42,6 +45,7 @@ public:
     
 private:
     bool m_enabled;
+    int m_base;
 };
 
 #endif // MCP3008_H
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "metrics.h"
+#include "logger.h"
+
+Histogram::Histogram(std::vector<double> bounds) : m_bounds(bounds), m_sum(0)
+{
+    m_buckets.reset(new std::atomic<uint64_t>[m_bounds.size() + 1]);
+    for (size_t i = 0; i <= m_bounds.size(); i++)
+        m_buckets[i] = 0;
+}
+
+void Histogram::observe(double seconds)
+{
+    size_t i = 0;
+    
+    if (seconds < 0)
+        seconds = 0;
+    
+    while (i < m_bounds.size() && seconds > m_bounds[i])
+        i++;
+    
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(static_cast<uint64_t>(seconds * 1000000000.0), std::memory_order_relaxed);
+}
+
+void Histogram::observeSince(std::chrono::steady_clock::time_point start)
+{
+    observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+double Histogram::sum() const
+{
+    return static_cast<double>(m_sum.load(std::memory_order_relaxed)) / 1000000000.0;
+}
+
+/*
+ * 500us to 10s, wide enough for an i2c transfer at the bottom and an EZO
+ * read command or a stuck broker at the top.
+ */
+std::vector<double> MetricsRegistry::latencyBuckets()
+{
+    return { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+}
+
+MetricsRegistry::Series* MetricsRegistry::series(std::string &name, std::string &help, Type type, std::string &labels)
+{
+    Family *family = nullptr;
+    
+    for (auto &f : m_families) {
+        if (f.name == name) {
+            family = &f;
+            break;
+        }
+    }
+    
+    if (family == nullptr) {
+        m_families.emplace_back();
+        family = &m_families.back();
+        family->name = name;
+        family->help = help;
+        family->type = type;
+    }
+    else if (family->type != type) {
+        /* The caller gets a shared metric that is never rendered */
+        LOGE("Metric registered with two different types", "metric", name);
+        return nullptr;
+    }
+    
+    for (auto &s : family->series) {
+        if (s.labels == labels)
+            return &s;
+    }
+    
+    family->series.emplace_back();
+    family->series.back().labels = labels;
+    return &family->series.back();
+}
+
+Counter* MetricsRegistry::counter(std::string name, std::string help, std::string labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Series *s = series(name, help, COUNTER, labels);
+    
+    if (s == nullptr) {
+        static Counter discard;
+        return &discard;
+    }
+    
+    if (!s->counter)
+        s->counter.reset(new Counter());
+    
+    return s->counter.get();
+}
+
+Gauge* MetricsRegistry::gauge(std::string name, std::string help, std::string labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Series *s = series(name, help, GAUGE, labels);
+    
+    if (s == nullptr) {
+        static Gauge discard;
+        return &discard;
+    }
+    
+    if (!s->gauge)
+        s->gauge.reset(new Gauge());
+    
+    return s->gauge.get();
+}
+
+Histogram* MetricsRegistry::histogram(std::string name, std::string help, std::vector<double> bounds, std::string labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Series *s = series(name, help, HISTOGRAM, labels);
+    
+    if (s == nullptr) {
+        static Histogram discard(latencyBuckets());
+        return &discard;
+    }
+    
+    if (!s->histogram)
+        s->histogram.reset(new Histogram(bounds));
+    
+    return s->histogram.get();
+}
+
+void MetricsRegistry::callback(std::string name, std::string help, std::function<double()> cbk, std::string labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Series *s = series(name, help, GAUGE, labels);
+    
+    if (s != nullptr)
+        s->callback = cbk;
+}
+
+/*
+ * For totals the process already keeps, e.g. CPU time. The callback
+ * has to be monotonic, Prometheus takes any drop as a reset.
+ */
+void MetricsRegistry::counterCallback(std::string name, std::string help, std::function<double()> cbk, std::string labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Series *s = series(name, help, COUNTER, labels);
+    
+    if (s != nullptr)
+        s->callback = cbk;
+}
+
+/*
+ * Resident set, thread count and CPU time, read from /proc and
+ * getrusage() each time the endpoint is scraped.
+ */
+void MetricsRegistry::registerProcessMetrics()
+{
+    callback("aquarium_process_resident_memory_bytes", "Resident set size", []() {
+        std::ifstream fs("/proc/self/statm");
+        long size = 0;
+        long resident = 0;
+        if (fs >> size >> resident)
+            return static_cast<double>(resident) * sysconf(_SC_PAGESIZE);
+        return 0.0;
+    });
+    callback("aquarium_process_threads", "Number of threads in the process", []() {
+        std::ifstream fs("/proc/self/status");
+        std::string line;
+        while (std::getline(fs, line)) {
+            if (line.compare(0, 8, "Threads:") == 0)
+                return std::stod(line.substr(8));
+        }
+        return 0.0;
+    });
+    counterCallback("aquarium_process_cpu_seconds_total", "User and system CPU time", []() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) < 0)
+            return 0.0;
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+    });
+}
+
+static std::string formatValue(double value)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.15g", value);
+    return buf;
+}
+
+static std::string seriesName(const std::string &name, const std::string &suffix, const std::string &labels, const std::string &extra = std::string())
+{
+    std::string result = name + suffix;
+    
+    if (labels.empty() && extra.empty())
+        return result;
+    
+    result += "{" + labels;
+    if (!labels.empty() && !extra.empty())
+        result += ",";
+    result += extra + "}";
+    return result;
+}
+
+std::string MetricsRegistry::render()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+    const char *types[] = { "counter", "gauge", "histogram" };
+    
+    for (auto &family : m_families) {
+        out << "# HELP " << family.name << " " << family.help << "\n";
+        out << "# TYPE " << family.name << " " << types[family.type] << "\n";
+        
+        for (auto &s : family.series) {
+            if (s.counter) {
+                out << seriesName(family.name, "", s.labels) << " " << s.counter->value() << "\n";
+            }
+            else if (s.gauge) {
+                out << seriesName(family.name, "", s.labels) << " " << s.gauge->value() << "\n";
+            }
+            else if (s.callback) {
+                double value = 0;
+                try {
+                    value = s.callback();
+                }
+                catch (std::exception &e) {
+                    LOGE("Unable to collect metric", "metric", family.name, "error", e.what());
+                }
+                out << seriesName(family.name, "", s.labels) << " " << formatValue(value) << "\n";
+            }
+            else if (s.histogram) {
+                const std::vector<double> &bounds = s.histogram->bounds();
+                uint64_t count = 0;
+                for (size_t i = 0; i < bounds.size(); i++) {
+                    count += s.histogram->bucket(i);
+                    out << seriesName(family.name, "_bucket", s.labels, "le=\"" + formatValue(bounds[i]) + "\"") << " " << count << "\n";
+                }
+                count += s.histogram->bucket(bounds.size());
+                out << seriesName(family.name, "_bucket", s.labels, "le=\"+Inf\"") << " " << count << "\n";
+                out << seriesName(family.name, "_sum", s.labels) << " " << formatValue(s.histogram->sum()) << "\n";
+                out << seriesName(family.name, "_count", s.labels) << " " << count << "\n";
+            }
+        }
+    }
+    return out.str();
+}
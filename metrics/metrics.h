@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <iostream>
+
+#include <syslog.h>
+
+/**
+ * \class Counter
+ * 
+ * Monotonic count. inc() is one relaxed fetch_add, safe from any thread.
+ */
+class Counter
+{
+public:
+    Counter() : m_value(0) {}
+    
+    void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+    
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+/**
+ * \class Gauge
+ * 
+ * Integer value that goes up and down, each call is one relaxed atomic.
+ */
+class Gauge
+{
+public:
+    Gauge() : m_value(0) {}
+    
+    void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    void inc() { add(1); }
+    void dec() { add(-1); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+    
+private:
+    std::atomic<int64_t> m_value;
+};
+
+/**
+ * \class Histogram
+ * 
+ * Fixed bucket histogram of durations in seconds. The bucket bounds are
+ * set when it is created and never change, observe() finds the bucket
+ * with a short linear scan and does one relaxed increment there plus
+ * one on the nanosecond sum. The total count is the sum of the buckets
+ * so it isn't stored separately.
+ */
+class Histogram
+{
+public:
+    Histogram(std::vector<double> bounds);
+    
+    void observe(double seconds);
+    void observeSince(std::chrono::steady_clock::time_point start);
+    
+    const std::vector<double>& bounds() const { return m_bounds; }
+    uint64_t bucket(size_t i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+    double sum() const;
+    
+private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+    std::atomic<uint64_t> m_sum;
+};
+
+/**
+ * \class MetricsRegistry
+ * 
+ * Process wide set of metrics. Registration takes a lock and is meant
+ * to happen once, callers keep the returned pointer and update it
+ * directly, nothing on the update path goes through the registry.
+ * Asking for the same name and labels twice returns the same metric.
+ * Labels are given already formatted, e.g. device="ph".
+ * 
+ * render() writes the Prometheus text exposition format. Callback
+ * gauges and counters are evaluated at that point, which is how values
+ * that are cheaper to read on demand (RSS, queue sizes, CPU time) are
+ * exported.
+ */
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry* instance()
+    {
+        static MetricsRegistry instance;
+        return &instance;
+    }
+    
+    Counter* counter(std::string name, std::string help, std::string labels = std::string());
+    Gauge* gauge(std::string name, std::string help, std::string labels = std::string());
+    Histogram* histogram(std::string name, std::string help, std::vector<double> bounds = latencyBuckets(), std::string labels = std::string());
+    void callback(std::string name, std::string help, std::function<double()> cbk, std::string labels = std::string());
+    void counterCallback(std::string name, std::string help, std::function<double()> cbk, std::string labels = std::string());
+    void registerProcessMetrics();
+    std::string render();
+    
+    static std::vector<double> latencyBuckets();
+    
+private:
+    typedef enum METRICTYPE: int {
+        COUNTER = 0,
+        GAUGE,
+        HISTOGRAM
+    } Type;
+    
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> callback;
+    };
+    
+    struct Family {
+        std::string name;
+        std::string help;
+        Type type;
+        std::deque<Series> series;
+    };
+    
+    MetricsRegistry() {}
+    ~MetricsRegistry() {}
+    MetricsRegistry& operator=(MetricsRegistry const&) {return *this;}
+    MetricsRegistry(MetricsRegistry&);
+    
+    Series* series(std::string &name, std::string &help, Type type, std::string &labels);
+    
+    std::mutex m_mutex;
+    std::deque<Family> m_families;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstring>
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "metricsserver.h"
+#include "logger.h"
+
+MetricsServer::MetricsServer()
+{
+    m_running = false;
+    m_fd = -1;
+    m_scrapes = MetricsRegistry::instance()->counter("aquarium_metrics_scrapes_total", "Requests served by the metrics endpoint");
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(int port, std::string address)
+{
+    struct sockaddr_in addr;
+    int fd;
+    int on = 1;
+    
+    stop();
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        LOGE("Invalid metrics address", "address", address);
+        return false;
+    }
+    
+    if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        LOGE("Unable to create metrics socket", "error", strerror(errno));
+        return false;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOGE("Unable to bind metrics endpoint", "address", address, "port", port, "error", strerror(errno));
+        close(fd);
+        return false;
+    }
+    
+    LOGI("Serving metrics", "address", address, "port", port);
+    return run(fd);
+}
+
+bool MetricsServer::start(std::string path)
+{
+    struct sockaddr_un addr;
+    int fd;
+    
+    stop();
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LOGE("Metrics socket path is too long", "path", path);
+        return false;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        LOGE("Unable to create metrics socket", "error", strerror(errno));
+        return false;
+    }
+    
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOGE("Unable to bind metrics endpoint", "path", path, "error", strerror(errno));
+        close(fd);
+        return false;
+    }
+    
+    m_path = path;
+    LOGI("Serving metrics", "path", path);
+    return run(fd);
+}
+
+bool MetricsServer::run(int fd)
+{
+    if (listen(fd, 4) < 0) {
+        LOGE("Unable to listen for metrics requests", "error", strerror(errno));
+        close(fd);
+        return false;
+    }
+    
+    m_fd = fd;
+    m_running = true;
+    m_thread = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    m_running = false;
+    if (m_thread.joinable())
+        m_thread.join();
+    
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    
+    if (!m_path.empty()) {
+        unlink(m_path.c_str());
+        m_path.clear();
+    }
+}
+
+/*
+ * Poll with a timeout so stop() is noticed without needing to wake
+ * the thread some other way.
+ */
+void MetricsServer::serve()
+{
+    struct pollfd pfd;
+    
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    
+    while (m_running) {
+        int rval = poll(&pfd, 1, 500);
+        if (rval < 0 && errno != EINTR) {
+            LOGE("Metrics endpoint poll failed", "error", strerror(errno));
+            break;
+        }
+        if (rval <= 0)
+            continue;
+        
+        int client = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+            continue;
+        
+        respond(client);
+        close(client);
+    }
+}
+
+void MetricsServer::respond(int fd)
+{
+    char request[METRICS_REQUEST_SIZE];
+    size_t size = 0;
+    struct timeval tv = { 1, 0 };
+    std::string status = "200 OK";
+    std::string body;
+    std::string header;
+    
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    
+    // Only the request line matters, read until the end of the headers or the buffer is full
+    while (size < sizeof(request) - 1) {
+        ssize_t bytes = recv(fd, request + size, sizeof(request) - 1 - size, 0);
+        if (bytes <= 0)
+            break;
+        size += bytes;
+        request[size] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+            break;
+    }
+    request[size] = '\0';
+    
+    if (strncmp(request, "GET ", 4) != 0) {
+        status = "405 Method Not Allowed";
+    }
+    else if (strncmp(request + 4, "/metrics", 8) == 0 || strncmp(request + 4, "/ ", 2) == 0) {
+        body = MetricsRegistry::instance()->render();
+        m_scrapes->inc();
+    }
+    else {
+        status = "404 Not Found";
+    }
+    
+    header = "HTTP/1.0 " + status + "\r\n";
+    header += "Content-Type: text/plain; version=0.0.4\r\n";
+    header += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    header += "Connection: close\r\n\r\n";
+    
+    body.insert(0, header);
+    const char *data = body.data();
+    size = body.size();
+    while (size > 0) {
+        ssize_t bytes = send(fd, data, size, MSG_NOSIGNAL);
+        if (bytes <= 0)
+            break;
+        data += bytes;
+        size -= bytes;
+    }
+}
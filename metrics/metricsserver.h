@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+#include <syslog.h>
+
+#include "metrics.h"
+
+#define METRICS_REQUEST_SIZE    2048
+
+/**
+ * \class MetricsServer
+ * 
+ * Minimal HTTP/1.0 endpoint that answers GET /metrics with
+ * MetricsRegistry::render(). It listens either on a TCP port or, if a
+ * path is given, a Unix socket, and serves one request per connection
+ * from a single thread. It is meant for a local scraper, not the
+ * internet, so the default address is loopback.
+ */
+class MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+    
+    bool start(int port, std::string address = "127.0.0.1");
+    bool start(std::string path);
+    void stop();
+    
+private:
+    bool run(int fd);
+    void serve();
+    void respond(int fd);
+    
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::string m_path;
+    int m_fd;
+    Counter *m_scrapes;
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "localresult.h"
+#include "temperature.h"
+
+LocalResult::LocalResult()
+{
+    m_time = 0;
+    m_waterLevel = 0;
+    m_ph = 0;
+    m_oxygen = 0;
+    m_rawPh = 0;
+    m_rawOxygen = 0;
+    m_haveGpioOne = false;
+    m_haveGpioTwo = false;
+    m_gpioOne = 0;
+    m_gpioTwo = 0;
+    m_haveFlowRate = false;
+    m_flowRate = 0;
+    m_havePump = false;
+    m_pumpRunning = false;
+    m_pumpStats = PumpController::Stats();
+    m_gpioStats = GpioDebouncer::Stats();
+}
+
+nlohmann::json LocalResult::payload() const
+{
+    nlohmann::json j;
+    char timebuff[100];
+
+    memset(timebuff, '\0', 100);
+    std::strftime(timebuff, 100, "%c", std::localtime(&m_time));
+
+    if (!m_tank.empty())
+        j["aquarium"]["tank"] = m_tank;
+    j["aquarium"]["time"]["epoch"] = m_time;
+    j["aquarium"]["time"]["local"] = timebuff;
+    j["aquarium"]["waterlevel"] = m_waterLevel;
+    
+    for (auto &it : m_temperatures) {
+        j["aquarium"]["temperature"][it.first]["celsius"] = it.second;
+        j["aquarium"]["temperature"][it.first]["farenheit"] = Temperature::convertToFarenheit(it.second);
+    }
+
+    j["aquarium"]["ph"] = m_ph;
+    j["aquarium"]["oxygen"] = m_oxygen;
+    j["aquarium"]["raw"]["ph"] = m_rawPh;
+    j["aquarium"]["raw"]["oxygen"] = m_rawOxygen;
+    for (auto &it : m_readings) {
+        j["aquarium"]["sensors"][it.first] = it.second;
+    }
+    for (auto &it : m_quality) {
+        nlohmann::json &quality = j["aquarium"]["quality"][it.first];
+        quality["age_ms"] = it.second.age;
+        quality["good"] = it.second.flags == Sample::FRESH;
+        quality["flags"] = nlohmann::json::array();
+        for (uint8_t bit = Sample::FRESH; bit <= Sample::CALIBRATING; bit <<= 1) {
+            if (it.second.flags & bit)
+                quality["flags"].push_back(Sample::name(static_cast<Sample::Quality>(bit)));
+        }
+    }
+    
+    if (m_haveGpioOne) {
+        j["aquarium"]["gpio"]["1"] = m_gpioOne;
+    }
+    
+    if (m_haveGpioTwo) {
+        j["aquarium"]["gpio"]["2"] = m_gpioTwo;
+    }
+    
+    if (m_haveFlowRate) {
+        j["aquarium"]["flowrate"] = m_flowRate;
+    }
+    
+    if (m_havePump) {
+        j["aquarium"]["pump"]["running"] = m_pumpRunning;
+        j["aquarium"]["pump"]["interlock"] = m_pumpInterlock;
+        j["aquarium"]["pump"]["trips"] = m_pumpStats.trips;
+        j["aquarium"]["pump"]["latency"]["last"] = m_pumpStats.lastLatency;
+        j["aquarium"]["pump"]["latency"]["max"] = m_pumpStats.maxLatency;
+    }
+    
+    if (m_haveGpioOne || m_haveGpioTwo) {
+        j["aquarium"]["gpio"]["stats"]["edges"] = m_gpioStats.edges;
+        j["aquarium"]["gpio"]["stats"]["edgerate"] = m_gpioStats.edgeRate;
+        j["aquarium"]["gpio"]["stats"]["bounces"] = m_gpioStats.bounces;
+        j["aquarium"]["gpio"]["stats"]["changes"] = m_gpioStats.changes;
+        j["aquarium"]["gpio"]["stats"]["latency"]["last"] = m_gpioStats.lastLatency;
+        j["aquarium"]["gpio"]["stats"]["latency"]["average"] = m_gpioStats.averageLatency;
+        j["aquarium"]["gpio"]["stats"]["latency"]["max"] = m_gpioStats.maxLatency;
+    }
+    
+    return j;
+}
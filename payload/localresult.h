@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LOCALRESULT_H
+#define LOCALRESULT_H
+
+#include <string>
+#include <map>
+#include <ctime>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include "gpiodebouncer.h"
+#include "pumpcontroller.h"
+#include "sample.h"
+
+/**
+ * \class LocalResult
+ * 
+ * Snapshot of everything that goes in one tank's data message. The
+ * daemon fills it from the hardware, payload() only formats it, so the
+ * formatting can be benchmarked without any devices. Optional sections
+ * are left out of the message unless their have flag is set.
+ * 
+ * m_readings holds every registry sensor by name, the ph and oxygen
+ * fields are the first probe of each type for existing subscribers.
+ * m_tank names the tank, the daemon wide gpio, flow and pump sections
+ * only go out with the first tank.
+ * 
+ * m_quality has the age in ms and the Sample quality bits of every
+ * sensor in the tank by name, published so subscribers can drop what
+ * isn't fresh.
+ */
+class LocalResult
+{
+public:
+    struct Quality {
+        int64_t age;
+        uint8_t flags;
+    };
+    
+    LocalResult();
+    
+    nlohmann::json payload() const;
+    
+    std::string m_tank;
+    std::time_t m_time;
+    int m_waterLevel;
+    std::map<std::string, double> m_temperatures;
+    double m_ph;
+    double m_oxygen;
+    double m_rawPh;
+    double m_rawOxygen;
+    std::map<std::string, double> m_readings;
+    std::map<std::string, Quality> m_quality;
+    bool m_haveGpioOne;
+    bool m_haveGpioTwo;
+    int m_gpioOne;
+    int m_gpioTwo;
+    bool m_haveFlowRate;
+    double m_flowRate;
+    bool m_havePump;
+    bool m_pumpRunning;
+    std::string m_pumpInterlock;
+    PumpController::Stats m_pumpStats;
+    GpioDebouncer::Stats m_gpioStats;
+};
+
+#endif // LOCALRESULT_H
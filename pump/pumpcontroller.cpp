@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "gpio.h"
+#include "pumpcontroller.h"
+#include "logger.h"
+
+PumpController::PumpController(int pin, int priority, unsigned int periodms) : m_pin(pin), m_priority(priority), m_period(periodms)
+{
+    m_running = false;
+    m_pending = false;
+    m_requested = true;
+    m_on = false;
+    m_minimumLevel = 0;
+    m_hysteresis = 0;
+    m_interlocks = NONE;
+    m_stall = 0;
+    m_startedAt = 0;
+    m_trigger = 0;
+    m_trips = 0;
+    m_lastLatency = 0;
+    m_maxLatency = 0;
+}
+
+PumpController::~PumpController()
+{
+    stop();
+}
+
+uint64_t PumpController::now()
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+std::string PumpController::reason(unsigned int interlocks)
+{
+    std::string r;
+    
+    if (interlocks & OVERFLOW)
+        r += "overflow ";
+    if (interlocks & LOW_LEVEL)
+        r += "low water ";
+    if (interlocks & FLOW_STALL)
+        r += "flow stall ";
+    
+    if (r.empty())
+        return "none";
+    
+    r.pop_back();
+    return r;
+}
+
+/**
+ * \fn void PumpController::setLevelSource(std::function<int()> source, int minimum, int hysteresis)
+ * 
+ * Polled every period. Below minimum stops the pump, it may run again
+ * once the level is back above minimum + hysteresis. Set before start().
+ */
+void PumpController::setLevelSource(std::function<int()> source, int minimum, int hysteresis)
+{
+    m_levelSource = source;
+    m_minimumLevel = minimum;
+    m_hysteresis = hysteresis;
+}
+
+/**
+ * \fn void PumpController::setFlowSource(std::function<uint64_t()> lastPulse, unsigned int stallms)
+ * 
+ * lastPulse returns the monotonic time of the newest flow pulse. If the
+ * pump has been on for stallms without one, it is stopped. Set before
+ * start().
+ */
+void PumpController::setFlowSource(std::function<uint64_t()> lastPulse, unsigned int stallms)
+{
+    m_flowSource = lastPulse;
+    m_stall = static_cast<uint64_t>(stallms) * 1000000ULL;
+}
+
+void PumpController::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (m_running)
+        return;
+    
+    Gpio::instance()->setOutput(m_pin, 0);
+    m_on = false;
+    m_running = true;
+    m_thread = std::thread(&PumpController::run, this);
+}
+
+/**
+ * \fn void PumpController::stop()
+ * 
+ * Stops the control thread and leaves the pump off.
+ */
+void PumpController::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_cv.notify_one();
+    
+    if (m_thread.joinable())
+        m_thread.join();
+    
+    Gpio::instance()->write(m_pin, 0);
+    m_on = false;
+}
+
+void PumpController::setRunning(bool running)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requested = running;
+        if (running)
+            m_interlocks &= ~FLOW_STALL;
+        m_pending = true;
+    }
+    m_cv.notify_one();
+}
+
+/**
+ * \fn void PumpController::overflow(int pin, uint64_t timestamp)
+ * 
+ * Called from the GPIO event thread on the raw rising edge, before any
+ * debounce, with the kernel timestamp of the edge.
+ */
+void PumpController::overflow(int pin, uint64_t timestamp)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_overflows[pin] = true;
+        if (!(m_interlocks & OVERFLOW)) {
+            m_interlocks |= OVERFLOW;
+            m_trigger = timestamp;
+        }
+        m_pending = true;
+    }
+    m_cv.notify_one();
+}
+
+/**
+ * \fn void PumpController::overflowCleared(int pin)
+ * 
+ * Called once the debounced input has settled low again, and when a
+ * glitch shorter than the debounce window ends low, since overflow()
+ * already latched on its rising edge.
+ */
+void PumpController::overflowCleared(int pin)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_overflows.erase(pin);
+        if (m_overflows.empty())
+            m_interlocks &= ~OVERFLOW;
+        m_pending = true;
+    }
+    m_cv.notify_one();
+}
+
+bool PumpController::running()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_on;
+}
+
+unsigned int PumpController::interlocks()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_interlocks;
+}
+
+/**
+ * \fn PumpController::Stats PumpController::stats()
+ * 
+ * Latencies are in microseconds.
+ */
+PumpController::Stats PumpController::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats s;
+    
+    s.trips = m_trips;
+    s.lastLatency = m_lastLatency;
+    s.maxLatency = m_maxLatency;
+    return s;
+}
+
+void PumpController::setPriority()
+{
+    struct sched_param param;
+    
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = m_priority;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0) {
+        LOGW("Unable to run the pump interlock at SCHED_FIFO", "priority", m_priority, "error", strerror(rc));
+    }
+}
+
+/**
+ * \fn PumpController::Change PumpController::apply(uint64_t trigger)
+ * 
+ * Drive the line to match what was asked for and what the interlocks
+ * allow. Must be called with m_mutex held, the returned change goes to
+ * report() after it's released.
+ */
+PumpController::Change PumpController::apply(uint64_t trigger)
+{
+    bool want = m_requested && (m_interlocks == NONE);
+    Change change;
+    
+    if (want == m_on)
+        return change;
+    
+    Gpio::instance()->write(m_pin, want ? 1 : 0);
+    m_on = want;
+    change.changed = true;
+    change.on = want;
+    change.interlocks = m_interlocks;
+    
+    if (want) {
+        m_startedAt = now();
+        return change;
+    }
+    
+    if (m_interlocks == NONE || trigger == 0)
+        return change;
+    
+    uint64_t t = now();
+    m_lastLatency = (t > trigger) ? static_cast<double>(t - trigger) / 1000.0 : 0;
+    if (m_lastLatency > m_maxLatency)
+        m_maxLatency = m_lastLatency;
+    m_trips++;
+    change.latency = m_lastLatency;
+    return change;
+}
+
+void PumpController::report(const Change &change)
+{
+    if (!change.changed)
+        return;
+    
+    if (change.on)
+        LOGN("Pump started");
+    else if (change.latency < 0)
+        LOGN("Pump stopped");
+    else
+        LOGW("Pump stopped by interlock", "interlock", reason(change.interlocks), "latency_us", change.latency);
+}
+
+void PumpController::run()
+{
+    setPriority();
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Change change = apply(0);
+    
+    while (m_running) {
+        lock.unlock();
+        report(change);
+        
+        // The level is an SPI read, nothing waits on the lock while it's taken
+        int level = m_levelSource ? m_levelSource() : 0;
+        uint64_t last = m_flowSource ? m_flowSource() : 0;
+        
+        lock.lock();
+        uint64_t trigger = m_trigger;
+        uint64_t t = now();
+        
+        if (m_levelSource) {
+            if (level < m_minimumLevel) {
+                if (!(m_interlocks & LOW_LEVEL)) {
+                    m_interlocks |= LOW_LEVEL;
+                    trigger = t;
+                }
+            }
+            else if ((m_interlocks & LOW_LEVEL) && level >= m_minimumLevel + m_hysteresis) {
+                m_interlocks &= ~LOW_LEVEL;
+            }
+        }
+        
+        if (m_flowSource && m_stall && m_on) {
+            if (last < m_startedAt)
+                last = m_startedAt;
+            if (t > last + m_stall) {
+                m_interlocks |= FLOW_STALL;
+                trigger = t;
+            }
+        }
+        
+        change = apply(trigger);
+        lock.unlock();
+        report(change);
+        lock.lock();
+        
+        m_cv.wait_for(lock, std::chrono::milliseconds(m_period), [this] { return m_pending || !m_running; });
+        if (!m_running)
+            break;
+        
+        // An overflow is already in the interlocks, act on it before polling
+        m_pending = false;
+        change = apply(m_trigger);
+    }
+    
+    lock.unlock();
+    report(change);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PUMPCONTROLLER_H
+#define PUMPCONTROLLER_H
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <cstdint>
+
+/**
+ * \class PumpController
+ * 
+ * Drives the pump GPIO and owns the safety interlocks that can stop it.
+ * All decisions are made on one SCHED_FIFO thread which never touches
+ * MQTT or the config file. Overflow edges wake it straight from the
+ * GPIO event thread. Water level and flow are polled every period, so
+ * the worst case reaction is one period plus the measured latency.
+ * 
+ * Overflow and low level interlocks release on their own once the
+ * condition clears. A flow stall latches until the pump is started
+ * again with setRunning(true).
+ * 
+ * Latency is from the trigger (kernel edge time for an overflow, the
+ * poll that saw it otherwise) to the pump line being written low. The
+ * level and flow sources are polled, and everything logged, without
+ * the lock held, so a slow SPI read never delays an overflow.
+ */
+class PumpController
+{
+public:
+    typedef enum INTERLOCK: unsigned int {
+        NONE = 0,
+        OVERFLOW = 1,
+        LOW_LEVEL = 2,
+        FLOW_STALL = 4
+    } Interlock;
+    
+    struct Stats {
+        unsigned long trips;
+        double lastLatency;
+        double maxLatency;
+    };
+    
+    PumpController(int pin, int priority = 80, unsigned int periodms = 50);
+    ~PumpController();
+    
+    void setLevelSource(std::function<int()> source, int minimum, int hysteresis);
+    void setFlowSource(std::function<uint64_t()> lastPulse, unsigned int stallms);
+    
+    void start();
+    void stop();
+    void setRunning(bool running);
+    
+    void overflow(int pin, uint64_t timestamp);
+    void overflowCleared(int pin);
+    
+    bool running();
+    unsigned int interlocks();
+    Stats stats();
+    
+    static std::string reason(unsigned int interlocks);
+    static uint64_t now();
+    
+private:
+    /* What apply() did to the line, logged once the lock is let go */
+    struct Change {
+        bool changed;
+        bool on;
+        unsigned int interlocks;
+        double latency;
+        
+        Change() : changed(false), on(false), interlocks(NONE), latency(-1) {}
+    };
+    
+    void run();
+    void setPriority();
+    Change apply(uint64_t trigger);
+    static void report(const Change &change);
+    
+    std::function<int()> m_levelSource;
+    std::function<uint64_t()> m_flowSource;
+    std::map<int, bool> m_overflows;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    bool m_running;
+    bool m_pending;
+    bool m_requested;
+    bool m_on;
+    int m_pin;
+    int m_priority;
+    int m_minimumLevel;
+    int m_hysteresis;
+    unsigned int m_period;
+    unsigned int m_interlocks;
+    uint64_t m_stall;
+    uint64_t m_startedAt;
+    uint64_t m_trigger;
+    unsigned long m_trips;
+    double m_lastLatency;
+    double m_maxLatency;
+};
+
+#endif // PUMPCONTROLLER_H
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstring>
+#include <iostream>
+
+#include "sessionrecorder.h"
+#include "logger.h"
+
+#define RECORD_HEADER_SIZE  16
+
+SessionRecorder::SessionRecorder()
+{
+    m_mode = OFF;
+    m_speed = 1.0;
+    m_lastTimestamp = 0;
+    m_recordCount = 0;
+    m_finished = false;
+    m_stop = false;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    stop();
+}
+
+uint64_t SessionRecorder::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+/**
+ * \fn int SessionRecorder::scale(int milliseconds)
+ * 
+ * Timer intervals and I2C response delays are divided by the replay
+ * speed so polled sources keep pace with the recorded timeline.
+ */
+int SessionRecorder::scale(int milliseconds) const
+{
+    if (m_mode != REPLAY || m_speed <= 1.0)
+        return milliseconds;
+    
+    int scaled = static_cast<int>(milliseconds / m_speed);
+    return scaled > 0 ? scaled : 1;
+}
+
+bool SessionRecorder::startCapture(std::string path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t magic = SESSION_LOG_MAGIC;
+    uint16_t version = SESSION_LOG_VERSION;
+    
+    m_log.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_log.is_open()) {
+        LOGE("Unable to open session log for writing", "path", path);
+        return false;
+    }
+    
+    m_log.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    m_log.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    m_start = std::chrono::steady_clock::now();
+    m_mode = CAPTURE;
+    LOGN("Capturing session", "path", path);
+    return true;
+}
+
+bool SessionRecorder::startReplay(std::string path, double speed)
+{
+    if (!load(path))
+        return false;
+    
+    m_speed = speed > 0 ? speed : 1.0;
+    m_start = std::chrono::steady_clock::now();
+    m_mode = REPLAY;
+    m_stop = false;
+    m_finished = false;
+    LOGN("Replaying session", "path", path, "speed", m_speed);
+    return true;
+}
+
+/**
+ * \fn void SessionRecorder::play()
+ * 
+ * Starts dispatching pushed events, from the beginning of the recorded
+ * timeline. The handlers have to be set first, they're read from the
+ * replay thread without a lock.
+ */
+void SessionRecorder::play()
+{
+    if (m_mode != REPLAY || m_replayThread.joinable())
+        return;
+    
+    m_start = std::chrono::steady_clock::now();
+    m_replayThread = std::thread(&SessionRecorder::replayPushedEvents, this);
+}
+
+void SessionRecorder::stop()
+{
+    m_stop = true;
+    if (m_replayThread.joinable())
+        m_replayThread.join();
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_log.is_open()) {
+        m_log.flush();
+        m_log.close();
+    }
+    m_mode = OFF;
+}
+
+bool SessionRecorder::load(std::string path)
+{
+    std::ifstream fs(path, std::ios::in | std::ios::binary);
+    uint32_t magic = 0;
+    uint16_t version = 0;
+    char header[RECORD_HEADER_SIZE];
+    int count = 0;
+    
+    if (!fs.is_open()) {
+        LOGE("Unable to open session log", "path", path);
+        return false;
+    }
+    
+    fs.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    fs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (magic != SESSION_LOG_MAGIC || version != SESSION_LOG_VERSION) {
+        LOGE("Not a session log this version can read", "path", path);
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (fs.read(header, RECORD_HEADER_SIZE)) {
+        Record r;
+        uint16_t size;
+        
+        r.type = static_cast<uint8_t>(header[0]);
+        memcpy(&size, header + 2, sizeof(size));
+        memcpy(&r.key, header + 4, sizeof(r.key));
+        memcpy(&r.timestamp, header + 8, sizeof(r.timestamp));
+        r.payload.resize(size);
+        if (size > 0 && !fs.read(&r.payload[0], size))
+            break;
+        
+        switch (r.type) {
+            case I2C_READ:
+                m_i2cReads[r.key].push_back(r.payload);
+                break;
+            case W1_READ:
+            {
+                std::string::size_type pos = r.payload.find('\n');
+                if (pos != std::string::npos)
+                    m_w1Reads[r.payload.substr(0, pos)].push_back(r.payload.substr(pos + 1));
+                break;
+            }
+            case ADC_SAMPLE:
+            {
+                int value = 0;
+                if (r.payload.size() == sizeof(value))
+                    memcpy(&value, r.payload.data(), sizeof(value));
+                m_adcSamples[r.key].push_back(value);
+                break;
+            }
+            case GPIO_EDGE:
+            case MQTT_IN:
+                m_pushed.push_back(r);
+                break;
+            default:
+                break;
+        }
+        m_lastTimestamp = std::max(m_lastTimestamp, r.timestamp);
+        count++;
+    }
+    
+    m_recordCount = count;
+    LOGI("Loaded session log", "path", path, "records", count);
+    return true;
+}
+
+void SessionRecorder::write(RecordType type, uint32_t key, const char *payload, uint16_t size)
+{
+    char header[RECORD_HEADER_SIZE];
+    uint64_t timestamp = now();
+    
+    memset(header, 0, RECORD_HEADER_SIZE);
+    header[0] = static_cast<char>(type);
+    memcpy(header + 2, &size, sizeof(size));
+    memcpy(header + 4, &key, sizeof(key));
+    memcpy(header + 8, &timestamp, sizeof(timestamp));
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_log.is_open())
+        return;
+    
+    m_log.write(header, RECORD_HEADER_SIZE);
+    if (size > 0)
+        m_log.write(payload, size);
+}
+
+void SessionRecorder::recordI2CWrite(int bus, int address, const uint8_t *buf, int size)
+{
+    if (m_mode == CAPTURE)
+        write(I2C_WRITE, (bus << 8) | address, reinterpret_cast<const char*>(buf), size);
+}
+
+void SessionRecorder::recordI2CRead(int bus, int address, const uint8_t *buf, int size)
+{
+    if (m_mode == CAPTURE)
+        write(I2C_READ, (bus << 8) | address, reinterpret_cast<const char*>(buf), size);
+}
+
+void SessionRecorder::recordW1Read(std::string device, const std::string &contents)
+{
+    if (m_mode == CAPTURE) {
+        std::string payload = device + "\n" + contents;
+        write(W1_READ, 0, payload.data(), payload.size());
+    }
+}
+
+void SessionRecorder::recordAdcSample(int channel, int value)
+{
+    if (m_mode == CAPTURE)
+        write(ADC_SAMPLE, channel, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void SessionRecorder::recordGpioEdge(int pin, int value)
+{
+    uint8_t v = static_cast<uint8_t>(value);
+    
+    if (m_mode == CAPTURE)
+        write(GPIO_EDGE, pin, reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void SessionRecorder::recordMqttMessage(std::string topic, std::string message)
+{
+    if (m_mode == CAPTURE) {
+        std::string payload = topic;
+        payload.push_back('\0');
+        payload += message;
+        write(MQTT_IN, 0, payload.data(), payload.size());
+    }
+}
+
+bool SessionRecorder::nextI2CRead(int bus, int address, uint8_t *buf, int &size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_i2cReads.find((bus << 8) | address);
+    
+    if (it == m_i2cReads.end() || it->second.empty())
+        return false;
+    
+    std::string &r = it->second.front();
+    int count = std::min(static_cast<int>(r.size()), size);
+    memcpy(buf, r.data(), count);
+    size = count;
+    it->second.pop_front();
+    return true;
+}
+
+bool SessionRecorder::nextW1Read(std::string device, std::string &contents)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_w1Reads.find(device);
+    
+    if (it == m_w1Reads.end() || it->second.empty())
+        return false;
+    
+    contents = it->second.front();
+    it->second.pop_front();
+    return true;
+}
+
+bool SessionRecorder::nextAdcSample(int channel, int &value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_adcSamples.find(channel);
+    
+    if (it == m_adcSamples.end() || it->second.empty())
+        return false;
+    
+    value = it->second.front();
+    it->second.pop_front();
+    return true;
+}
+
+std::vector<std::string> SessionRecorder::w1Devices()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> devices;
+    
+    for (const auto& [device, reads] : m_w1Reads) {
+        devices.push_back(device);
+    }
+    return devices;
+}
+
+bool SessionRecorder::sleepUntil(uint64_t timestamp)
+{
+    auto due = m_start + std::chrono::nanoseconds(static_cast<uint64_t>(timestamp / m_speed));
+    
+    while (!m_stop && std::chrono::steady_clock::now() < due) {
+        auto wait = std::min(due - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration(std::chrono::milliseconds(100)));
+        std::this_thread::sleep_for(wait);
+    }
+    return !m_stop;
+}
+
+/**
+ * \fn void SessionRecorder::replayPushedEvents()
+ * 
+ * Walks the GPIO and MQTT records in capture order, sleeping until
+ * each one is due on the scaled timeline. Handlers are called from
+ * this thread just as the ISR and MQTT callbacks would have been.
+ */
+void SessionRecorder::replayPushedEvents()
+{
+    for (auto &r : m_pushed) {
+        if (!sleepUntil(r.timestamp))
+            return;
+        
+        try {
+            if (r.type == GPIO_EDGE && m_gpioHandler && r.payload.size() == 1) {
+                m_gpioHandler(r.key, static_cast<uint8_t>(r.payload[0]));
+            }
+            else if (r.type == MQTT_IN && m_mqttHandler) {
+                std::string::size_type pos = r.payload.find('\0');
+                if (pos != std::string::npos)
+                    m_mqttHandler(r.payload.substr(0, pos), r.payload.substr(pos + 1));
+            }
+        }
+        catch (std::exception &e) {
+            LOGE("Unable to execute function", "error", e.what());
+        }
+    }
+    
+    // Let the polled sources run out the rest of the recording
+    if (!sleepUntil(m_lastTimestamp))
+        return;
+    
+    m_finished = true;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    LOGN("Session replay finished", "records", m_recordCount, "covering_s", m_lastTimestamp / 1e9, "elapsed_s", elapsed);
+    if (m_finishedHandler)
+        m_finishedHandler();
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+#include <syslog.h>
+
+#define SESSION_LOG_MAGIC       0x4c525141  // "AQRL"
+#define SESSION_LOG_VERSION     1
+
+/**
+ * \class SessionRecorder
+ * 
+ * Captures every raw exchange the daemon has with the outside world
+ * into a compact binary log, and plays such a log back in place of the
+ * hardware so a field incident can be reproduced on the bench.
+ * 
+ * The log is a small file header followed by records, each a fixed
+ * 16 byte header and a payload
+ * 
+ *   uint8  type
+ *   uint8  reserved
+ *   uint16 payload length
+ *   uint32 key          bus << 8 | address, ADC channel, or GPIO pin
+ *   uint64 timestamp    nanoseconds since capture started
+ * 
+ * Polled sources (I2C reads, w1 reads, ADC samples) are handed back in
+ * order per key when the driver asks for them. Pushed sources (GPIO
+ * edges, inbound MQTT messages) are dispatched from a replay thread on
+ * the recorded timeline, scaled by the replay speed. startReplay() only
+ * loads the log and switches the drivers over, the thread and the
+ * timeline start with play() once the handlers are set. Timer intervals
+ * should be passed through scale() so the whole daemon speeds up
+ * together.
+ */
+class SessionRecorder
+{
+public:
+    typedef enum MODETYPE: int {
+        OFF = 0,
+        CAPTURE = 1,
+        REPLAY = 2
+    } Mode;
+    
+    typedef enum RECORDTYPE: uint8_t {
+        I2C_WRITE = 1,
+        I2C_READ = 2,
+        W1_READ = 3,
+        ADC_SAMPLE = 4,
+        GPIO_EDGE = 5,
+        MQTT_IN = 6
+    } RecordType;
+    
+    static SessionRecorder* instance()
+    {
+        static SessionRecorder instance;
+        return &instance;
+    }
+    
+    bool startCapture(std::string path);
+    bool startReplay(std::string path, double speed = 1.0);
+    void play();
+    void stop();
+    
+    Mode mode() const { return m_mode; }
+    bool capturing() const { return m_mode == CAPTURE; }
+    bool replaying() const { return m_mode == REPLAY; }
+    bool finished() const { return m_finished; }
+    double speed() const { return m_speed; }
+    int scale(int milliseconds) const;
+    
+    void recordI2CWrite(int bus, int address, const uint8_t *buf, int size);
+    void recordI2CRead(int bus, int address, const uint8_t *buf, int size);
+    void recordW1Read(std::string device, const std::string &contents);
+    void recordAdcSample(int channel, int value);
+    void recordGpioEdge(int pin, int value);
+    void recordMqttMessage(std::string topic, std::string message);
+    
+    bool nextI2CRead(int bus, int address, uint8_t *buf, int &size);
+    bool nextW1Read(std::string device, std::string &contents);
+    bool nextAdcSample(int channel, int &value);
+    std::vector<std::string> w1Devices();
+    
+    void setGpioHandler(std::function<void(int, int)> cbk) { m_gpioHandler = cbk; }
+    void setMqttHandler(std::function<void(std::string, std::string)> cbk) { m_mqttHandler = cbk; }
+    void setFinishedHandler(std::function<void()> cbk) { m_finishedHandler = cbk; }
+    
+private:
+    struct Record {
+        uint8_t type;
+        uint32_t key;
+        uint64_t timestamp;
+        std::string payload;
+    };
+    
+    SessionRecorder();
+    ~SessionRecorder();
+    SessionRecorder& operator=(SessionRecorder const&) {return *this;}
+    SessionRecorder(SessionRecorder&);
+    
+    void write(RecordType type, uint32_t key, const char *payload, uint16_t size);
+    bool load(std::string path);
+    void replayPushedEvents();
+    bool sleepUntil(uint64_t timestamp);
+    uint64_t now() const;
+    
+    std::map<uint32_t, std::deque<std::string>> m_i2cReads;
+    std::map<std::string, std::deque<std::string>> m_w1Reads;
+    std::map<uint32_t, std::deque<int>> m_adcSamples;
+    std::vector<Record> m_pushed;
+    std::ofstream m_log;
+    std::mutex m_mutex;
+    std::thread m_replayThread;
+    std::chrono::steady_clock::time_point m_start;
+    std::function<void(int, int)> m_gpioHandler;
+    std::function<void(std::string, std::string)> m_mqttHandler;
+    std::function<void()> m_finishedHandler;
+    uint64_t m_lastTimestamp;
+    int m_recordCount;
+    std::atomic<bool> m_finished;
+    std::atomic<bool> m_stop;
+    Mode m_mode;
+    double m_speed;
+};
+
+#endif // SESSIONRECORDER_H
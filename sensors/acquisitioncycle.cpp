@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <chrono>
+#include <exception>
+
+#include "acquisitioncycle.h"
+#include "sensorregistry.h"
+#include "sessionrecorder.h"
+#include "trace.h"
+#include "logger.h"
+
+AcquisitionCycle::AcquisitionCycle()
+{
+    m_running = false;
+    m_trigger = false;
+    m_interval = ACQUISITION_CYCLE_MS;
+    m_settle = ACQUISITION_SETTLE_MS;
+    m_sequence = 0;
+}
+
+AcquisitionCycle::~AcquisitionCycle()
+{
+    stop();
+}
+
+void AcquisitionCycle::addSink(Sink sink)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sinks.push_back(sink);
+}
+
+void AcquisitionCycle::start(int interval, bool trigger, int settle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (m_running)
+        return;
+    
+    m_interval = interval;
+    m_trigger = trigger;
+    m_settle = settle;
+    m_running = true;
+    m_thread = std::thread(&AcquisitionCycle::run, this);
+    LOGI("Acquisition cycle started", "interval_ms", interval, "trigger", trigger, "settle_ms", settle);
+}
+
+void AcquisitionCycle::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+/*
+ * True once every sensor has reported a reading since its count was
+ * taken. Those that have are dropped from the list as they come in.
+ */
+bool AcquisitionCycle::settled(std::vector<std::pair<Sensor*, uint64_t>> &counts)
+{
+    for (auto it = counts.begin(); it != counts.end();) {
+        if (it->first->readingCount() != it->second)
+            it = counts.erase(it);
+        else
+            it++;
+    }
+    return counts.empty();
+}
+
+/*
+ * In trigger mode every sensor is read once a cycle, otherwise those
+ * with an interval of their own keep it.
+ */
+int64_t AcquisitionCycle::staleAfter(Sensor *sensor) const
+{
+    int period = m_interval;
+    
+    if (!m_trigger && sensor->interval() > 0)
+        period = sensor->interval();
+    
+    return SessionRecorder::instance()->scale(static_cast<int>(sensor->staleAfter(period)));
+}
+
+/**
+ * \fn Frame AcquisitionCycle::capture()
+ * 
+ * Reads one frame. In trigger mode this blocks for up to the settle
+ * time waiting on the sensors.
+ */
+Frame AcquisitionCycle::capture()
+{
+    TRACE_SCOPE("AcquisitionCycle::capture");
+    std::vector<std::pair<Sensor*, uint64_t>> pending;
+    std::vector<Sensor*> sensors;
+    Frame frame;
+    
+    for (auto sensor : SensorRegistry::instance()->sensors()) {
+        if (sensor->enabled())
+            sensors.push_back(sensor);
+    }
+    
+    if (m_trigger) {
+        for (auto sensor : sensors)
+            pending.push_back({ sensor, sensor->readingCount() });
+        
+        SensorRegistry::instance()->trigger();
+        
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SessionRecorder::instance()->scale(m_settle));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running && !settled(pending) && std::chrono::steady_clock::now() < deadline)
+            m_cv.wait_for(lock, std::chrono::milliseconds(ACQUISITION_POLL_MS));
+    }
+    else {
+        for (auto sensor : sensors) {
+            if (sensor->interval() > 0)
+                continue;
+            try {
+                sensor->acquire();
+            }
+            catch (std::exception &e) {
+                LOGE("Sensor acquire failed", "sensor", sensor->name(), "error", e.what());
+            }
+        }
+    }
+    
+    frame.sequence = ++m_sequence;
+    frame.time = std::time(nullptr);
+    int64_t now = Sample::now();
+    
+    for (auto sensor : sensors) {
+        FrameSample &sample = frame.samples[sensor->name()];
+        sample.tank = sensor->tank();
+        sample.type = sensor->type();
+        sample.sample = sensor->sample(staleAfter(sensor));
+        sample.age = sample.sample.age(now);
+        sensor->readings(sample.readings);
+    }
+    bool running;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        running = m_running;
+    }
+    for (auto &missed : pending) {
+        frame.samples[missed.first->name()].reported = false;
+        if (running)
+            LOGW("Sensor missed the acquisition cycle", "sensor", missed.first->name(), "cycle", frame.sequence);
+    }
+    
+    return frame;
+}
+
+void AcquisitionCycle::run()
+{
+    std::chrono::milliseconds interval(SessionRecorder::instance()->scale(m_interval));
+    auto due = std::chrono::steady_clock::now() + interval;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_cv.wait_until(lock, due, [this]() { return !m_running; }))
+                break;
+        }
+        
+        Frame frame = capture();
+        std::vector<Sink> sinks;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+                break;
+            sinks = m_sinks;
+        }
+        
+        for (auto &sink : sinks) {
+            TRACE_SCOPE("AcquisitionCycle::sink");
+            try {
+                sink(frame);
+            }
+            catch (std::exception &e) {
+                LOGE("Frame sink failed", "cycle", frame.sequence, "error", e.what());
+            }
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        due += interval;
+        if (due < now)
+            due = now + interval;
+    }
+}
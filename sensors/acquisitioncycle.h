@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ACQUISITIONCYCLE_H
+#define ACQUISITIONCYCLE_H
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+#include "frame.h"
+#include "sensor.h"
+
+#define ACQUISITION_CYCLE_MS    60000
+#define ACQUISITION_SETTLE_MS   5000
+#define ACQUISITION_POLL_MS     50
+
+/**
+ * \class AcquisitionCycle
+ * 
+ * Builds one Frame per cycle and hands it to every sink in turn. With
+ * trigger set every sensor is asked to read at the start of the cycle
+ * through the registry's bus schedulers, and the frame is taken once
+ * they have all answered or the settle time runs out. Without it the
+ * sensors keep their own intervals and the frame is the latest value
+ * of each, with sensors that are only read on demand, like the ADC,
+ * read once for the frame.
+ * 
+ * Sinks run on the cycle thread and shouldn't block on the network.
+ * staleAfter() is the threshold in ms a sensor's sample is flagged
+ * stale at, based on how often this cycle has it read.
+ */
+class AcquisitionCycle
+{
+public:
+    typedef std::function<void(const Frame&)> Sink;
+    
+    AcquisitionCycle();
+    ~AcquisitionCycle();
+    
+    void addSink(Sink sink);
+    void start(int interval, bool trigger, int settle);
+    void stop();
+    Frame capture();
+    int64_t staleAfter(Sensor *sensor) const;
+    
+private:
+    void run();
+    bool settled(std::vector<std::pair<Sensor*, uint64_t>> &counts);
+    
+    std::vector<Sink> m_sinks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    bool m_running;
+    bool m_trigger;
+    int m_interval;
+    int m_settle;
+    uint64_t m_sequence;
+};
+
+#endif // ACQUISITIONCYCLE_H
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "adcsensor.h"
+#include "atlasscientifici2c.h"
+
+AdcSensor::AdcSensor(const SensorConfig &config) : Sensor(config)
+{
+    m_adc = adc(m_config.address);
+    m_last = 0;
+    m_acquired = false;
+}
+
+void AdcSensor::acquire()
+{
+    m_last = reading();
+    m_acquired = true;
+    notify(AtlasScientificI2C::READING, std::to_string(m_last.load()));
+}
+
+/*
+ * wiringPi fails setup for a pin base that's already taken, so there
+ * is only ever one MCP3008 per chip select, and it lives as long as
+ * the process.
+ */
+MCP3008* AdcSensor::adc(int device)
+{
+    static std::map<int, MCP3008*> devices;
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = devices.find(device);
+    if (it != devices.end())
+        return it->second;
+    
+    MCP3008 *adc = new MCP3008(device);
+    devices[device] = adc;
+    return adc;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ADCSENSOR_H
+#define ADCSENSOR_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+
+#include "sensor.h"
+#include "mcp3008.h"
+
+/**
+ * \class AdcSensor
+ * 
+ * One channel of an MCP3008. The address is the SPI chip select, and
+ * the converter is shared by every sensor on the same one. A read is
+ * a few microseconds, so nothing is scheduled unless the config asks
+ * for it. value() is the value from the last acquire(), so everything
+ * reading one acquisition frame sees the same level, and reads the
+ * channel live until the first acquire. reading() is always live.
+ */
+class AdcSensor : public Sensor
+{
+public:
+    AdcSensor(const SensorConfig &config);
+    
+    std::string busId() const override { return "spi"; }
+    bool enabled() override { return true; }
+    void acquire() override;
+    double value() override { return m_acquired ? m_last.load() : reading(); }
+    
+    int reading() { return m_adc->reading(m_config.channel); }
+    
+private:
+    static MCP3008* adc(int device);
+    
+    MCP3008 *m_adc;
+    std::atomic<int> m_last;
+    std::atomic<bool> m_acquired;
+};
+
+#endif // ADCSENSOR_H
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "ds18b20sensor.h"
+#include "atlasscientifici2c.h"
+
+Ds18b20Sensor::Ds18b20Sensor(const SensorConfig &config) : Sensor(config)
+{
+    m_temp = new Temperature();
+    m_busy = false;
+}
+
+Ds18b20Sensor::~Ds18b20Sensor()
+{
+    if (m_reader.joinable())
+        m_reader.join();
+    delete m_temp;
+}
+
+void Ds18b20Sensor::acquire()
+{
+    if (m_busy)
+        return;
+    
+    if (m_reader.joinable())
+        m_reader.join();
+    
+    m_busy = true;
+    m_reader = std::thread(&Ds18b20Sensor::read, this);
+}
+
+void Ds18b20Sensor::read()
+{
+    std::map<std::string, std::string> devices = m_temp->devices();
+    std::map<std::string, Sample> values;
+    Sample first;
+    bool found = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        values = m_values;
+        first = m_first;
+    }
+    
+    for (auto it = devices.begin(); it != devices.end(); it++) {
+        if (!owns(it->second))
+            continue;
+        
+        double c = 0;
+        uint8_t quality = Sample::FRESH;
+        if (!m_temp->getTemperatureByDevice(it->first, c))
+            quality = Sample::PARSE_ERROR;
+        else if (c < DS18B20_MIN_CELSIUS || c > DS18B20_MAX_CELSIUS)
+            quality = Sample::OUT_OF_RANGE;
+        
+        Sample &probe = values[it->second];
+        if (quality == Sample::FRESH)
+            probe = Sample(c, c, Sample::now(), quality);
+        else
+            probe.quality = quality;
+        
+        if (!found) {
+            if (quality == Sample::FRESH)
+                first = Sample(c, c, Sample::now(), quality);
+            else
+                first.quality = quality;
+        }
+        found = true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_values = values;
+        m_first = first;
+    }
+    m_busy = false;
+    notify(AtlasScientificI2C::READING, std::string());
+}
+
+/*
+ * Every tank shares the one 1-wire bus, so a sensor with a probes list
+ * only reads the probes named in it.
+ */
+bool Ds18b20Sensor::owns(const std::string &probe) const
+{
+    const std::vector<std::string> &probes = m_config.probes;
+    
+    return probes.empty() || std::find(probes.begin(), probes.end(), probe) != probes.end();
+}
+
+double Ds18b20Sensor::value()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_first.value;
+}
+
+Sample Ds18b20Sensor::current()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_first;
+}
+
+/*
+ * Keyed by the probe names from the ds18b20 array, not the sensor name.
+ * The sensor's quality only covers its first probe, so a probe whose
+ * last read failed is left out rather than published under its old
+ * temperature with nothing to say it's bad.
+ */
+void Ds18b20Sensor::readings(std::map<std::string, double> &values)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &it : m_values) {
+        if (it.second.good())
+            values[it.first] = it.second.value;
+    }
+}
+
+/**
+ * \fn bool Ds18b20Sensor::probe(const std::string &name, int64_t staleMs, Sample &sample)
+ * 
+ * One probe's sample, flagged stale and disabled the same way sample()
+ * does for the sensor. False if this sensor has no probe by that name.
+ */
+bool Ds18b20Sensor::probe(const std::string &name, int64_t staleMs, Sample &sample)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_values.find(name);
+        if (it == m_values.end())
+            return false;
+        sample = it->second;
+    }
+    
+    if (!enabled())
+        sample.quality |= Sample::DISABLED;
+    if (staleMs > 0 && sample.time > 0 && Sample::now() - sample.time > staleMs)
+        sample.quality = (sample.quality & ~Sample::FRESH) | Sample::STALE;
+    return true;
+}
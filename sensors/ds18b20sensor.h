@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DS18B20SENSOR_H
+#define DS18B20SENSOR_H
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include "sensor.h"
+#include "temperature.h"
+
+#define DS18B20_MIN_CELSIUS     -55.0
+#define DS18B20_MAX_CELSIUS     125.0
+
+/**
+ * \class Ds18b20Sensor
+ * 
+ * Every DS18B20 on the 1-wire bus, or just the ones named in its
+ * probes list, as one sensor. A conversion takes
+ * most of a second per device, so reads run on their own thread and
+ * the values are cached. A read is skipped if the last one is still
+ * going. value() is the first of its devices by serial, the same one
+ * the daemon has always used for temperature compensation.
+ * 
+ * A probe that can't be read or reads outside the part's range keeps
+ * its last value, the first probe's failures show up in the quality
+ * of the sensor's sample and each probe's in probe().
+ */
+class Ds18b20Sensor : public Sensor
+{
+public:
+    Ds18b20Sensor(const SensorConfig &config);
+    ~Ds18b20Sensor();
+    
+    std::string busId() const override { return "w1"; }
+    bool enabled() override { return m_temp->enabled(); }
+    void acquire() override;
+    double value() override;
+    void readings(std::map<std::string, double> &values) override;
+    bool probe(const std::string &name, int64_t staleMs, Sample &sample);
+    
+    Temperature* temperature() { return m_temp; }
+    
+protected:
+    Sample current() override;
+    
+private:
+    void read();
+    bool owns(const std::string &probe) const;
+    
+    Temperature *m_temp;
+    std::map<std::string, Sample> m_values;
+    Sample m_first;
+    std::mutex m_mutex;
+    std::thread m_reader;
+    std::atomic<bool> m_busy;
+};
+
+#endif // DS18B20SENSOR_H
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EZOSENSOR_H
+#define EZOSENSOR_H
+
+#include "sensor.h"
+#include "potentialhydrogen.h"
+#include "dissolvedoxygen.h"
+
+/**
+ * \class EzoSensor
+ * 
+ * Registry adapter for any Atlas EZO circuit. The probe itself is still
+ * reachable through probe() for calibration. Circuits that don't take
+ * temperature compensation ignore it in the probe, not here.
+ */
+template<typename Probe>
+class EzoSensor : public Sensor
+{
+public:
+    EzoSensor(const SensorConfig &config) : Sensor(config)
+    {
+        m_probe = new Probe(m_config.bus, m_config.address);
+        if (m_config.mux > 0)
+            m_probe->setMux(I2cMux::get(m_config.bus, m_config.mux), m_config.muxChannel);
+        m_probe->setCallback([this](int cmd, std::string response) { notify(cmd, response); });
+    }
+    
+    ~EzoSensor()
+    {
+        delete m_probe;
+    }
+    
+    bool enabled() override { return m_probe->enabled(); }
+    double value() override { return m_probe->value(); }
+    double raw() override { return m_probe->raw(); }
+    
+    /*
+     * Same startup exchange the daemon always did, the answers come
+     * back through the callback.
+     */
+    void start() override
+    {
+        m_probe->sendInfoCommand();
+        m_probe->calibrate(Probe::CAL_QUERY);
+        m_probe->getTempCompensation();
+        m_probe->sendStatusCommand();
+        m_probe->disableLeds();
+    }
+    
+    void acquire() override
+    {
+        m_probe->sendReadCommand();
+    }
+    
+    void acquire(double celsius) override
+    {
+        m_probe->setTempCompensationAndRead(celsius);
+    }
+    
+    void setTempCompensation(double celsius) override
+    {
+        m_probe->setTempCompensation(celsius);
+        m_probe->getTempCompensation();
+    }
+    
+    bool calibrate(int cmd, double value) override
+    {
+        return m_probe->calibrate(cmd, value);
+    }
+    
+    void setFilter(FilterChain *filter) override
+    {
+        Sensor::setFilter(filter);
+        m_probe->setFilter(filter);
+    }
+    
+    Probe* probe() { return m_probe; }
+    
+protected:
+    Sample current() override { return m_probe->sample(); }
+    
+private:
+    Probe *m_probe;
+};
+
+typedef EzoSensor<PotentialHydrogen> PhSensor;
+typedef EzoSensor<DissolvedOxygen> DoSensor;
+typedef EzoSensor<Conductivity> EcSensor;
+typedef EzoSensor<OxidationReduction> OrpSensor;
+typedef EzoSensor<RtdTemperature> RtdSensor;
+
+#endif // EZOSENSOR_H
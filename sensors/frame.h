@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <string>
+#include <map>
+#include <ctime>
+#include <cstdint>
+
+#include "sample.h"
+
+/**
+ * \struct FrameSample
+ * 
+ * One sensor's part of a frame. readings is what the sensor adds to the
+ * data message, keyed by probe name for a DS18B20 and by sensor name
+ * for everything else. reported is false when the sensor was asked to
+ * read this cycle and didn't answer in time, the values are then its
+ * last ones. sample carries the quality bits, with stale worked out
+ * against the sensor's threshold when the frame was taken, and age is
+ * how old its value was then in ms. Consumers that can't pass the
+ * quality on should drop a sample that isn't good().
+ */
+struct FrameSample {
+    std::string tank;
+    std::string type;
+    Sample sample;
+    int64_t age;
+    bool reported;
+    std::map<std::string, double> readings;
+    
+    FrameSample() : age(0), reported(true) {}
+    
+    double value() const { return sample.value; }
+    double raw() const { return sample.raw; }
+    bool good() const { return sample.good(); }
+};
+
+/**
+ * \struct Frame
+ * 
+ * Everything read in one acquisition cycle, keyed by sensor name. Every
+ * sink is handed the same frame, so they all publish the same values
+ * and nothing is read twice for them.
+ */
+struct Frame {
+    uint64_t sequence;
+    std::time_t time;
+    std::map<std::string, FrameSample> samples;
+    
+    Frame() : sequence(0), time(0) {}
+    
+    const FrameSample* sample(const std::string &name) const
+    {
+        auto it = samples.find(name);
+        return it == samples.end() ? nullptr : &it->second;
+    }
+};
+
+#endif // FRAME_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sensor.h"
+#include "atlasscientifici2c.h"
+
+Sensor::Sensor(const SensorConfig &config) : m_config(config)
+{
+    m_filter = nullptr;
+    m_detector = nullptr;
+    m_lastReading = std::time(nullptr);
+    m_readingCount = 0;
+    m_sampleTime = 0;
+    m_calibrating = false;
+    m_created = Sample::now();
+    
+    if (m_config.label.empty())
+        m_config.label = m_config.name;
+}
+
+Sensor::~Sensor()
+{
+    delete m_filter;
+    delete m_detector;
+}
+
+void Sensor::setFilter(FilterChain *filter)
+{
+    m_filter = filter;
+}
+
+void Sensor::setDetector(AnomalyDetector *detector)
+{
+    m_detector = detector;
+}
+
+void Sensor::readings(std::map<std::string, double> &values)
+{
+    values[m_config.name] = value();
+}
+
+Sample Sensor::current()
+{
+    int64_t time = m_sampleTime;
+    
+    return Sample(value(), raw(), time, time > 0 ? Sample::FRESH : 0);
+}
+
+/**
+ * \fn Sample Sensor::sample(int64_t staleMs)
+ * 
+ * The current sample with the stale and disabled bits worked out. A
+ * sensor that never read anything counts its age from when it was
+ * created, so it isn't stale before it's had a chance. 0 for staleMs
+ * never goes stale.
+ */
+Sample Sensor::sample(int64_t staleMs)
+{
+    Sample current = this->current();
+    int64_t since = current.time > 0 ? current.time : m_created;
+    
+    if (!enabled())
+        current.quality |= Sample::DISABLED;
+    if (m_calibrating)
+        current.quality |= Sample::CALIBRATING;
+    if (staleMs > 0 && Sample::now() - since > staleMs)
+        current.quality = (current.quality & ~Sample::FRESH) | Sample::STALE;
+    
+    return current;
+}
+
+/*
+ * period is how often the sensor is actually read, its interval or the
+ * acquisition cycle.
+ */
+int64_t Sensor::staleAfter(int period) const
+{
+    if (m_config.staleMs >= 0)
+        return m_config.staleMs;
+    
+    return period > 0 ? period + SENSOR_STALE_GRACE_MS : 0;
+}
+
+/*
+ * Every response goes through here so the stale check works the same
+ * for a sensor nobody set a callback on.
+ */
+void Sensor::notify(int cmd, std::string response)
+{
+    if (cmd == AtlasScientificI2C::READING) {
+        m_lastReading = std::time(nullptr);
+        m_sampleTime = Sample::now();
+        m_readingCount++;
+    }
+    
+    if (m_callback)
+        m_callback(this, cmd, response);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <ctime>
+#include <cstdint>
+#include <functional>
+
+#include "filterchain.h"
+#include "anomalydetector.h"
+#include "sample.h"
+
+#define SENSOR_STALE_GRACE_MS   60000
+
+/**
+ * \struct SensorConfig
+ * 
+ * One entry of the sensors list in the config file. The label is what
+ * shows up in log lines and error messages and defaults to the name.
+ * The filter and anomaly entries are looked up by name, and default to
+ * the sensor name too. An interval of 0 leaves the sensor unscheduled,
+ * -1 takes the default for its type. tank is the name of the tank the
+ * sensor belongs to. probes narrows a DS18B20 sensor to the named
+ * probes on the shared 1-wire bus, empty takes them all. A circuit
+ * behind a TCA9548A gives the mux address and its channel on it.
+ * 
+ * compensation names where the temperature for compensating readings
+ * comes from, a sensor or a DS18B20 probe name, empty for the first
+ * DS18B20 sensor in the tank. With perReadCompensation it goes along
+ * with every read instead of being pushed hourly.
+ * 
+ * staleMs is how old a value may get before it's flagged stale, -1
+ * takes however often the sensor is read plus a minute's grace and 0
+ * turns the check off.
+ */
+struct SensorConfig {
+    std::string type;
+    std::string name;
+    std::string label;
+    std::string tank;
+    int bus;
+    int address;
+    int channel;
+    int mux;
+    int muxChannel;
+    int interval;
+    int staleMs;
+    bool perReadCompensation;
+    std::string filter;
+    std::string anomaly;
+    std::string compensation;
+    std::vector<std::string> probes;
+    
+    SensorConfig() : bus(1), address(0), channel(0), mux(0), muxChannel(0), interval(-1), staleMs(-1), perReadCompensation(false) {}
+};
+
+/**
+ * \class Sensor
+ * 
+ * Base for anything the registry schedules. acquire() starts a reading
+ * and must not block for long, it's called from the scheduler thread
+ * for its bus. Sensors returning the same busId() are read one after
+ * another, different buses are read in parallel. route() is the mux
+ * and channel a sensor sits behind, -1 when it's wired straight to
+ * the bus. Results arrive through the callback with the same command
+ * codes the Atlas drivers use, so one handler covers every probe.
+ * 
+ * The sensor owns its filter chain and anomaly detector.
+ * 
+ * sample() is the value with its age and quality. Sensors that can
+ * tell a bad read from a good one override current(), the default
+ * takes value() as fresh as of the last reading.
+ */
+class Sensor
+{
+public:
+    typedef std::function<void(Sensor*, int, std::string)> Callback;
+    
+    Sensor(const SensorConfig &config);
+    virtual ~Sensor();
+    
+    std::string name() const { return m_config.name; }
+    std::string label() const { return m_config.label; }
+    std::string type() const { return m_config.type; }
+    std::string tank() const { return m_config.tank; }
+    const SensorConfig& config() const { return m_config; }
+    int interval() const { return m_config.interval; }
+    void setInterval(int ms) { m_config.interval = ms; }
+    
+    virtual std::string busId() const { return "i2c-" + std::to_string(m_config.bus); }
+    int route() const { return m_config.mux > 0 ? (m_config.mux << 8) | m_config.muxChannel : -1; }
+    virtual bool enabled() = 0;
+    virtual void start() {}
+    virtual void acquire() = 0;
+    virtual void acquire(double celsius) { acquire(); }
+    virtual double value() = 0;
+    virtual double raw() { return value(); }
+    virtual void readings(std::map<std::string, double> &values);
+    Sample sample(int64_t staleMs);
+    int64_t staleAfter(int period) const;
+    virtual void setTempCompensation(double celsius) {}
+    virtual bool calibrate(int cmd, double value) { return false; }
+    
+    virtual void setFilter(FilterChain *filter);
+    void setDetector(AnomalyDetector *detector);
+    FilterChain* filter() { return m_filter; }
+    AnomalyDetector* detector() { return m_detector; }
+    
+    void setCallback(Callback cbk) { m_callback = cbk; }
+    std::time_t lastReading() const { return m_lastReading; }
+    uint64_t readingCount() const { return m_readingCount; }
+    void setCalibrating(bool calibrating) { m_calibrating = calibrating; }
+    bool calibrating() const { return m_calibrating; }
+    
+protected:
+    virtual Sample current();
+    void notify(int cmd, std::string response);
+    
+    SensorConfig m_config;
+    FilterChain *m_filter;
+    AnomalyDetector *m_detector;
+    
+private:
+    Callback m_callback;
+    std::atomic<std::time_t> m_lastReading;
+    std::atomic<uint64_t> m_readingCount;
+    std::atomic<int64_t> m_sampleTime;
+    std::atomic<bool> m_calibrating;
+    int64_t m_created;
+};
+
+#endif // SENSOR_H
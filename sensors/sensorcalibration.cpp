@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sensorcalibration.h"
+#include "sensorregistry.h"
+#include "potentialhydrogen.h"
+#include "dissolvedoxygen.h"
+#include "logger.h"
+
+/**
+ * \fn bool SensorCalibration::plan(const std::string &type, CalibrationPlan &plan)
+ * 
+ * pH is the three buffers, mid first as the circuit wants, DO the one
+ * point in air. Returns false for types without a plan, their points
+ * need values only the person holding the solution knows.
+ */
+bool SensorCalibration::plan(const std::string &type, CalibrationPlan &plan)
+{
+    plan = CalibrationPlan();
+    
+    if (type == "ph") {
+        plan.slope = PH_STABLE_SLOPE;
+        plan.deviation = PH_STABLE_DEVIATION;
+        plan.points.push_back(CalibrationPoint(PotentialHydrogen::PH_MID, "pH 7.00", 7.00, PH_POINT_RANGE));
+        plan.points.push_back(CalibrationPoint(PotentialHydrogen::PH_LOW, "pH 4.00", 4.00, PH_POINT_RANGE));
+        plan.points.push_back(CalibrationPoint(PotentialHydrogen::PH_HIGH, "pH 10.00", 10.00, PH_POINT_RANGE));
+        return true;
+    }
+    if (type == "do") {
+        plan.slope = DO_STABLE_SLOPE;
+        plan.deviation = DO_STABLE_DEVIATION;
+        plan.points.push_back(CalibrationPoint(DissolvedOxygen::DO_DEFAULT, "Atmospheric oxygen"));
+        return true;
+    }
+    return false;
+}
+
+/*
+ * While boosted the scheduler does the reading and the engine only
+ * watches for new samples. Points are judged on the raw reading, the
+ * filters would only slow down seeing it settle. What's written is the
+ * engine's value for the point, the buffer's for pH, never the reading.
+ */
+SensorCalibration::SensorCalibration(Sensor *sensor, const CalibrationPlan &plan) :
+    m_sensor(sensor), m_plan(plan),
+    m_engine([this]() { if (!m_boosted) m_sensor->acquire(); return true; },
+             [this]() {
+                 Sample sample = m_sensor->sample(0);
+                 sample.value = sample.raw;
+                 sample.quality &= ~Sample::CALIBRATING;
+                 return sample;
+             },
+             [this](int cmd, double value) { return m_sensor->calibrate(cmd, value); })
+{
+    m_running = false;
+    m_boosted = false;
+    m_engine.setStability(plan.window, plan.slope, plan.deviation);
+    for (auto &point : plan.points)
+        m_engine.addPoint(point);
+}
+
+SensorCalibration::~SensorCalibration()
+{
+    abort();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void SensorCalibration::start()
+{
+    if (m_running || m_thread.joinable())
+        return;
+    
+    m_running = true;
+    m_engine.setProgress([this](CalibrationEngine::State state, const CalibrationPoint &point, const Sample &sample, const StabilityDetector &detector) {
+        if (m_progress)
+            m_progress(m_sensor, state, point, sample, detector);
+    });
+    m_thread = std::thread(&SensorCalibration::run, this);
+}
+
+void SensorCalibration::abort()
+{
+    m_engine.abort();
+}
+
+/*
+ * Blocks until the calibration finishes on its own.
+ */
+void SensorCalibration::wait()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+/*
+ * The sensor's samples are flagged for as long as it runs, and what the
+ * filters saw of the calibration solutions is thrown away at the end.
+ */
+void SensorCalibration::run()
+{
+    LOGN("Calibration started", "sensor", m_sensor->name(), "points", m_plan.points.size());
+    m_sensor->setCalibrating(true);
+    m_boosted = SensorRegistry::instance()->boost(m_sensor, CALIBRATION_INTERVAL_MS);
+    
+    bool complete = m_engine.run();
+    
+    if (m_boosted)
+        SensorRegistry::instance()->boost(m_sensor, 0);
+    m_boosted = false;
+    if (m_sensor->filter())
+        m_sensor->filter()->reset();
+    m_sensor->setCalibrating(false);
+    m_sensor->calibrate(EZO_CAL_QUERY, 0);
+    LOGN("Calibration finished", "sensor", m_sensor->name(), "complete", complete);
+    
+    m_running = false;
+    if (m_done)
+        m_done(m_sensor, complete, m_engine.results());
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SENSORCALIBRATION_H
+#define SENSORCALIBRATION_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "sensor.h"
+#include "calibrationengine.h"
+
+/*
+ * Default stability tolerances, a point is stored once the window of
+ * readings drifts less than the slope per minute and scatters less
+ * than the deviation, in the probe's units. Readings further than
+ * PH_POINT_RANGE from a pH buffer are taken as the probe not being in
+ * it yet.
+ */
+#define PH_STABLE_SLOPE         0.05
+#define PH_STABLE_DEVIATION     0.01
+#define PH_POINT_RANGE          1.5
+#define DO_STABLE_SLOPE         0.1
+#define DO_STABLE_DEVIATION     0.05
+
+/**
+ * \struct CalibrationPlan
+ * 
+ * The points a type of probe is calibrated with, in order, and how
+ * still the reading has to be for each.
+ */
+struct CalibrationPlan {
+    std::vector<CalibrationPoint> points;
+    int window;
+    double slope;
+    double deviation;
+    
+    CalibrationPlan() : window(CALIBRATION_WINDOW), slope(0), deviation(0) {}
+};
+
+/**
+ * \class SensorCalibration
+ * 
+ * Calibrates one sensor while the daemon keeps running. For as long as
+ * it runs the sensor is read every CALIBRATION_INTERVAL_MS by its bus
+ * scheduler, every other sensor keeps its schedule. A sensor without a
+ * scheduler is read from the calibration thread instead. Progress and
+ * done are called from that thread.
+ */
+class SensorCalibration
+{
+public:
+    typedef std::function<void(Sensor*, CalibrationEngine::State, const CalibrationPoint&, const Sample&, const StabilityDetector&)> Progress;
+    typedef std::function<void(Sensor*, bool, const std::vector<CalibrationResult>&)> Done;
+    
+    static bool plan(const std::string &type, CalibrationPlan &plan);
+    
+    SensorCalibration(Sensor *sensor, const CalibrationPlan &plan);
+    ~SensorCalibration();
+    
+    void setProgress(Progress progress) { m_progress = progress; }
+    void setDone(Done done) { m_done = done; }
+    void start();
+    void abort();
+    void wait();
+    bool running() const { return m_running; }
+    Sensor* sensor() { return m_sensor; }
+    
+private:
+    void run();
+    
+    Sensor *m_sensor;
+    CalibrationPlan m_plan;
+    CalibrationEngine m_engine;
+    Progress m_progress;
+    Done m_done;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_boosted;
+};
+
+#endif // SENSORCALIBRATION_H
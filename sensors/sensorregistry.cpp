@@ -0,0 +1,539 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <exception>
+
+#include "sensorregistry.h"
+#include "ezosensor.h"
+#include "ds18b20sensor.h"
+#include "adcsensor.h"
+#include "i2cmux.h"
+#include "sessionrecorder.h"
+#include "trace.h"
+#include "logger.h"
+
+/*
+ * The built in types are registered here and not from static objects
+ * in their own files, the linker drops those from a static library
+ * when nothing else references the object.
+ */
+SensorRegistry::SensorRegistry()
+{
+    m_running = false;
+    m_cycleMode = false;
+    m_cycleInterval = 0;
+    m_cycle = 0;
+    m_boosts = 0;
+    
+    registerType("ph", [](const SensorConfig &config) { return new PhSensor(config); }, 10000);
+    registerType("do", [](const SensorConfig &config) { return new DoSensor(config); }, 10000);
+    registerType("ec", [](const SensorConfig &config) { return new EcSensor(config); }, 10000);
+    registerType("orp", [](const SensorConfig &config) { return new OrpSensor(config); }, 10000);
+    registerType("rtd", [](const SensorConfig &config) { return new RtdSensor(config); }, 10000);
+    registerType("ds18b20", [](const SensorConfig &config) { return new Ds18b20Sensor(config); }, 60000);
+    registerType("mcp3008", [](const SensorConfig &config) { return new AdcSensor(config); }, 0);
+}
+
+SensorRegistry::~SensorRegistry()
+{
+    stop();
+}
+
+void SensorRegistry::registerType(std::string type, Factory factory, int interval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_types[type] = { factory, interval };
+}
+
+bool SensorRegistry::known(std::string type)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_types.find(type) != m_types.end();
+}
+
+/**
+ * \fn Sensor* SensorRegistry::create(SensorConfig config)
+ * 
+ * Build a sensor from its config entry and add it to the registry.
+ * Returns nullptr for a type nobody registered or a duplicate name.
+ */
+Sensor* SensorRegistry::create(SensorConfig config)
+{
+    Factory factory;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_types.find(config.type);
+        if (it == m_types.end()) {
+            LOGW("No driver for sensor type", "sensor", config.name, "type", config.type);
+            return nullptr;
+        }
+        for (auto sensor : m_sensors) {
+            if (sensor->name() == config.name) {
+                LOGE("Duplicate sensor name", "sensor", config.name);
+                return nullptr;
+            }
+        }
+        factory = it->second.factory;
+        if (config.interval < 0)
+            config.interval = it->second.interval;
+    }
+    
+    Sensor *sensor = factory(config);
+    add(sensor);
+    LOGI("Sensor", "sensor", config.name, "tank", config.tank, "type", config.type, "bus", config.bus, "address", config.address, "mux", config.mux, "mux_channel", config.muxChannel, "interval_ms", config.interval);
+    return sensor;
+}
+
+void SensorRegistry::add(Sensor *sensor)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sensors.push_back(sensor);
+}
+
+/*
+ * Stops the scheduler and deletes every sensor and tank, used when the
+ * config is read again.
+ */
+void SensorRegistry::clear()
+{
+    stop();
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto sensor : m_sensors)
+        delete sensor;
+    m_sensors.clear();
+    m_tanks.clear();
+}
+
+void SensorRegistry::addTank(TankConfig tank)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &t : m_tanks) {
+        if (t.name == tank.name) {
+            LOGE("Duplicate tank name", "tank", tank.name);
+            return;
+        }
+    }
+    LOGI("Tank", "tank", tank.name, "topic", tank.topic, "feed", tank.feed, "bus", tank.bus);
+    m_tanks.push_back(tank);
+}
+
+/*
+ * Config order, the first tank also carries the daemon wide state like
+ * the pump and the overflow switches.
+ */
+std::vector<TankConfig> SensorRegistry::tanks()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tanks;
+}
+
+/*
+ * An unknown name gets the defaults rather than nothing, sensors built
+ * without a tank still publish somewhere sensible.
+ */
+TankConfig SensorRegistry::tank(std::string name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &t : m_tanks) {
+        if (t.name == name)
+            return t;
+    }
+    return TankConfig();
+}
+
+Sensor* SensorRegistry::find(std::string name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto sensor : m_sensors) {
+        if (sensor->name() == name)
+            return sensor;
+    }
+    return nullptr;
+}
+
+/*
+ * The first sensor of a type in config order, in the given tank or in
+ * any tank if none is given. The data and AIO messages only have room
+ * for one pH and one DO value per tank.
+ */
+Sensor* SensorRegistry::primary(std::string type, std::string tank)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto sensor : m_sensors) {
+        if (sensor->type() == type && (tank.empty() || sensor->tank() == tank))
+            return sensor;
+    }
+    return nullptr;
+}
+
+std::vector<Sensor*> SensorRegistry::sensors()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sensors;
+}
+
+std::vector<Sensor*> SensorRegistry::sensors(std::string type)
+{
+    std::vector<Sensor*> result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    for (auto sensor : m_sensors) {
+        if (sensor->type() == type)
+            result.push_back(sensor);
+    }
+    return result;
+}
+
+std::vector<Sensor*> SensorRegistry::inTank(std::string tank)
+{
+    std::vector<Sensor*> result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    for (auto sensor : m_sensors) {
+        if (sensor->tank() == tank)
+            result.push_back(sensor);
+    }
+    return result;
+}
+
+/**
+ * \fn double SensorRegistry::compensation(Sensor *sensor)
+ * 
+ * The temperature a sensor's readings should be compensated to, from
+ * the source in its config. That's the sample of the sensor with that
+ * name, or failing that the DS18B20 probe with that name, or with no
+ * source the first DS18B20 sensor in its tank. NAN unless the sample
+ * is good, a source that stopped answering goes stale and the probe
+ * falls back to a plain read.
+ */
+double SensorRegistry::compensation(Sensor *sensor)
+{
+    std::string source = sensor->config().compensation;
+    Sample sample;
+    
+    if (source.empty()) {
+        if (Sensor *bus = primary("ds18b20", sensor->tank()))
+            sample = bus->sample(staleAfter(bus));
+    }
+    else if (Sensor *named = find(source)) {
+        sample = named->sample(staleAfter(named));
+    }
+    else {
+        for (auto bus : sensors("ds18b20")) {
+            Ds18b20Sensor *probes = dynamic_cast<Ds18b20Sensor*>(bus);
+            if (probes && probes->probe(source, staleAfter(bus), sample))
+                break;
+        }
+    }
+    
+    return sample.good() ? sample.value : NAN;
+}
+
+/*
+ * How old a source's sample may be, it's read every cycle in cycle
+ * mode and on its own interval otherwise.
+ */
+int64_t SensorRegistry::staleAfter(Sensor *sensor)
+{
+    int period;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        period = m_cycleMode && m_cycleInterval > 0 ? m_cycleInterval : sensor->interval();
+    }
+    return SessionRecorder::instance()->scale(static_cast<int>(sensor->staleAfter(period)));
+}
+
+/*
+ * Only takes effect on the next start(). interval is how often the
+ * cycle triggers a read, for the stale check on compensation sources.
+ */
+void SensorRegistry::setCycleMode(bool cycle, int interval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cycleMode = cycle;
+    m_cycleInterval = interval;
+}
+
+/*
+ * Starts a read of every sensor on every bus, cycle mode only.
+ */
+void SensorRegistry::trigger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cycle++;
+    }
+    m_cv.notify_all();
+}
+
+/**
+ * \fn bool SensorRegistry::boost(Sensor *sensor, int interval)
+ * 
+ * Reads sensor every interval ms from now on, or goes back to its own
+ * schedule for an interval of 0. Returns false if the sensor isn't on
+ * any bus scheduler, it has to be read by whoever wanted it faster.
+ */
+bool SensorRegistry::boost(Sensor *sensor, int interval)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || std::find(m_scheduled.begin(), m_scheduled.end(), sensor) == m_scheduled.end())
+            return false;
+        
+        if (interval > 0)
+            m_boost[sensor] = interval;
+        else
+            m_boost.erase(sensor);
+        m_boosts++;
+    }
+    m_cv.notify_all();
+    return true;
+}
+
+/**
+ * \fn void SensorRegistry::start()
+ * 
+ * Starts every enabled sensor, then one scheduler thread for each bus
+ * that has a scheduled sensor on it. In cycle mode every enabled
+ * sensor is scheduled.
+ */
+void SensorRegistry::start()
+{
+    std::map<std::string, std::vector<Sensor*>> buses;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running)
+            return;
+        m_running = true;
+    }
+    
+    for (auto sensor : sensors()) {
+        if (!sensor->enabled())
+            continue;
+        
+        sensor->start();
+        if (sensor->interval() > 0 || m_cycleMode)
+            buses[sensor->busId()].push_back(sensor);
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &bus : buses) {
+        m_scheduled.insert(m_scheduled.end(), bus.second.begin(), bus.second.end());
+        m_threads.emplace_back(&SensorRegistry::run, this, bus.first, bus.second);
+    }
+    LOGI("Sensor scheduler started", "buses", m_threads.size());
+}
+
+void SensorRegistry::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    for (auto &thread : m_threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+    m_threads.clear();
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_scheduled.clear();
+    m_boost.clear();
+}
+
+/*
+ * Pick what to read next on a bus. Normally the slot due soonest, but
+ * with circuits behind a mux a slot on the channel already selected is
+ * pulled forward by up to SENSOR_MUX_WINDOW_MS rather than switching
+ * away and back. Nothing is left waiting more than the window past its
+ * due time for that, and a slot read early keeps its cadence since the
+ * next read is timed from when it was due.
+ */
+SensorRegistry::Slot* SensorRegistry::pick(std::vector<Slot> &slots, int route, std::chrono::steady_clock::time_point now, std::chrono::milliseconds window)
+{
+    Slot *next = nullptr;
+    
+    for (auto &slot : slots) {
+        if (!slot.idle && (next == nullptr || slot.due < next->due))
+            next = &slot;
+    }
+    
+    if (next == nullptr || route < 0 || next->route < 0 || next->route == route || now - next->due > window)
+        return next;
+    
+    Slot *same = nullptr;
+    auto horizon = std::max(now, next->due) + window;
+    for (auto &slot : slots) {
+        if (!slot.idle && slot.route == route && slot.due <= horizon && (same == nullptr || slot.due < same->due))
+            same = &slot;
+    }
+    return same ? same : next;
+}
+
+void SensorRegistry::run(std::string bus, std::vector<Sensor*> sensors)
+{
+    std::vector<Slot> slots;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds window(SessionRecorder::instance()->scale(SENSOR_MUX_WINDOW_MS));
+    bool muxed = false;
+    bool cycleMode;
+    uint64_t cycle;
+    uint64_t boosts;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        cycleMode = m_cycleMode;
+        cycle = m_cycle;
+        // One behind, so a boost made before this thread got going is applied
+        boosts = m_boosts - 1;
+    }
+    
+    for (auto sensor : sensors) {
+        std::chrono::milliseconds stagger(SessionRecorder::instance()->scale(static_cast<int>(SENSOR_STAGGER_MS * slots.size())));
+        std::chrono::milliseconds interval(SessionRecorder::instance()->scale(sensor->interval()));
+        slots.push_back({ now + stagger, interval, sensor, sensor->route(), false, cycleMode, false });
+        if (sensor->route() >= 0)
+            muxed = true;
+    }
+    LOGI("Bus scheduler started", "bus", bus, "scheduled", slots.size(), "muxed", muxed);
+    
+    /*
+     * A cycle is every sensor on the bus read once. With a mux the
+     * channel switches it took, reads included, go out per cycle.
+     */
+    Gauge *cycleSwitches = nullptr;
+    int number = sensors.size() ? sensors.front()->config().bus : 0;
+    uint64_t cycleStart = 0;
+    size_t remaining = slots.size();
+    int route = -1;
+    
+    if (muxed) {
+        cycleSwitches = MetricsRegistry::instance()->gauge("aquarium_i2c_mux_switches_per_cycle", "Mux channel switches in the last full read cycle of a bus", "bus=\"" + std::to_string(number) + "\"");
+        cycleStart = I2cMux::switches(number);
+    }
+    
+    auto triggered = [this, &cycle, &boosts]() { return !m_running || m_cycle != cycle || m_boosts != boosts; };
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running && slots.size()) {
+        if (m_cycle != cycle) {
+            cycle = m_cycle;
+            now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < slots.size() && cycleMode; i++) {
+                slots[i].due = now + std::chrono::milliseconds(SessionRecorder::instance()->scale(static_cast<int>(SENSOR_STAGGER_MS * i)));
+                slots[i].idle = false;
+            }
+        }
+        
+        /*
+         * A boosted slot is read straight away and then at its boost
+         * interval. Once the boost ends it goes back to its own
+         * interval, or to waiting for a trigger in cycle mode.
+         */
+        if (m_boosts != boosts) {
+            boosts = m_boosts;
+            now = std::chrono::steady_clock::now();
+            for (auto &slot : slots) {
+                auto it = m_boost.find(slot.sensor);
+                bool boosted = it != m_boost.end();
+                int interval = boosted ? it->second : slot.sensor->interval();
+                
+                if (boosted == slot.boosted && (!boosted || slot.interval.count() == SessionRecorder::instance()->scale(interval)))
+                    continue;
+                
+                slot.interval = std::chrono::milliseconds(SessionRecorder::instance()->scale(interval));
+                slot.due = boosted ? now : now + slot.interval;
+                slot.idle = !boosted && cycleMode;
+                slot.boosted = boosted;
+                LOGI("Sensor read interval changed", "sensor", slot.sensor->name(), "interval_ms", interval, "boosted", boosted);
+            }
+        }
+        
+        Slot *next = nullptr;
+        for (auto &slot : slots) {
+            if (!slot.idle && (next == nullptr || slot.due < next->due))
+                next = &slot;
+        }
+        
+        if (next == nullptr) {
+            m_cv.wait(lock, triggered);
+            continue;
+        }
+        if (m_cv.wait_until(lock, next->due, triggered))
+            continue;
+        
+        now = std::chrono::steady_clock::now();
+        if (muxed)
+            next = pick(slots, route, now, window);
+        
+        lock.unlock();
+        {
+            TRACE_SCOPE("SensorRegistry::acquire");
+            try {
+                double celsius = next->sensor->config().perReadCompensation ? compensation(next->sensor) : NAN;
+                if (std::isnan(celsius))
+                    next->sensor->acquire();
+                else
+                    next->sensor->acquire(celsius);
+            }
+            catch (std::exception &e) {
+                LOGE("Sensor acquire failed", "sensor", next->sensor->name(), "error", e.what());
+            }
+        }
+        if (next->route >= 0)
+            route = next->route;
+        
+        now = std::chrono::steady_clock::now();
+        next->due += next->interval;
+        if (next->due < now)
+            next->due = now + next->interval;
+        next->idle = cycleMode && !next->boosted;
+        
+        if (!next->read) {
+            next->read = true;
+            remaining--;
+        }
+        if (remaining == 0) {
+            if (muxed) {
+                uint64_t switches = I2cMux::switches(number);
+                cycleSwitches->set(static_cast<int64_t>(switches - cycleStart));
+                LOGD("Mux read cycle", "bus", bus, "sensors", slots.size(), "switches", switches - cycleStart);
+                cycleStart = switches;
+            }
+            for (auto &slot : slots)
+                slot.read = false;
+            remaining = slots.size();
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SENSORREGISTRY_H
+#define SENSORREGISTRY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+#include "sensor.h"
+#include "tank.h"
+
+#define SENSOR_STAGGER_MS       250
+#define SENSOR_MUX_WINDOW_MS    1000
+
+/**
+ * \class SensorRegistry
+ * 
+ * Sensor types register a factory and the interval they are read at by
+ * default. The config file asks for instances by type, as many as it
+ * likes on whatever bus and address, and everything that reads or
+ * publishes probe data walks the list here instead of naming probes.
+ * 
+ * Each bus gets its own scheduler thread, so a slow probe on one bus
+ * never holds up another bus. First reads on a bus are staggered so a
+ * dozen probes on it don't all start a command in the same tick, after
+ * that each keeps its own interval. A sensor that falls behind skips
+ * the missed reads rather than bursting to catch up. On a bus with a
+ * TCA9548A the order is bent, within SENSOR_MUX_WINDOW_MS, to stay on
+ * the channel already selected, and the switches each full read cycle
+ * took are published as a gauge. Sensors set for per read
+ * compensation are handed the current temperature from their
+ * compensation source with each acquire.
+ * 
+ * In cycle mode sensors have no schedule of their own, every enabled
+ * sensor is read once each time trigger() is called, still staggered
+ * and in mux order within its bus.
+ * 
+ * boost() puts one sensor on an interval of its own for a while, in
+ * either mode, without touching the rest of its bus.
+ * 
+ * Tanks are kept here too, every sensor belongs to one of them.
+ */
+class SensorRegistry
+{
+public:
+    typedef std::function<Sensor*(const SensorConfig&)> Factory;
+    
+    static SensorRegistry* instance()
+    {
+        static SensorRegistry instance;
+        return &instance;
+    }
+    
+    void registerType(std::string type, Factory factory, int interval);
+    bool known(std::string type);
+    Sensor* create(SensorConfig config);
+    void add(Sensor *sensor);
+    void clear();
+    
+    void addTank(TankConfig tank);
+    std::vector<TankConfig> tanks();
+    TankConfig tank(std::string name);
+    
+    Sensor* find(std::string name);
+    Sensor* primary(std::string type, std::string tank = std::string());
+    std::vector<Sensor*> sensors();
+    std::vector<Sensor*> sensors(std::string type);
+    std::vector<Sensor*> inTank(std::string tank);
+    double compensation(Sensor *sensor);
+    
+    template<typename T> T* first()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto sensor : m_sensors) {
+            if (T *t = dynamic_cast<T*>(sensor))
+                return t;
+        }
+        return nullptr;
+    }
+    
+    void setCycleMode(bool cycle, int interval = 0);
+    void trigger();
+    bool boost(Sensor *sensor, int interval);
+    void start();
+    void stop();
+    
+private:
+    SensorRegistry();
+    ~SensorRegistry();
+    SensorRegistry& operator=(SensorRegistry const&) {return *this;}
+    SensorRegistry(SensorRegistry&);
+    
+    struct Slot {
+        std::chrono::steady_clock::time_point due;
+        std::chrono::milliseconds interval;
+        Sensor *sensor;
+        int route;
+        bool read;
+        bool idle;
+        bool boosted;
+    };
+    
+    void run(std::string bus, std::vector<Sensor*> sensors);
+    int64_t staleAfter(Sensor *sensor);
+    static Slot* pick(std::vector<Slot> &slots, int route, std::chrono::steady_clock::time_point now, std::chrono::milliseconds window);
+    
+    struct Type {
+        Factory factory;
+        int interval;
+    };
+    
+    std::map<std::string, Type> m_types;
+    std::vector<Sensor*> m_sensors;
+    std::vector<TankConfig> m_tanks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_threads;
+    bool m_running;
+    bool m_cycleMode;
+    int m_cycleInterval;
+    uint64_t m_cycle;
+    std::vector<Sensor*> m_scheduled;
+    std::map<Sensor*, int> m_boost;
+    uint64_t m_boosts;
+};
+
+#endif // SENSORREGISTRY_H
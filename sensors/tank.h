@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TANK_H
+#define TANK_H
+
+#include <string>
+
+/**
+ * \struct TankConfig
+ * 
+ * One logical tank. Its sensors publish under topic on the local broker
+ * and under feed on AIO, and take bus unless their own entry names
+ * one. level is the name of the sensor used as its water level.
+ * compensation and perReadCompensation are the defaults for its
+ * sensors, see SensorConfig. A
+ * config without a tanks list gets a single tank with the defaults,
+ * which are the topics the daemon has always used.
+ */
+struct TankConfig {
+    std::string name;
+    std::string topic;
+    std::string feed;
+    std::string level;
+    std::string compensation;
+    int bus;
+    bool perReadCompensation;
+    
+    TankConfig() : name("aquarium"), topic("aquarium2"), feed("pbuelow/feeds/aquarium"), level("waterlevel"), bus(1), perReadCompensation(false) {}
+};
+
+#endif // TANK_H
@@ -24,44 +24,61 @@
  */
 
 #include "temperature.h"
+#include "trace.h"
+#include "logger.h"
 
 Temperature::Temperature()
 {
     m_enabled = false;
     std::vector<std::string> v;
     
-    DIR* dirp = opendir("/sys/bus/w1/devices/");
-    struct dirent * dp;
-    while ((dp = readdir(dirp)) != NULL) {
-        v.push_back(dp->d_name);
+    initializeMetrics();
+    
+    if (SessionRecorder::instance()->replaying()) {
+        v = SessionRecorder::instance()->w1Devices();
+    }
+    else {
+        DIR* dirp = opendir("/sys/bus/w1/devices/");
+        struct dirent * dp;
+        if (dirp != NULL) {
+            while ((dp = readdir(dirp)) != NULL) {
+                v.push_back(dp->d_name);
+            }
+            closedir(dirp);
+        }
     }
-    closedir(dirp);
     
     for (std::vector<std::string>::size_type i = 0; i < v.size(); i++) {
         if (v.at(i).find("28-") != std::string::npos) {
             m_devices[v.at(i)] = v.at(i);
-            syslog(LOG_INFO, "Found DS18B20 device %s", v.at(i).c_str());
-            std::cout << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Found DS18B20 device " << v.at(i).c_str() << std::endl;
+            LOGI("Found DS18B20 device", "device", v.at(i));
         }
     }
     if (m_devices.size() > 0)
         m_enabled = true;
     else
-        syslog(LOG_ERR, "No 1-wire devices found");
+        LOGE("No 1-wire devices found");
     
-    std::cout  << __PRETTY_FUNCTION__ << ":" << __LINE__ << ": Found " << m_devices.size() << " devices" << std::endl;
+    LOGI("DS18B20 scan complete", "devices", m_devices.size());
 }
 
 Temperature::Temperature(std::string device, std::string name)
 {
     m_devices[device] = name;
     m_enabled = true;
+    initializeMetrics();
 }
 
 Temperature::~Temperature()
 {
 }
 
+void Temperature::initializeMetrics()
+{
+    m_readLatency = MetricsRegistry::instance()->histogram("aquarium_w1_read_seconds", "Time to read and convert a DS18B20 w1_slave file");
+    m_readErrors = MetricsRegistry::instance()->counter("aquarium_w1_errors_total", "DS18B20 reads that could not be opened or decoded");
+}
+
 std::string Temperature::deviceName(std::string device)
 {
     std::string d;
@@ -79,44 +96,92 @@ double Temperature::getTemperatureByName(std::string name)
     
     while (it != m_devices.end()) {
         if (it->second == name)
-            return getTemperature(it->first);
+            return getTemperatureByDevice(it->first);
     }
     return 0;
 }
 
 double Temperature::getTemperatureByDevice(std::string device)
 {
-    auto it = m_devices.find(device);
+    double celsius = 0;
     
-    if (it != m_devices.end()) {
-        return getTemperature(device);
-    }
-    return 0;
+    getTemperatureByDevice(device, celsius);
+    return celsius;
 }
 
-double Temperature::getTemperature(std::string device)
+/**
+ * \fn bool Temperature::getTemperatureByDevice(std::string device, double &celsius)
+ * 
+ * Same read, but tells a failed one apart from a reading of 0. celsius
+ * is left alone when it returns false.
+ */
+bool Temperature::getTemperatureByDevice(std::string device, double &celsius)
 {
+    if (m_devices.find(device) == m_devices.end())
+        return false;
+    
+    return getTemperature(device, celsius);
+}
+
+bool Temperature::getTemperature(std::string device, double &celsius)
+{
+    TRACE_SCOPE("Temperature::getTemperature");
     std::string path = "/sys/bus/w1/devices/" + device + "/w1_slave";
-    std::ifstream fs(path);
     std::stringstream contents;
     std::string data;
-        
-    if (fs.is_open() && m_enabled) {
-        contents << fs.rdbuf();
-        std::string::size_type pos = contents.str().find("t=");
-        if (pos != std::string::npos) {
-            data = contents.str().substr(pos + 2, 5);
-        }
-        try {
-            double t = std::stof(data);
-            return (t / 1000);
-        }
-        catch (std::exception &e) {
-            syslog(LOG_ERR, "Unable to decode %s, exception is %s\n", data.c_str(), e.what());
-            std::cerr  << __PRETTY_FUNCTION__ << ":" << __LINE__ << "Unable to decode " << data << std::endl;
+    bool haveData = false;
+    auto start = std::chrono::steady_clock::now();
+    
+    if (!m_enabled)
+        return false;
+    
+    if (SessionRecorder::instance()->replaying()) {
+        haveData = SessionRecorder::instance()->nextW1Read(device, data);
+        contents << data;
+        data.clear();
+    }
+    else {
+        std::ifstream fs(path);
+        if (fs.is_open()) {
+            contents << fs.rdbuf();
+            SessionRecorder::instance()->recordW1Read(device, contents.str());
+            haveData = true;
         }
     }
-    return 0;
+    
+    m_readLatency->observeSince(start);
+    
+    if (haveData) {
+        if (parse(contents.str(), celsius))
+            return true;
+        
+        LOGE("Unable to decode", "device", device, "contents", contents.str());
+    }
+    m_readErrors->inc();
+    return false;
+}
+
+/**
+ * \fn bool Temperature::parse(const std::string &contents, double &celsius)
+ * 
+ * Pull the temperature out of a w1_slave file, the value after t= is in
+ * thousandths of a degree. Returns false if it isn't there or isn't a
+ * number.
+ */
+bool Temperature::parse(const std::string &contents, double &celsius)
+{
+    std::string::size_type pos = contents.find("t=");
+    
+    if (pos == std::string::npos)
+        return false;
+    
+    try {
+        celsius = std::stof(contents.substr(pos + 2, 5)) / 1000;
+        return true;
+    }
+    catch (std::exception &e) {
+        return false;
+    }
 }
 
 bool Temperature::setNameForDevice(std::string device, std::string name)
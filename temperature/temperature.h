@@ -36,6 +36,9 @@
 #include <sys/types.h>
 #include <dirent.h>
 
+#include "sessionrecorder.h"
+#include "metrics.h"
+
 class Temperature
 {
 public:
@@ -43,12 +46,13 @@ public:
     Temperature(std::string, std::string);
     ~Temperature();
     
-    double convertToFarenheit(double c)
+    static double convertToFarenheit(double c)
     {
         return ((c * 1.8) + 32);
     }
     
     double getTemperatureByDevice(std::string device);
+    bool getTemperatureByDevice(std::string device, double &celsius);
     double getTemperatureByName(std::string name);
     void getAllTemperatures(std::map<std::string, double> &devices);
     bool enabled() { return m_enabled; }
@@ -57,10 +61,15 @@ public:
     bool setNameForDevice(std::string name, std::string device);
     std::string deviceName(std::string);
     
+    static bool parse(const std::string &contents, double &celsius);
+    
 private:
-    double getTemperature(std::string device);
+    bool getTemperature(std::string device, double &celsius);
+    void initializeMetrics();
     std::map<std::string, std::string> m_devices;
     bool m_enabled;
+    Histogram *m_readLatency;
+    Counter *m_readErrors;
 };
 
 #endif // TEMPERATURE_H
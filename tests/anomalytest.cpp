@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+#include "anomalydetector.h"
+#include "check.h"
+
+/*
+ * Replays recorded probe history through the detector the way the
+ * daemon feeds it, one sample at a time with the sample's own time.
+ * Each line is time,value[,level]. Where a level is given it's what
+ * the detector should report after that sample, so a recording only
+ * needs annotating at the points that matter. Lines starting with #
+ * are comments.
+ */
+static void replay(AnomalyDetector &detector, const std::string &path)
+{
+    std::ifstream history(path);
+    std::string line;
+    int number = 0;
+    int checked = 0;
+    int raised = 0;
+    
+    CHECK(history.is_open());
+    
+    while (std::getline(history, line)) {
+        number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        
+        std::stringstream fields(line);
+        std::string when, value, level;
+        std::getline(fields, when, ',');
+        std::getline(fields, value, ',');
+        std::getline(fields, level, ',');
+        
+        detector.update(std::stod(value), static_cast<time_t>(std::stoll(when)));
+        if (detector.changed()) {
+            if (detector.level() > AnomalyDetector::NORMAL) {
+                CHECK(!detector.reason().empty());
+                raised++;
+            }
+            std::cout << path << ":" << number << ": " << detector.name() << " level " << detector.level() << " " << detector.reason() << std::endl;
+        }
+        if (!level.empty()) {
+            if (detector.level() != std::stoi(level))
+                std::cerr << path << ":" << number << ": expected level " << level << ", got " << detector.level() << std::endl;
+            CHECK(detector.level() == std::stoi(level));
+            checked++;
+        }
+    }
+    CHECK(checked > 0);
+    CHECK(raised > 0);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <history.csv>" << std::endl;
+        return 1;
+    }
+    
+    /* The baseline buckets by local hour, keep that stable */
+    setenv("TZ", "UTC", 1);
+    tzset();
+    
+    /* The pH limits from aquarium.conf */
+    AnomalyDetector ph("ph");
+    ph.enableRateOfChange(0.2, 0.5);
+    ph.enableCusum(0.05, 0.5);
+    replay(ph, argv[1]);
+    
+    return check::failures();
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <vector>
+#include <utility>
+
+#include "calibrationengine.h"
+#include "check.h"
+
+/*
+ * A probe that reads a little off from each solution it's placed in.
+ * Every read is a new sample, every calibration moves it on to the
+ * next solution.
+ */
+struct FakeProbe {
+    std::vector<double> readings;
+    std::vector<std::pair<int, double>> written;
+    int64_t time = 0;
+    
+    CalibrationEngine engine()
+    {
+        return CalibrationEngine([this]() { time += 1000; return true; },
+                                 [this]() {
+                                     double value = readings[std::min(written.size(), readings.size() - 1)];
+                                     return Sample(value, value, time, Sample::FRESH);
+                                 },
+                                 [this](int cmd, double value) { written.push_back(std::make_pair(cmd, value)); return true; });
+    }
+};
+
+/*
+ * Points with an expected value write the solution's value, whatever
+ * the probe read while settling in it.
+ */
+static void testWritesExpectedValue()
+{
+    FakeProbe probe;
+    probe.readings = { 6.83, 4.12, 10.31 };
+    
+    CalibrationEngine engine = probe.engine();
+    engine.setStability(3, 0.05, 0.01);
+    engine.setInterval(0);
+    engine.addPoint(CalibrationPoint(102, "pH 7.00", 7.00, 1.5));
+    engine.addPoint(CalibrationPoint(101, "pH 4.00", 4.00, 1.5));
+    engine.addPoint(CalibrationPoint(103, "pH 10.00", 10.00, 1.5));
+    
+    CHECK(engine.run());
+    CHECK(probe.written.size() == 3);
+    if (probe.written.size() == 3) {
+        CHECK(probe.written[0].first == 102);
+        CHECK_NEAR(probe.written[0].second, 7.00, 1e-9);
+        CHECK(probe.written[1].first == 101);
+        CHECK_NEAR(probe.written[1].second, 4.00, 1e-9);
+        CHECK(probe.written[2].first == 103);
+        CHECK_NEAR(probe.written[2].second, 10.00, 1e-9);
+    }
+    
+    const std::vector<CalibrationResult> &results = engine.results();
+    CHECK(results.size() == 3);
+    if (results.size() == 3) {
+        CHECK(results[0].accepted);
+        CHECK_NEAR(results[0].value, 7.00, 1e-9);
+        CHECK_NEAR(results[0].reading, 6.83, 1e-9);
+        CHECK_NEAR(results[1].reading, 4.12, 1e-9);
+    }
+}
+
+/*
+ * A point without a value, DO's Cal, gets the settled reading.
+ */
+static void testWritesReadingWithoutExpected()
+{
+    FakeProbe probe;
+    probe.readings = { 8.42 };
+    
+    CalibrationEngine engine = probe.engine();
+    engine.setStability(3, 0.1, 0.05);
+    engine.setInterval(0);
+    engine.addPoint(CalibrationPoint(101, "Atmospheric oxygen"));
+    
+    CHECK(engine.run());
+    CHECK(probe.written.size() == 1);
+    if (probe.written.size() == 1) {
+        CHECK(probe.written[0].first == 101);
+        CHECK_NEAR(probe.written[0].second, 8.42, 1e-9);
+    }
+}
+
+int main()
+{
+    testWritesExpectedValue();
+    testWritesReadingWithoutExpected();
+    return check::failures();
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <thread>
+#include <chrono>
+
+#include "gpio.h"
+#include "fakegpiobackend.h"
+#include "gpiodebouncer.h"
+#include "pumpcontroller.h"
+#include "check.h"
+
+#define PUMP_PIN        11
+#define OVERFLOW_PIN    9
+#define DEBOUNCE_MS     20
+
+/*
+ * Waits for the pump thread to catch up, up to a second.
+ */
+template<typename F> static bool eventually(F condition)
+{
+    for (int i = 0; i < 100; i++) {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+/*
+ * The pump and debouncer wired up as the daemon does it, raw rising
+ * edges to overflow(), settled and bounced lows to overflowCleared().
+ */
+struct Rig {
+    FakeGpioBackend *backend;
+    GpioDebouncer debouncer;
+    PumpController pump;
+    
+    Rig() : backend(new FakeGpioBackend()), pump(PUMP_PIN, 80, 10)
+    {
+        Gpio::instance()->setBackend(backend);
+        auto cleared = [this](GpioEvent event) {
+            if (event.value == 0)
+                pump.overflowCleared(event.pin);
+        };
+        debouncer.addPin(OVERFLOW_PIN, DEBOUNCE_MS, 0, cleared, cleared);
+        backend->watch(OVERFLOW_PIN, GpioBackend::BOTH, [this](GpioEvent event) {
+            if (event.value == 1)
+                pump.overflow(event.pin, event.timestamp);
+            debouncer.push(event);
+        });
+        pump.start();
+    }
+    
+    ~Rig()
+    {
+        pump.stop();
+        debouncer.stop();
+    }
+};
+
+/*
+ * A spike shorter than the window stops the pump on its edge, and the
+ * pump runs again once the window closes on a low line.
+ */
+static void testGlitchReleasesInterlock()
+{
+    Rig rig;
+    
+    CHECK(eventually([&]() { return rig.pump.running(); }));
+    rig.backend->inject(OVERFLOW_PIN, 1);
+    rig.backend->inject(OVERFLOW_PIN, 0);
+    CHECK(rig.pump.interlocks() & PumpController::OVERFLOW);
+    
+    CHECK(eventually([&]() { return rig.pump.interlocks() == PumpController::NONE; }));
+    CHECK(eventually([&]() { return rig.pump.running(); }));
+    CHECK(rig.debouncer.stats().changes == 0);
+}
+
+/*
+ * A real high holds the interlock until the line settles low again.
+ */
+static void testOverflowHolds()
+{
+    Rig rig;
+    
+    CHECK(eventually([&]() { return rig.pump.running(); }));
+    rig.backend->inject(OVERFLOW_PIN, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(DEBOUNCE_MS * 4));
+    CHECK(rig.pump.interlocks() & PumpController::OVERFLOW);
+    CHECK(!rig.pump.running());
+    
+    rig.backend->inject(OVERFLOW_PIN, 0);
+    CHECK(eventually([&]() { return rig.pump.running(); }));
+}
+
+int main()
+{
+    testGlitchReleasesInterlock();
+    testOverflowHolds();
+    return check::failures();
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <vector>
+#include <utility>
+
+#include "sensorcalibration.h"
+#include "atlasscientifici2c.h"
+#include "ezotraits.h"
+#include "check.h"
+
+/*
+ * A pH circuit reading a little off in each buffer, moving on to the
+ * next buffer as each point is written.
+ */
+class FakePh : public Sensor
+{
+public:
+    FakePh(const SensorConfig &config) : Sensor(config) {}
+    
+    bool enabled() override { return true; }
+    void acquire() override { notify(AtlasScientificI2C::READING, "reading"); }
+    double value() override { return m_readings[std::min<size_t>(m_written.size(), 2)]; }
+    
+    bool calibrate(int cmd, double value) override
+    {
+        if (cmd != EZO_CAL_QUERY)
+            m_written.push_back(std::make_pair(cmd, value));
+        return true;
+    }
+    
+    std::vector<std::pair<int, double>> m_written;
+    
+private:
+    double m_readings[3] = { 6.83, 4.12, 10.31 };
+};
+
+/*
+ * The daemon's pH plan, what calibrate/<sensor>/start runs, has to hand
+ * the circuit the buffer values.
+ */
+static void testPhPlanWritesBuffers()
+{
+    SensorConfig config;
+    config.type = "ph";
+    config.name = "ph";
+    FakePh probe(config);
+    
+    CalibrationPlan plan;
+    CHECK(SensorCalibration::plan("ph", plan));
+    plan.window = 3;
+    
+    bool complete = false;
+    std::vector<CalibrationResult> results;
+    SensorCalibration calibration(&probe, plan);
+    calibration.setDone([&](Sensor*, bool c, const std::vector<CalibrationResult> &r) { complete = c; results = r; });
+    calibration.start();
+    calibration.wait();
+    
+    CHECK(complete);
+    CHECK(probe.m_written.size() == 3);
+    if (probe.m_written.size() == 3) {
+        CHECK_NEAR(probe.m_written[0].second, 7.00, 1e-9);
+        CHECK_NEAR(probe.m_written[1].second, 4.00, 1e-9);
+        CHECK_NEAR(probe.m_written[2].second, 10.00, 1e-9);
+    }
+    CHECK(results.size() == 3);
+    if (results.size() == 3) {
+        CHECK_NEAR(results[0].expected, 7.00, 1e-9);
+        CHECK_NEAR(results[0].reading, 6.83, 1e-9);
+    }
+    CHECK(!probe.calibrating());
+}
+
+int main()
+{
+    testPhPlanWritesBuffers();
+    return check::failures();
+}
@@ -24,6 +24,18 @@
  */
 
 #include "itimer.h"
+#include "metrics.h"
+#include "logger.h"
+
+/*
+ * How far past its due time a timer callback actually ran, shared by
+ * every ITimer in the process.
+ */
+static Histogram* lateness()
+{
+    static Histogram *histogram = MetricsRegistry::instance()->histogram("aquarium_timer_lateness_seconds", "How late ITimer callbacks run after they are due");
+    return histogram;
+}
 
 ITimer::ITimer()
 {
@@ -53,17 +65,19 @@ void ITimer::setTimeout(std::function<void(void*)> function, int interval)
     clear = false;
     std::thread t([=]() 
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+        std::this_thread::sleep_until(due);
         
         if (clear) {
             return;
         }
+        lateness()->observeSince(due);
         
         try {
             function(static_cast<void*>(this));
         }
         catch (std::exception &e) {
-            syslog(LOG_ERR, "Unable to execute function: %s\n", e.what());
+            LOGE("Unable to execute function", "error", e.what());
         }
     });
     t.detach();
@@ -80,15 +94,17 @@ void ITimer::setInterval(std::function<void(void*)> function, int interval)
     {
         while(true) {
             m_start = std::chrono::system_clock::now();
-            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+            auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+            std::this_thread::sleep_until(due);
             if(this->clear) 
                 return;
+            lateness()->observeSince(due);
 
             try {
                 function(static_cast<void*>(this));
             }
             catch (std::exception &e) {
-                syslog(LOG_ERR, "Unable to execute function: %s\n", e.what());
+                LOGE("Unable to execute function", "error", e.what());
             }
 
             if(this->clear) 
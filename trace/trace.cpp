@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "logger.h"
+
+std::atomic<bool> Tracer::s_enabled(false);
+std::atomic<bool> Tracer::s_dumpRequested(false);
+
+Tracer::Holder::Holder()
+{
+    buffer = nullptr;
+    tid = static_cast<uint32_t>(syscall(SYS_gettid));
+}
+
+Tracer::Holder::~Holder()
+{
+    if (buffer)
+        Tracer::instance()->release(buffer);
+}
+
+/**
+ * \fn void Tracer::record(const char *name, uint64_t start, uint64_t end)
+ * 
+ * Only the first event on a thread takes the lock, to pick up a buffer.
+ * After that it is a plain store into the ring and a release store of
+ * the new head so a dump never sees the head ahead of the event.
+ */
+void Tracer::record(const char *name, uint64_t start, uint64_t end)
+{
+    thread_local Holder holder;
+    
+    if (holder.buffer == nullptr)
+        holder.buffer = instance()->acquire();
+    
+    Buffer *buffer = holder.buffer;
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Event &event = buffer->events[head % TRACE_BUFFER_EVENTS];
+    
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    event.tid = holder.tid;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+Tracer::Buffer* Tracer::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (!m_free.empty()) {
+        Buffer *buffer = m_free.back();
+        m_free.pop_back();
+        return buffer;
+    }
+    
+    m_buffers.emplace_back(new Buffer());
+    m_buffers.back()->head = 0;
+    return m_buffers.back().get();
+}
+
+void Tracer::release(Buffer *buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(buffer);
+}
+
+/**
+ * \fn std::vector<Tracer::Event> Tracer::events()
+ * 
+ * Everything still in the rings, oldest first. The head is read again
+ * after each copy and any slot the writer could have reached in the
+ * meantime is dropped, including the one it may be part way through
+ * writing at the new head.
+ */
+std::vector<Tracer::Event> Tracer::events()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Event> result;
+    
+    for (auto &buffer : m_buffers) {
+        std::vector<Event> copy;
+        uint64_t before = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = before > TRACE_BUFFER_EVENTS ? before - TRACE_BUFFER_EVENTS : 0;
+        
+        for (uint64_t i = first; i < before; i++)
+            copy.push_back(buffer->events[i % TRACE_BUFFER_EVENTS]);
+        
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        uint64_t valid = after >= TRACE_BUFFER_EVENTS ? after - TRACE_BUFFER_EVENTS + 1 : 0;
+        
+        for (uint64_t i = std::max(first, valid); i < before; i++)
+            result.push_back(copy[i - first]);
+    }
+    
+    std::sort(result.begin(), result.end(), [](const Event &a, const Event &b) { return a.start < b.start; });
+    return result;
+}
+
+/**
+ * \fn bool Tracer::dump(std::string path)
+ * 
+ * Write the rings as complete ("X") events in the Chrome trace event
+ * format, timestamps in microseconds since boot.
+ */
+bool Tracer::dump(std::string path)
+{
+    std::vector<Event> all = events();
+    FILE *fp = fopen(path.c_str(), "w");
+    
+    if (fp == nullptr) {
+        LOGE("Unable to write trace", "path", path, "error", strerror(errno));
+        return false;
+    }
+    
+    int pid = getpid();
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"aquarium\"}}", pid, pid);
+    
+    for (auto &event : all) {
+        std::string name;
+        for (const char *c = event.name; *c; c++) {
+            if (*c == '"' || *c == '\\')
+                name += '\\';
+            name += *c;
+        }
+        fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                name.c_str(), event.start / 1000.0, (event.end - event.start) / 1000.0, pid, event.tid);
+    }
+    
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    
+    LOGI("Wrote trace", "path", path, "events", all.size());
+    return true;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2020 Peter Buelow <goballstate at gmail dot com>
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#define TRACE_BUFFER_EVENTS     4096
+
+#define TRACE_CONCAT_INNER(a, b)    a##b
+#define TRACE_CONCAT(a, b)          TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name)           TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+/**
+ * \class Tracer
+ * 
+ * Records timed spans into per thread ring buffers and writes them out
+ * as Chrome trace event JSON, which chrome://tracing and Perfetto load.
+ * 
+ * Each thread writes only to its own buffer, so recording takes no
+ * lock. A buffer is handed back when its thread exits and reused by the
+ * next new thread, which matters because ITimer starts a thread for
+ * every timeout. The events keep the id of the thread that wrote them.
+ * 
+ * Dumping copies the rings while they may still be written. Anything
+ * that could have been overwritten during the copy is thrown away, so
+ * a dump is always consistent but may miss the oldest events.
+ */
+class Tracer
+{
+public:
+    struct Event {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+        uint32_t tid;
+    };
+    
+    static Tracer* instance()
+    {
+        static Tracer instance;
+        return &instance;
+    }
+    
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+    static void requestDump() { s_dumpRequested.store(true, std::memory_order_relaxed); }
+    static bool dumpRequested() { return s_dumpRequested.exchange(false); }
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    static void record(const char *name, uint64_t start, uint64_t end);
+    bool dump(std::string path);
+    std::vector<Event> events();
+    
+private:
+    struct Buffer {
+        Event events[TRACE_BUFFER_EVENTS];
+        std::atomic<uint64_t> head;
+    };
+    
+    struct Holder {
+        Buffer *buffer;
+        uint32_t tid;
+        Holder();
+        ~Holder();
+    };
+    
+    Tracer() {}
+    ~Tracer() {}
+    Tracer& operator=(Tracer const&) {return *this;}
+    Tracer(Tracer&);
+    
+    Buffer* acquire();
+    void release(Buffer *buffer);
+    
+    static std::atomic<bool> s_enabled;
+    static std::atomic<bool> s_dumpRequested;
+    
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+    std::vector<Buffer*> m_free;
+};
+
+/**
+ * \class TraceScope
+ * 
+ * Times the enclosing scope, use it through TRACE_SCOPE("name"). The
+ * name must be a string literal, only the pointer is kept. With tracing
+ * off the cost is the relaxed load and branch in the constructor; the
+ * destructor only tests a local that is still zero.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : m_name(name), m_start(0)
+    {
+        if (__builtin_expect(Tracer::enabled(), 0))
+            m_start = Tracer::now();
+    }
+    
+    ~TraceScope()
+    {
+        if (__builtin_expect(m_start != 0, 0))
+            Tracer::record(m_name, m_start, Tracer::now());
+    }
+    
+private:
+    const char *m_name;
+    uint64_t m_start;
+};
+
+#endif // TRACE_H